@@ -0,0 +1,166 @@
+#include "CCITTFax4Encoder.hh"
+
+namespace {
+
+struct Code {
+    int length;
+    unsigned int bits;
+};
+
+// Terminating codes for runs 0..63, make-up codes for 64..1728 and the shared extended make-up codes for 1792..2560
+const Code s_whiteTerm[64] = {
+    {8, 0x035}, {6, 0x007}, {4, 0x007}, {4, 0x008}, {4, 0x00b}, {4, 0x00c}, {4, 0x00e}, {4, 0x00f},
+    {5, 0x013}, {5, 0x014}, {5, 0x007}, {5, 0x008}, {6, 0x008}, {6, 0x003}, {6, 0x034}, {6, 0x035},
+    {6, 0x02a}, {6, 0x02b}, {7, 0x027}, {7, 0x00c}, {7, 0x008}, {7, 0x017}, {7, 0x003}, {7, 0x004},
+    {7, 0x028}, {7, 0x02b}, {7, 0x013}, {7, 0x024}, {7, 0x018}, {8, 0x002}, {8, 0x003}, {8, 0x01a},
+    {8, 0x01b}, {8, 0x012}, {8, 0x013}, {8, 0x014}, {8, 0x015}, {8, 0x016}, {8, 0x017}, {8, 0x028},
+    {8, 0x029}, {8, 0x02a}, {8, 0x02b}, {8, 0x02c}, {8, 0x02d}, {8, 0x004}, {8, 0x005}, {8, 0x00a},
+    {8, 0x00b}, {8, 0x052}, {8, 0x053}, {8, 0x054}, {8, 0x055}, {8, 0x024}, {8, 0x025}, {8, 0x058},
+    {8, 0x059}, {8, 0x05a}, {8, 0x05b}, {8, 0x04a}, {8, 0x04b}, {8, 0x032}, {8, 0x033}, {8, 0x034}
+};
+
+const Code s_whiteMakeup[27] = {
+    {5, 0x01b}, {5, 0x012}, {6, 0x017}, {7, 0x037}, {8, 0x036}, {8, 0x037}, {8, 0x064}, {8, 0x065},
+    {8, 0x068}, {8, 0x067}, {9, 0x0cc}, {9, 0x0cd}, {9, 0x0d2}, {9, 0x0d3}, {9, 0x0d4}, {9, 0x0d5},
+    {9, 0x0d6}, {9, 0x0d7}, {9, 0x0d8}, {9, 0x0d9}, {9, 0x0da}, {9, 0x0db}, {9, 0x098}, {9, 0x099},
+    {9, 0x09a}, {6, 0x018}, {9, 0x09b}
+};
+
+const Code s_blackTerm[64] = {
+    {10, 0x037}, {3, 0x002}, {2, 0x003}, {2, 0x002}, {3, 0x003}, {4, 0x003}, {4, 0x002}, {5, 0x003},
+    {6, 0x005}, {6, 0x004}, {7, 0x004}, {7, 0x005}, {7, 0x007}, {8, 0x004}, {8, 0x007}, {9, 0x018},
+    {10, 0x017}, {10, 0x018}, {10, 0x008}, {11, 0x067}, {11, 0x068}, {11, 0x06c}, {11, 0x037}, {11, 0x028},
+    {11, 0x017}, {11, 0x018}, {12, 0x0ca}, {12, 0x0cb}, {12, 0x0cc}, {12, 0x0cd}, {12, 0x068}, {12, 0x069},
+    {12, 0x06a}, {12, 0x06b}, {12, 0x0d2}, {12, 0x0d3}, {12, 0x0d4}, {12, 0x0d5}, {12, 0x0d6}, {12, 0x0d7},
+    {12, 0x06c}, {12, 0x06d}, {12, 0x0da}, {12, 0x0db}, {12, 0x054}, {12, 0x055}, {12, 0x056}, {12, 0x057},
+    {12, 0x064}, {12, 0x065}, {12, 0x052}, {12, 0x053}, {12, 0x024}, {12, 0x037}, {12, 0x038}, {12, 0x027},
+    {12, 0x028}, {12, 0x058}, {12, 0x059}, {12, 0x02b}, {12, 0x02c}, {12, 0x05a}, {12, 0x066}, {12, 0x067}
+};
+
+const Code s_blackMakeup[27] = {
+    {10, 0x00f}, {12, 0x0c8}, {12, 0x0c9}, {12, 0x05b}, {12, 0x033}, {12, 0x034}, {12, 0x035}, {13, 0x06c},
+    {13, 0x06d}, {13, 0x04a}, {13, 0x04b}, {13, 0x04c}, {13, 0x04d}, {13, 0x072}, {13, 0x073}, {13, 0x074},
+    {13, 0x075}, {13, 0x076}, {13, 0x077}, {13, 0x052}, {13, 0x053}, {13, 0x054}, {13, 0x055}, {13, 0x05a},
+    {13, 0x05b}, {13, 0x064}, {13, 0x065}
+};
+
+const Code s_extMakeup[13] = {
+    {11, 0x008}, {11, 0x00c}, {11, 0x00d}, {12, 0x012}, {12, 0x013}, {12, 0x014}, {12, 0x015}, {12, 0x016},
+    {12, 0x017}, {12, 0x01c}, {12, 0x01d}, {12, 0x01e}, {12, 0x01f}
+};
+
+const Code s_passCode = {4, 0x1};
+const Code s_horizontalCode = {3, 0x1};
+// Indexed by b1 - a1 + 3, i.e. VR3 .. V0 .. VL3
+const Code s_verticalCodes[7] = {
+    {7, 0x03}, {6, 0x03}, {3, 0x03}, {1, 0x1}, {3, 0x2}, {6, 0x02}, {7, 0x02}
+};
+const Code s_eol = {12, 0x001};
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) : m_out(out) {}
+    void put(const Code& code) {
+        m_acc = (m_acc << code.length) | code.bits;
+        m_count += code.length;
+        while(m_count >= 8) {
+            m_count -= 8;
+            m_out.push_back(static_cast<unsigned char>(m_acc >> m_count));
+        }
+        m_acc &= (1u << m_count) - 1;
+    }
+    void flush() {
+        if(m_count > 0) {
+            m_out.push_back(static_cast<unsigned char>(m_acc << (8 - m_count)));
+            m_count = 0;
+            m_acc = 0;
+        }
+    }
+private:
+    std::vector<unsigned char>& m_out;
+    unsigned int m_acc = 0;
+    int m_count = 0;
+};
+
+void putRun(BitWriter& writer, int run, bool black) {
+    const Code* term = black ? s_blackTerm : s_whiteTerm;
+    const Code* makeup = black ? s_blackMakeup : s_whiteMakeup;
+    while(run >= 2624) {
+        writer.put(s_extMakeup[12]);
+        run -= 2560;
+    }
+    if(run >= 1792) {
+        writer.put(s_extMakeup[(run >> 6) - 28]);
+        run &= 63;
+    } else if(run >= 64) {
+        writer.put(makeup[(run >> 6) - 1]);
+        run &= 63;
+    }
+    writer.put(term[run]);
+}
+
+// First position >= start whose pixel differs from color, or width
+inline int findDiff(const std::vector<unsigned char>& row, int start, int width, unsigned char color) {
+    while(start < width && row[start] == color) {
+        ++start;
+    }
+    return start;
+}
+
+} // namespace
+
+std::vector<unsigned char> CCITTFax4Encoder::encode(const unsigned char* bits, int width, int height, int bytesPerLine, bool blackIsOne) {
+    std::vector<unsigned char> out;
+    if(width <= 0 || height <= 0) {
+        return out;
+    }
+    out.reserve(width * height / 64 + 16);
+    BitWriter writer(out);
+    // One byte per pixel, 1 is black; the line above the first is all white
+    std::vector<unsigned char> ref(width, 0);
+    std::vector<unsigned char> cur(width);
+    unsigned char blackBit = blackIsOne ? 1 : 0;
+    for(int y = 0; y < height; ++y) {
+        const unsigned char* line = bits + y * bytesPerLine;
+        for(int x = 0; x < width; ++x) {
+            cur[x] = ((line[x >> 3] >> (7 - (x & 7))) & 1) == blackBit;
+        }
+
+        int a0 = 0;
+        int a1 = cur[0] ? 0 : findDiff(cur, 0, width, 0);
+        int b1 = ref[0] ? 0 : findDiff(ref, 0, width, 0);
+        while(true) {
+            int b2 = b1 >= width ? width : findDiff(ref, b1, width, ref[b1]);
+            if(b2 >= a1) {
+                int d = b1 - a1;
+                if(d < -3 || d > 3) {
+                    int a2 = a1 >= width ? width : findDiff(cur, a1, width, cur[a1]);
+                    writer.put(s_horizontalCode);
+                    // a0 is the imaginary white pixel before the line when a0 == a1 == 0
+                    bool black = a0 + a1 != 0 && cur[a0];
+                    putRun(writer, a1 - a0, black);
+                    putRun(writer, a2 - a1, !black);
+                    a0 = a2;
+                } else {
+                    writer.put(s_verticalCodes[d + 3]);
+                    a0 = a1;
+                }
+            } else {
+                writer.put(s_passCode);
+                a0 = b2;
+            }
+            if(a0 >= width) {
+                break;
+            }
+            unsigned char color = cur[a0];
+            a1 = findDiff(cur, a0, width, color);
+            b1 = findDiff(ref, a0, width, !color);
+            b1 = findDiff(ref, b1, width, color);
+        }
+        ref.swap(cur);
+    }
+    writer.put(s_eol);
+    writer.put(s_eol);
+    writer.flush();
+    return out;
+}
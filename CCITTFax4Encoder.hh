@@ -0,0 +1,18 @@
+#ifndef CCITTFAX4ENCODER_HH
+#define CCITTFAX4ENCODER_HH
+
+#include <vector>
+
+/*
+ * CCITT Group 4 (T.6) encoder for bitonal images.
+ * The output is what a PDF CCITTFaxDecode filter expects with K -1, Columns width,
+ * Rows height and BlackIs1 false, terminated by an EOFB.
+ */
+class CCITTFax4Encoder {
+public:
+    // bits holds height rows of bytesPerLine bytes, one pixel per bit with the most significant bit first.
+    // blackIsOne tells which bit value marks a black pixel.
+    static std::vector<unsigned char> encode(const unsigned char* bits, int width, int height, int bytesPerLine, bool blackIsOne);
+};
+
+#endif // CCITTFAX4ENCODER_HH
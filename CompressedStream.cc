@@ -0,0 +1,197 @@
+#include <QFileInfo>
+#include <zlib.h>
+#include <zstd.h>
+#include "CompressedStream.hh"
+
+static const int s_chunkSize = 1 << 16;
+
+CompressedStream::Format CompressedStream::formatForPath(const QString& path) {
+    QString suffix = QFileInfo(path).suffix().toLower();
+    if(suffix == "gz") {
+        return Gzip;
+    } else if(suffix == "zst") {
+        return Zstd;
+    }
+    return None;
+}
+
+QString CompressedStream::contentSuffix(const QString& path) {
+    QFileInfo info(path);
+    return formatForPath(path) != None ? QFileInfo(info.completeBaseName()).suffix().toLower() : info.suffix().toLower();
+}
+
+static bool inflateGzip(QIODevice* source, QIODevice* target) {
+    z_stream stream = {};
+    // 32: accept gzip and zlib headers
+    if(inflateInit2(&stream, 15 + 32) != Z_OK) {
+        return false;
+    }
+    std::vector<char> input(s_chunkSize), output(s_chunkSize);
+    bool ok = true;
+    bool ended = false;
+    qint64 read;
+    while(ok && (read = source->read(input.data(), input.size())) > 0) {
+        stream.next_in = reinterpret_cast<Bytef*>(input.data());
+        stream.avail_in = read;
+        do {
+            if(ended && stream.avail_in > 0) {
+                // Next gzip member
+                inflateReset(&stream);
+                ended = false;
+            }
+            stream.next_out = reinterpret_cast<Bytef*>(output.data());
+            stream.avail_out = output.size();
+            int ret = inflate(&stream, Z_NO_FLUSH);
+            ok = ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR;
+            ended = ended || ret == Z_STREAM_END;
+            qint64 produced = output.size() - stream.avail_out;
+            ok = ok && target->write(output.data(), produced) == produced;
+        } while(ok && (stream.avail_in > 0 || stream.avail_out == 0));
+    }
+    inflateEnd(&stream);
+    return ok && read == 0 && ended;
+}
+
+static bool decompressZstd(QIODevice* source, QIODevice* target) {
+    ZSTD_DCtx* context = ZSTD_createDCtx();
+    if(!context) {
+        return false;
+    }
+    std::vector<char> input(s_chunkSize), output(s_chunkSize);
+    bool ok = true;
+    size_t remaining = 0;
+    qint64 read;
+    while(ok && (read = source->read(input.data(), input.size())) > 0) {
+        ZSTD_inBuffer in = {input.data(), size_t(read), 0};
+        bool outputFull;
+        do {
+            ZSTD_outBuffer out = {output.data(), output.size(), 0};
+            remaining = ZSTD_decompressStream(context, &out, &in);
+            ok = !ZSTD_isError(remaining) && target->write(output.data(), out.pos) == qint64(out.pos);
+            outputFull = out.pos == out.size;
+        } while(ok && (in.pos < in.size || outputFull));
+    }
+    ZSTD_freeDCtx(context);
+    // A non-zero hint means the last frame is incomplete
+    return ok && read == 0 && remaining == 0;
+}
+
+bool CompressedStream::decompress(QIODevice* source, Format format, QIODevice* target) {
+    switch(format) {
+    case Gzip:
+        return inflateGzip(source, target);
+    case Zstd:
+        return decompressZstd(source, target);
+    default:
+        break;
+    }
+    std::vector<char> buffer(s_chunkSize);
+    qint64 read;
+    while((read = source->read(buffer.data(), buffer.size())) > 0) {
+        if(target->write(buffer.data(), read) != read) {
+            return false;
+        }
+    }
+    return read == 0;
+}
+
+CompressingDevice::CompressingDevice(QIODevice* target, CompressedStream::Format format)
+    : m_target(target), m_format(format), m_buffer(s_chunkSize) {
+}
+
+CompressingDevice::~CompressingDevice() {
+    close();
+}
+
+bool CompressingDevice::open(OpenMode mode) {
+    if((mode & ReadOnly) || !(mode & WriteOnly) || isOpen()) {
+        return false;
+    }
+    if(m_format == CompressedStream::Gzip) {
+        m_zstream = new z_stream();
+        // 16: gzip header and trailer instead of zlib ones
+        if(deflateInit2(m_zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            delete m_zstream;
+            m_zstream = nullptr;
+            return false;
+        }
+    } else if(m_format == CompressedStream::Zstd) {
+        m_zstdContext = ZSTD_createCCtx();
+        if(!m_zstdContext) {
+            return false;
+        }
+    }
+    m_failed = false;
+    m_finished = false;
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void CompressingDevice::close() {
+    if(isOpen()) {
+        finish();
+        QIODevice::close();
+    }
+}
+
+bool CompressingDevice::finish() {
+    if(!m_finished) {
+        m_finished = true;
+        m_failed = m_failed || !compress(nullptr, 0, true);
+        release();
+    }
+    return !m_failed;
+}
+
+qint64 CompressingDevice::writeData(const char* data, qint64 size) {
+    if(m_failed || m_finished) {
+        return -1;
+    }
+    if(!compress(data, size, false)) {
+        m_failed = true;
+        setErrorString(m_target->errorString());
+        return -1;
+    }
+    return size;
+}
+
+bool CompressingDevice::compress(const char* data, qint64 size, bool end) {
+    if(m_format == CompressedStream::Gzip) {
+        m_zstream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        m_zstream->avail_in = size;
+        int ret;
+        do {
+            m_zstream->next_out = reinterpret_cast<Bytef*>(m_buffer.data());
+            m_zstream->avail_out = m_buffer.size();
+            ret = deflate(m_zstream, end ? Z_FINISH : Z_NO_FLUSH);
+            qint64 produced = m_buffer.size() - m_zstream->avail_out;
+            if(ret == Z_STREAM_ERROR || m_target->write(m_buffer.data(), produced) != produced) {
+                return false;
+            }
+        } while(end ? ret != Z_STREAM_END : m_zstream->avail_out == 0);
+        return true;
+    } else if(m_format == CompressedStream::Zstd) {
+        ZSTD_inBuffer in = {data, size_t(size), 0};
+        size_t remaining;
+        do {
+            ZSTD_outBuffer out = {m_buffer.data(), m_buffer.size(), 0};
+            remaining = ZSTD_compressStream2(m_zstdContext, &out, &in, end ? ZSTD_e_end : ZSTD_e_continue);
+            if(ZSTD_isError(remaining) || m_target->write(m_buffer.data(), out.pos) != qint64(out.pos)) {
+                return false;
+            }
+        } while(end ? remaining != 0 : in.pos < in.size);
+        return true;
+    }
+    return size == 0 || m_target->write(data, size) == size;
+}
+
+void CompressingDevice::release() {
+    if(m_zstream) {
+        deflateEnd(m_zstream);
+        delete m_zstream;
+        m_zstream = nullptr;
+    }
+    if(m_zstdContext) {
+        ZSTD_freeCCtx(m_zstdContext);
+        m_zstdContext = nullptr;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef COMPRESSEDSTREAM_HH
+#define COMPRESSEDSTREAM_HH
+
+#include <QIODevice>
+#include <QString>
+#include <vector>
+
+typedef struct z_stream_s z_stream;
+typedef struct ZSTD_CCtx_s ZSTD_CCtx;
+
+/*
+ * gzip and zstd streams, selected by the file suffix (.gz, .zst).
+ */
+namespace CompressedStream {
+
+enum Format {
+    None,
+    Gzip,
+    Zstd
+};
+
+Format formatForPath(const QString& path);
+// Lower case suffix of the content, e.g. "txt" for both "out.txt" and "out.txt.gz"
+QString contentSuffix(const QString& path);
+// Copies the decompressed content of source to target chunk by chunk; concatenated gzip
+// members and zstd frames are read as one stream
+bool decompress(QIODevice* source, Format format, QIODevice* target);
+
+}
+
+/*
+ * Write only device compressing everything written to it into target. finish() ends the
+ * stream and reports whether all of it reached target; with format None data is passed through.
+ */
+class CompressingDevice : public QIODevice {
+public:
+    CompressingDevice(QIODevice* target, CompressedStream::Format format);
+    ~CompressingDevice();
+
+    bool isSequential() const override {
+        return true;
+    }
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool finish();
+
+protected:
+    qint64 readData(char* /*data*/, qint64 /*maxSize*/) override {
+        return -1;
+    }
+    qint64 writeData(const char* data, qint64 size) override;
+
+private:
+    QIODevice* m_target;
+    CompressedStream::Format m_format;
+    z_stream* m_zstream = nullptr;
+    ZSTD_CCtx* m_zstdContext = nullptr;
+    std::vector<char> m_buffer;
+    bool m_failed = false;
+    bool m_finished = false;
+
+    bool compress(const char* data, qint64 size, bool end);
+    void release();
+};
+
+#endif // COMPRESSEDSTREAM_HH
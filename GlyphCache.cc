@@ -0,0 +1,53 @@
+#include "GlyphCache.hh"
+
+GlyphAdvanceCache::GlyphAdvanceCache(const QFont& defaultFont)
+    : m_defaultFont(defaultFont), m_device(1, 1, QImage::Format_Mono) {
+    // 72 dpi, so that metrics come out in points
+    m_device.setDotsPerMeterX(2835);
+    m_device.setDotsPerMeterY(2835);
+}
+
+GlyphAdvanceCache::~GlyphAdvanceCache() {
+    qDeleteAll(m_fonts);
+}
+
+GlyphAdvanceCache::Font* GlyphAdvanceCache::font(const QString& family, double pointSize, bool bold, bool italic) {
+    QString key = QString("%1@%2@%3%4").arg(family).arg(pointSize).arg(bold ? "b" : "").arg(italic ? "i" : "");
+    auto it = m_fonts.find(key);
+    if(it != m_fonts.end()) {
+        return it.value();
+    }
+    auto familyIt = m_families.find(family);
+    if(familyIt == m_families.end()) {
+        familyIt = m_families.insert(family, !family.isEmpty() && m_fontDatabase.hasFamily(family));
+    }
+    QFont qfont = m_defaultFont;
+    if(familyIt.value()) {
+        qfont.setFamily(family);
+    }
+    if(pointSize > 0) {
+        qfont.setPointSizeF(pointSize);
+    }
+    qfont.setBold(bold);
+    qfont.setItalic(italic);
+    return m_fonts.insert(key, new Font(qfont, &m_device)).value();
+}
+
+qreal GlyphAdvanceCache::textWidth(Font* font, const QString& text) {
+    qreal width = 0;
+    for(int i = 0, n = text.size(); i < n; ++i) {
+        uint codepoint = text[i].unicode();
+        int len = 1;
+        if(text[i].isHighSurrogate() && i + 1 < n && text[i + 1].isLowSurrogate()) {
+            codepoint = QChar::surrogateToUcs4(text[i], text[i + 1]);
+            len = 2;
+        }
+        auto it = font->advances.find(codepoint);
+        if(it == font->advances.end()) {
+            it = font->advances.insert(codepoint, font->metrics.width(text.mid(i, len)));
+        }
+        width += it.value();
+        i += len - 1;
+    }
+    return width;
+}
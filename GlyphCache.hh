@@ -0,0 +1,45 @@
+#ifndef GLYPHCACHE_HH
+#define GLYPHCACHE_HH
+
+#include <QFont>
+#include <QFontDatabase>
+#include <QFontMetricsF>
+#include <QHash>
+#include <QImage>
+#include <QString>
+
+/*
+ * Resolves fonts once per (family, size, style) and caches per-codepoint advances.
+ * All measurements are in points, i.e. for a 72 dpi device like the PDF printer.
+ * A cache instance must only be used from one thread at a time.
+ */
+class GlyphAdvanceCache {
+public:
+    struct Font {
+        Font(const QFont& qfont, QPaintDevice* device)
+            : font(qfont), metrics(qfont, device), averageCharWidth(metrics.averageCharWidth()) {}
+        QFont font;
+        QFontMetricsF metrics;
+        qreal averageCharWidth;
+        QHash<uint, qreal> advances;
+    };
+
+    explicit GlyphAdvanceCache(const QFont& defaultFont);
+    ~GlyphAdvanceCache();
+
+    // Falls back to the default family if family is empty or not installed
+    Font* font(const QString& family, double pointSize, bool bold, bool italic);
+    qreal textWidth(Font* font, const QString& text);
+    const QFont& defaultFont() const {
+        return m_defaultFont;
+    }
+
+private:
+    QFont m_defaultFont;
+    QFontDatabase m_fontDatabase;
+    QImage m_device;
+    QHash<QString, bool> m_families;
+    QHash<QString, Font*> m_fonts;
+};
+
+#endif // GLYPHCACHE_HH
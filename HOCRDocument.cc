@@ -17,164 +17,425 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <QDir>
 #include <QFileInfo>
-#include <QIcon>
+#include <QRegExp>
 #include <QSet>
+#include <QStringList>
+#include <QTemporaryFile>
 #include <QTextStream>
-#include "common.hh"
+#include "CompressedStream.hh"
 #include "HOCRDocument.hh"
+#include "HOCRPageScanner.hh"
+#include "HOCRSpatialIndex.hh"
 
 
-HOCRDocument::HOCRDocument(QObject* parent)
-    : QAbstractItemModel(parent) {
+HOCRDocument::HOCRDocument() {
 }
 
 HOCRDocument::~HOCRDocument() {
     qDeleteAll(m_pages);
+    closeSource();
 }
 
 void HOCRDocument::clear() {
-    beginResetModel();
+    if(m_observer) {
+        m_observer->beginResetItems();
+    }
     qDeleteAll(m_pages);
     m_pages.clear();
+    m_dirtyItems.clear();
+    closeSource();
     m_pageIdCounter = 0;
-    endResetModel();
+    if(m_observer) {
+        m_observer->endResetItems();
+    }
 }
 
 QString HOCRDocument::toHTML() const {
     QString html = "<body>\n";
-    for(const HOCRPage* page : m_pages) {
-        html += page->toHtml(1);
+    for(int i = 0, n = m_pages.size(); i < n; ++i) {
+        html += page(i)->toHtml(1);
     }
     html += "</body>\n";
     return html;
 }
 
-QModelIndex HOCRDocument::addPage(const QDomElement& pageElement, bool cleanGraphics) {
+bool HOCRDocument::writeHTML(QIODevice* device) const {
+    bool ok = device->write("<body>\n", 7) == 7;
+    for(int i = 0, n = m_pages.size(); ok && i < n; ++i) {
+        const char* source = nullptr;
+        qint64 length = 0;
+        int pageId = 0;
+        {
+            QMutexLocker locker(&m_pageMutex);
+            const HOCRPage* page = m_pages[i];
+            if(!m_slots.isEmpty() && m_slots[i].offset >= 0 && (!page || !page->isModified())) {
+                source = m_sourceData + m_slots[i].offset;
+                length = m_slots[i].length;
+                pageId = m_slots[i].pageId;
+            }
+        }
+        // Pages the parser would normalize are built, so the output does not depend on whether they were accessed
+        if(source && HOCRPageScanner::isCanonical(source, length, pageId, m_sourceCleanGraphics)) {
+            // Indented and terminated like HOCRItem::toHtml(1)
+            ok = device->write(" ", 1) == 1 && device->write(source, length) == length && device->write("\n", 1) == 1;
+        } else {
+            QByteArray html = page(i)->toHtml(1).toUtf8();
+            ok = device->write(html) == html.size();
+        }
+    }
+    return ok && device->write("</body>\n", 8) == 8;
+}
+
+HOCRPage* HOCRDocument::addPage(const QDomElement& pageElement, bool cleanGraphics) {
+    int newRow = m_pages.size();
+    if(m_observer) {
+        m_observer->beginInsertItems(nullptr, newRow, newRow);
+    }
+    HOCRPage* page = new HOCRPage(pageElement, ++m_pageIdCounter, m_defaultLanguage, cleanGraphics, newRow);
+    page->m_modified = false;
+    m_pages.append(page);
+    if(!m_slots.isEmpty()) {
+        m_slots.append(PageSlot());
+    }
+    if(m_observer) {
+        m_observer->endInsertItems(nullptr);
+    }
+    return page;
+}
+
+HOCRPage* HOCRDocument::addPage(HOCRPage* page) {
     int newRow = m_pages.size();
-    beginInsertRows(QModelIndex(), newRow, newRow);
-    m_pages.append(new HOCRPage(pageElement, ++m_pageIdCounter, m_defaultLanguage, cleanGraphics, m_pages.size()));
-    endInsertRows();
-    emit dataChanged(index(0, 0), index(m_pages.size() - 1, 0), {Qt::DisplayRole});
-    return index(newRow, 0);
+    page->assignIds(++m_pageIdCounter);
+    page->m_index = newRow;
+    page->m_modified = false;
+    if(m_observer) {
+        m_observer->beginInsertItems(nullptr, newRow, newRow);
+    }
+    m_pages.append(page);
+    if(!m_slots.isEmpty()) {
+        m_slots.append(PageSlot());
+    }
+    if(m_observer) {
+        m_observer->endInsertItems(nullptr);
+    }
+    return page;
+}
+
+bool HOCRDocument::addPages(const QString& filename, bool cleanGraphics) {
+    // One lazily read file per document
+    if(m_source) {
+        return false;
+    }
+    CompressedStream::Format format = CompressedStream::formatForPath(filename);
+    if(format != CompressedStream::None) {
+        // Pages are read from byte ranges, which a compressed stream cannot seek to. Compressed files
+        // are inflated to a temporary file instead, which is then mapped like a plain one.
+        QFile compressed(filename);
+        QTemporaryFile* inflated = new QTemporaryFile(QDir::temp().filePath("hocr-XXXXXX.xml"));
+        m_source.reset(inflated);
+        if(!compressed.open(QIODevice::ReadOnly) || !inflated->open()) {
+            closeSource();
+            return false;
+        }
+#ifndef WIN32
+        // The open handle keeps the data, without a name not even a crash leaves the file behind
+        QFile::remove(inflated->fileName());
+#endif
+        if(!CompressedStream::decompress(&compressed, format, inflated) || !inflated->flush()) {
+            closeSource();
+            return false;
+        }
+    } else {
+        m_source.reset(new QFile(filename));
+        if(!m_source->open(QIODevice::ReadOnly)) {
+            closeSource();
+            return false;
+        }
+    }
+    qint64 size = m_source->size();
+    const char* data = size > 0 ? reinterpret_cast<const char*>(m_source->map(0, size)) : nullptr;
+    QVector<HOCRPageScanner::Page> pages;
+    if(!data || !HOCRPageScanner::scan(data, size, pages)) {
+        m_sourceData = data;
+        closeSource();
+        return false;
+    }
+    m_sourceData = data;
+    m_sourceCleanGraphics = cleanGraphics;
+    m_sourceLanguage = m_defaultLanguage;
+    if(pages.isEmpty()) {
+        return true;
+    }
+    // Pages added before are fully built already
+    m_slots.resize(m_pages.size());
+    int first = m_pages.size();
+    if(m_observer) {
+        m_observer->beginInsertItems(nullptr, first, first + pages.size() - 1);
+    }
+    for(const HOCRPageScanner::Page& scanned : pages) {
+        PageSlot slot;
+        slot.offset = scanned.offset;
+        slot.length = scanned.length;
+        slot.pageId = ++m_pageIdCounter;
+        slot.resident = false;
+        // As HOCRPage::parsePageAttributes
+        slot.sourceFile = QString(scanned.titleAttrs["image"]).replace(QRegExp("^['\"]"), "").replace(QRegExp("['\"]$"), "");
+        slot.pageNr = scanned.titleAttrs["ppageno"].toInt();
+        if(slot.pageNr == 0) {
+            slot.pageNr = scanned.titleAttrs["pageno"].toInt();
+        }
+        m_slots.append(slot);
+        m_pages.append(nullptr);
+    }
+    if(m_observer) {
+        m_observer->endInsertItems(nullptr);
+    }
+    return true;
+}
+
+void HOCRDocument::pinPages(int first, int last) const {
+    if(m_slots.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&m_pageMutex);
+    HOCRDocument* self = const_cast<HOCRDocument*>(this);
+    for(int i = std::max(first, 0), n = std::min(last, m_slots.size()); i < n; ++i) {
+        ++self->m_slots[i].pins;
+    }
+}
+
+void HOCRDocument::unpinPages(int first, int last) const {
+    if(m_slots.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&m_pageMutex);
+    HOCRDocument* self = const_cast<HOCRDocument*>(this);
+    for(int i = std::max(first, 0), n = std::min(last, m_slots.size()); i < n; ++i) {
+        --self->m_slots[i].pins;
+    }
+    self->trimPageCache(nullptr);
+}
+
+const HOCRPage* HOCRDocument::page(int i) const {
+    if(m_slots.isEmpty()) {
+        return m_pages.value(i);
+    }
+    QMutexLocker locker(&m_pageMutex);
+    return const_cast<HOCRDocument*>(this)->loadPage(i, false);
+}
+
+HOCRPage* HOCRDocument::page(int i) {
+    if(m_slots.isEmpty()) {
+        return m_pages.value(i);
+    }
+    QMutexLocker locker(&m_pageMutex);
+    return loadPage(i, true);
+}
+
+HOCRPage* HOCRDocument::loadPage(int i, bool keep) {
+    if(i < 0 || i >= m_pages.size()) {
+        return nullptr;
+    }
+    PageSlot& slot = m_slots[i];
+    HOCRPage* page = m_pages[i];
+    // A tree costs several times the bytes of its source
+    const qint64 cost = 8 * slot.length;
+    if(!page) {
+        // A page that fails to parse comes out empty
+        QDomDocument doc;
+        doc.setContent(QByteArray::fromRawData(m_sourceData + slot.offset, slot.length));
+        page = new HOCRPage(doc.documentElement(), slot.pageId, m_sourceLanguage, m_sourceCleanGraphics, i);
+        page->m_modified = false;
+        m_pages[i] = page;
+        m_pageCacheCost += cost;
+    } else if(!slot.resident) {
+        m_pageCache.remove(slot.lastUse);
+    }
+    if(!slot.resident) {
+        if(keep) {
+            slot.resident = true;
+            m_pageCacheCost -= cost;
+        } else {
+            slot.lastUse = ++m_pageUseCounter;
+            m_pageCache.insert(slot.lastUse, page);
+        }
+    }
+    trimPageCache(page);
+    return page;
 }
 
-bool HOCRDocument::editItemAttribute(const QModelIndex& index, const QString& name, const QString& value, const QString& attrItemClass) {
-    HOCRItem* item = mutableItemAtIndex(index);
+void HOCRDocument::trimPageCache(const HOCRPage* keep) {
+    auto it = m_pageCache.begin();
+    while(m_pageCacheCost > m_pageCacheLimit && it != m_pageCache.end()) {
+        HOCRPage* page = it.value();
+        PageSlot& slot = m_slots[page->index()];
+        if(page == keep || slot.pins > 0) {
+            ++it;
+            continue;
+        }
+        m_pageCacheCost -= 8 * slot.length;
+        m_pages[page->index()] = nullptr;
+        it = m_pageCache.erase(it);
+        delete page;
+    }
+}
+
+void HOCRDocument::closeSource() {
+    m_slots.clear();
+    m_takenSlots.clear();
+    m_pageCache.clear();
+    m_pageCacheCost = 0;
+    if(m_sourceData) {
+        m_source->unmap(reinterpret_cast<uchar*>(const_cast<char*>(m_sourceData)));
+        m_sourceData = nullptr;
+    }
+    // A decompressed copy removes itself
+    m_source.reset();
+}
+
+void HOCRDocument::endEdits() {
+    Q_ASSERT(m_editDepth > 0);
+    if(--m_editDepth == 0) {
+        updateBBoxes();
+    }
+}
+
+bool HOCRDocument::setItemBBox(HOCRItem* item, const QRect& bbox) {
     if(!item) {
         return false;
     }
+    item->setBBox(bbox);
+    if(m_observer) {
+        m_observer->attributeChanged(item, "title:bbox", HOCRItem::serializeBBox(bbox));
+    }
+    recomputeBBoxes(item->parent());
+    return true;
+}
 
-    item->setAttribute(name, value, attrItemClass);
-    if(name == "title:x_wconf") {
-        QModelIndex colIdx = index.sibling(index.row(), 1);
-        emit dataChanged(colIdx, colIdx, {Qt::DisplayRole});
+bool HOCRDocument::editItemAttribute(HOCRItem* item, const QString& name, const QString& value, const QString& attrItemClass) {
+    if(!item) {
+        return false;
     }
-    if(name == "lang") {
-        recursiveDataChanged(index, {Qt::DisplayRole}, {"ocrx_word"});
+
+    item->setAttribute(name, value, attrItemClass);
+    if(m_observer) {
+        m_observer->attributeChanged(item, name, value);
     }
-    emit itemAttributeChanged(index, name, value);
     if(name == "title:bbox") {
         recomputeBBoxes(item->parent());
     }
     return true;
 }
 
-// Might be more logical to accept oldParent and oldRow as parameters rather than itemIndex
-// (since we need them anyway), if all our callers are likely to know them. Swap does; drag&drop might not.
-QModelIndex HOCRDocument::moveItem(const QModelIndex& itemIndex, const QModelIndex& newParent, int newRow) {
-    HOCRItem* item = mutableItemAtIndex(itemIndex);
-    HOCRItem* parentItem = mutableItemAtIndex(newParent);
-    if(!item || (!parentItem && item->itemClass() != "ocr_page")) {
-        return QModelIndex();
+bool HOCRDocument::moveItem(HOCRItem* item, HOCRItem* newParent, int newRow) {
+    if(!item || (!newParent && item->itemClass() != "ocr_page")) {
+        return false;
     }
-    QModelIndex ancestor = newParent;
-    while(ancestor.isValid()) {
-        if(ancestor == itemIndex) {
-            return QModelIndex();
+    for(const HOCRItem* ancestor = newParent; ancestor; ancestor = ancestor->parent()) {
+        if(ancestor == item) {
+            return false;
         }
-        ancestor = ancestor.parent();
     }
-    int oldRow = itemIndex.row();
-    QModelIndex oldParent = itemIndex.parent();
+    int oldRow = item->index();
+    HOCRItem* oldParent = item->parent();
     if(oldParent == newParent && oldRow < newRow) {
         --newRow;
     }
-    beginRemoveRows(oldParent, oldRow, oldRow);
+    if(m_observer) {
+        m_observer->beginRemoveItems(oldParent, oldRow, oldRow);
+    }
     takeItem(item);
-    endRemoveRows();
-    recomputeBBoxes(mutableItemAtIndex(oldParent));
-    beginInsertRows(newParent, newRow, newRow);
-    insertItem(parentItem, item, newRow);
-    endInsertRows();
-    recomputeBBoxes(parentItem);
-    return itemIndex;
+    if(m_observer) {
+        m_observer->endRemoveItems(oldParent);
+    }
+    recomputeBBoxes(oldParent);
+    if(m_observer) {
+        m_observer->beginInsertItems(newParent, newRow, newRow);
+    }
+    insertItem(newParent, item, newRow);
+    if(m_observer) {
+        m_observer->endInsertItems(newParent);
+    }
+    recomputeBBoxes(newParent);
+    return true;
 }
 
-QModelIndex HOCRDocument::swapItems(const QModelIndex& parent, int firstRow, int secondRow) {
-    moveItem(index(firstRow, 0, parent), parent, secondRow);
-    moveItem(index(secondRow, 0, parent), parent, firstRow);
-    return index(firstRow, 0, parent);
+HOCRItem* HOCRDocument::swapItems(HOCRItem* parent, int firstRow, int secondRow) {
+    moveItem(child(parent, firstRow), parent, secondRow);
+    moveItem(child(parent, secondRow), parent, firstRow);
+    return child(parent, firstRow);
 }
 
-QModelIndex HOCRDocument::mergeItems(const QModelIndex& parent, int startRow, int endRow) {
+HOCRItem* HOCRDocument::mergeItems(HOCRItem* parent, int startRow, int endRow) {
     if(endRow - startRow <= 0) {
-        return QModelIndex();
+        return nullptr;
     }
-    QModelIndex targetIndex = parent.child(startRow, 0);
-    HOCRItem* targetItem = mutableItemAtIndex(targetIndex);
+    HOCRItem* targetItem = child(parent, startRow);
     if(!targetItem || targetItem->itemClass() == "ocr_page") {
-        return QModelIndex();
+        return nullptr;
     }
 
     QRect bbox = targetItem->bbox();
     if(targetItem->itemClass() == "ocrx_word") {
         // Merge word items: join text, merge bounding boxes
         QString text = targetItem->text();
-        beginRemoveRows(parent, startRow + 1, endRow);
+        if(m_observer) {
+            m_observer->beginRemoveItems(parent, startRow + 1, endRow);
+        }
         for(int row = ++startRow; row <= endRow; ++row) {
-            HOCRItem* item = mutableItemAtIndex(parent.child(startRow, 0));
+            HOCRItem* item = child(parent, startRow);
             Q_ASSERT(item);
             text += item->text();
             bbox = bbox.united(item->bbox());
             deleteItem(item);
         }
-        endRemoveRows();
+        if(m_observer) {
+            m_observer->endRemoveItems(parent);
+        }
         targetItem->setText(text);
-        emit dataChanged(targetIndex, targetIndex, {Qt::DisplayRole, Qt::ForegroundRole});
+        if(m_observer) {
+            m_observer->textChanged(targetItem);
+        }
     } else {
         // Merge other items: merge dom trees and bounding boxes
         QVector<HOCRItem*> moveChilds;
-        beginRemoveRows(parent, startRow + 1, endRow);
+        if(m_observer) {
+            m_observer->beginRemoveItems(parent, startRow + 1, endRow);
+        }
         for(int row = ++startRow; row <= endRow; ++row) {
-            HOCRItem* item = mutableItemAtIndex(parent.child(startRow, 0));
+            HOCRItem* item = child(parent, startRow);
             Q_ASSERT(item);
             moveChilds.append(item->takeChildren());
             bbox = bbox.united(item->bbox());
             deleteItem(item);
         }
-        endRemoveRows();
+        if(m_observer) {
+            m_observer->endRemoveItems(parent);
+        }
         int pos = targetItem->children().size();
-        beginInsertRows(targetIndex, pos, pos + moveChilds.size() - 1);
+        if(m_observer) {
+            m_observer->beginInsertItems(targetItem, pos, pos + moveChilds.size() - 1);
+        }
         for(HOCRItem* child : moveChilds) {
             targetItem->addChild(child);
         }
-        endInsertRows();
+        if(m_observer) {
+            m_observer->endInsertItems(targetItem);
+        }
     }
-    QString bboxstr = QString("%1 %2 %3 %4").arg(bbox.left()).arg(bbox.top()).arg(bbox.right()).arg(bbox.bottom());
-    targetItem->setAttribute("title:bbox", bboxstr);
-    emit itemAttributeChanged(targetIndex, "title:bbox", bboxstr);
-    return targetIndex;
+    targetItem->setBBox(bbox);
+    if(m_observer) {
+        m_observer->attributeChanged(targetItem, "title:bbox", HOCRItem::serializeBBox(bbox));
+    }
+    return targetItem;
 }
 
-QModelIndex HOCRDocument::splitItem(const QModelIndex& index, int startRow, int endRow) {
-    if(endRow - startRow < 0) {
-        return QModelIndex();
-    }
-    HOCRItem* item = mutableItemAtIndex(index);
-    if(!item) {
-        return QModelIndex();
+HOCRItem* HOCRDocument::splitItem(HOCRItem* item, int startRow, int endRow) {
+    if(endRow - startRow < 0 || !item) {
+        return nullptr;
     }
     QString itemClass = item->itemClass();
     QDomDocument doc;
@@ -186,129 +447,100 @@ QModelIndex HOCRDocument::splitItem(const QModelIndex& index, int startRow, int
     } else if(itemClass == "ocr_line") {
         newElement = doc.createElement("span");
     } else {
-        return QModelIndex();
+        return nullptr;
     }
     newElement.setAttribute("class", itemClass);
     newElement.setAttribute("title", HOCRItem::serializeAttrGroup(item->getTitleAttributes()));
-    HOCRItem* newItem = new HOCRItem(newElement, item->page(), item->parent(), item->index() + 1);
-    beginInsertRows(index.parent(), item->index() + 1, item->index() + 1);
-    insertItem(item->parent(), newItem, item->index() + 1);
-    endInsertRows();
-    QModelIndex newIndex = index.sibling(index.row() + 1, 0);
+    int newRow = item->index() + 1;
+    HOCRItem* newItem = new HOCRItem(newElement, item->page(), item->parent(), newRow);
+    if(m_observer) {
+        m_observer->beginInsertItems(item->parent(), newRow, newRow);
+    }
+    insertItem(item->parent(), newItem, newRow);
+    if(m_observer) {
+        m_observer->endInsertItems(item->parent());
+    }
     for(int row = 0; row <= (endRow - startRow); ++row) {
-        QModelIndex childIndex = index.child(startRow, 0);
-        HOCRItem* child = mutableItemAtIndex(childIndex);
+        HOCRItem* child = item->children().value(startRow);
         Q_ASSERT(child);
-        moveItem(childIndex, newIndex, row);
+        moveItem(child, newItem, row);
     }
 
-    return newIndex;
+    return newItem;
 }
 
-QModelIndex HOCRDocument::addItem(const QModelIndex& parent, const QDomElement& element) {
-    HOCRItem* parentItem = mutableItemAtIndex(parent);
-    if(!parentItem) {
-        return QModelIndex();
+HOCRItem* HOCRDocument::addItem(HOCRItem* parent, const QDomElement& element) {
+    if(!parent) {
+        return nullptr;
     }
-    HOCRItem* item = new HOCRItem(element, parentItem->page(), parentItem);
-    int pos = parentItem->children().size();
-    beginInsertRows(parent, pos, pos);
-    parentItem->addChild(item);
-    recomputeBBoxes(parentItem);
-    endInsertRows();
-    return index(pos, 0, parent);
+    HOCRItem* item = new HOCRItem(element, parent->page(), parent);
+    int pos = parent->children().size();
+    if(m_observer) {
+        m_observer->beginInsertItems(parent, pos, pos);
+    }
+    parent->addChild(item);
+    recomputeBBoxes(parent);
+    if(m_observer) {
+        m_observer->endInsertItems(parent);
+    }
+    return item;
 }
 
-bool HOCRDocument::removeItem(const QModelIndex& index) {
-    HOCRItem* item = mutableItemAtIndex(index);
+bool HOCRDocument::removeItem(HOCRItem* item) {
     if(!item) {
         return false;
     }
     HOCRItem* parentItem = item->parent();
-    beginRemoveRows(index.parent(), index.row(), index.row());
+    if(m_observer) {
+        m_observer->beginRemoveItems(parentItem, item->index(), item->index());
+    }
     deleteItem(item);
-    endRemoveRows();
+    if(m_observer) {
+        m_observer->endRemoveItems(parentItem);
+    }
     recomputeBBoxes(parentItem);
     return true;
 }
 
-QModelIndex HOCRDocument::nextIndex(const QModelIndex& current) {
-    QModelIndex idx = current;
-    // If the current index is invalid return first index
-    if(!idx.isValid()) {
-        return index(0, 0);
-    }
-    // If item has children, return first child
-    if(rowCount(idx) > 0) {
-        return idx.child(0, 0);
-    }
-    // Return next possible sibling
-    QModelIndex next = idx.sibling(idx.row() + 1, 0);
-    while(idx.isValid() && !next.isValid()) {
-        idx = idx.parent();
-        next = idx.sibling(idx.row() + 1, 0);
-    }
-    if(!idx.isValid()) {
-        // Wrap around
-        return index(0, 0);
-    }
-    return next;
-}
-
-QModelIndex HOCRDocument::prevIndex(const QModelIndex& current) {
-    QModelIndex idx = current;
-    // If the current index is invalid return last index
-    if(!idx.isValid()) {
-        return index(rowCount() - 1, 0);
-    }
-    // Return last possible leaf of previous sibling, if any, or parent
-    if(idx.row() > 0) {
-        idx = idx.sibling(idx.row() - 1, 0);
-    } else {
-        if(idx.parent().isValid()) {
-            return idx.parent();
-        }
-        // Wrap around
-        idx = index(rowCount() - 1, 0);
-    }
-    while(rowCount(idx) > 0) {
-        idx = idx.child(rowCount(idx) - 1, 0);
-    }
-    return idx;
-}
-
 bool HOCRDocument::referencesSource(const QString& filename) const {
-    for(const HOCRPage* page : m_pages) {
-        if(page->sourceFile() == filename) {
+    QMutexLocker locker(&m_pageMutex);
+    for(int i = 0, n = m_pages.size(); i < n; ++i) {
+        // Pages not built yet are answered from the lazy index
+        if((m_pages[i] ? m_pages[i]->sourceFile() : m_slots[i].sourceFile) == filename) {
             return true;
         }
     }
     return false;
 }
 
-QModelIndex HOCRDocument::searchPage(const QString& filename, int pageNr) const {
-    for(int iPage = 0, nPages = m_pages.size(); iPage < nPages; ++iPage) {
-        const HOCRPage* page = m_pages[iPage];
-        if(page->sourceFile() == filename && page->pageNr() == pageNr) {
-            return index(iPage, 0);
+const HOCRPage* HOCRDocument::searchPage(const QString& filename, int pageNr) const {
+    int found = -1;
+    {
+        QMutexLocker locker(&m_pageMutex);
+        for(int i = 0, n = m_pages.size(); found < 0 && i < n; ++i) {
+            const HOCRPage* page = m_pages[i];
+            if(page ? page->sourceFile() == filename && page->pageNr() == pageNr : m_slots[i].sourceFile == filename && m_slots[i].pageNr == pageNr) {
+                found = i;
+            }
         }
     }
-    return QModelIndex();
+    return found >= 0 ? page(found) : nullptr;
 }
 
-QModelIndex HOCRDocument::searchAtCanvasPos(const QModelIndex& pageIndex, const QPoint& pos) const {
-    QModelIndex index = pageIndex;
-    if(!index.isValid()) {
-        return QModelIndex();
+const HOCRItem* HOCRDocument::searchAtCanvasPos(const HOCRItem* item, const QPoint& pos) const {
+    if(!item) {
+        return nullptr;
+    }
+    if(!item->parent()) {
+        const HOCRItem* hit = item->page()->spatialIndex()->itemAt(pos);
+        return hit ? hit : item;
     }
-    const HOCRItem* item = itemAtIndex(index);
     while(true) {
         int iChild = 0, nChildren = item->children().size();
         for(; iChild < nChildren; ++iChild) {
             const HOCRItem* childItem = item->children()[iChild];
             if(childItem->bbox().contains(pos)) {
                 item = childItem;
-                index = index.child(iChild, 0);
                 break;
             }
         }
@@ -316,180 +548,78 @@ QModelIndex HOCRDocument::searchAtCanvasPos(const QModelIndex& pageIndex, const
             break;
         }
     }
-    return index;
+    return item;
 }
 
-void HOCRDocument::convertSourcePaths(const QString& basepath, bool absolute) {
-    for(HOCRPage* page : m_pages) {
-        page->convertSourcePath(basepath, absolute);
-    }
-}
-
-QVariant HOCRDocument::data(const QModelIndex& index, int role) const {
-    if (!index.isValid()) {
-        return QVariant();
-    }
-
-    HOCRItem* item = mutableItemAtIndex(index);
-
-    if(index.column() == 0) {
-        switch (role) {
-        case Qt::DisplayRole:
-        case Qt::EditRole:
-            return displayRoleForItem(item);
-        case Qt::DecorationRole:
-            return decorationRoleForItem(item);
-        case Qt::ForegroundRole: {
-            bool enabled = item->isEnabled();
-            const HOCRItem* parent = item->parent();
-            while(enabled && parent) {
-                enabled = parent->isEnabled();
-                parent = parent->parent();
-            }
-            return QVariant(QColor(208, 80, 82));
-        }
-        case Qt::CheckStateRole:
-            return item->isEnabled() ? Qt::Checked : Qt::Unchecked;
-        default:
-            break;
-        }
-    } else if(index.column() == 1) {
-        if(role == Qt::DisplayRole && item->itemClass() == "ocrx_word") {
-            return item->getTitleAttributes()["x_wconf"];
-        }
+QVector<const HOCRItem*> HOCRDocument::searchInRect(const HOCRItem* item, const QRect& rect, const QString& itemClass, bool contained) const {
+    if(!item) {
+        return QVector<const HOCRItem*>();
     }
-    return QVariant();
+    return item->page()->spatialIndex()->itemsInRect(rect, itemClass, contained);
 }
 
-bool HOCRDocument::setData(const QModelIndex& index, const QVariant& value, int role) {
-    if(!index.isValid()) {
-        return false;
-    }
-
-    HOCRItem* item = mutableItemAtIndex(index);
-    if(role == Qt::EditRole && item->itemClass() == "ocrx_word") {
-        item->setText(value.toString());
-        emit dataChanged(index, index, {Qt::DisplayRole, Qt::ForegroundRole});
-        return true;
-    } else if(role == Qt::CheckStateRole) {
-        item->setEnabled(value == Qt::Checked);
-        emit dataChanged(index, index, {Qt::CheckStateRole});
-        recursiveDataChanged(index, {Qt::CheckStateRole});
-        return true;
+void HOCRDocument::convertSourcePaths(const QString& basepath, bool absolute) {
+    for(int i = 0, n = m_pages.size(); i < n; ++i) {
+        page(i)->convertSourcePath(basepath, absolute);
     }
-    return false;
 }
 
-void HOCRDocument::recursiveDataChanged(const QModelIndex& parent, const QVector<int>& roles, const QStringList& itemClasses) {
-    int rows = rowCount(parent);
-    if(rows > 0) {
-        QModelIndex firstChild = index(0, 0, parent);
-        QString childItemClass = itemAtIndex(firstChild)->itemClass();
-        if(itemClasses.isEmpty() || itemClasses.contains(childItemClass)) {
-            emit dataChanged(firstChild, index(rows - 1, 0, parent), roles);
-        }
-        for(int i = 0; i < rows; ++i) {
-            recursiveDataChanged(index(i, 0, parent), roles, itemClasses);
-        }
-    }
+HOCRItem* HOCRDocument::child(HOCRItem* parent, int row) {
+    return parent ? parent->children().value(row) : page(row);
 }
 
 void HOCRDocument::recomputeBBoxes(HOCRItem* item) {
-    // Update parent bboxes (except page)
-    while(item && item->parent()) {
-        QRect bbox;
-        for(const HOCRItem* child : item->children()) {
-            bbox = bbox.united(child->bbox());
-        }
-        QString bboxstr = QString("%1 %2 %3 %4").arg(bbox.left()).arg(bbox.top()).arg(bbox.right()).arg(bbox.bottom());
-        item->setAttribute("title:bbox", bboxstr);
-        item = item->parent();
+    // Page bboxes are never recomputed
+    if(item && item->parent()) {
+        m_dirtyItems.insert(item);
     }
-}
-
-Qt::ItemFlags HOCRDocument::flags(const QModelIndex& index) const {
-    if (!index.isValid()) {
-        return 0;
+    if(m_editDepth == 0) {
+        updateBBoxes();
     }
-
-    HOCRItem* item = mutableItemAtIndex(index);
-    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable | (item->itemClass() == "ocrx_word" && index.column() == 0 ? Qt::ItemIsEditable : Qt::NoItemFlags);
 }
 
-QModelIndex HOCRDocument::index(int row, int column, const QModelIndex& parent) const {
-    if (!hasIndex(row, column, parent)) {
-        return QModelIndex();
-    }
-
-    HOCRItem* childItem = nullptr;
-    if(!parent.isValid()) {
-        childItem = m_pages.value(row);
-    } else {
-        HOCRItem* parentItem = mutableItemAtIndex(parent);
-        childItem = parentItem->children().value(row);
-    }
-    return childItem ? createIndex(row, column, childItem) : QModelIndex();
-}
-
-QModelIndex HOCRDocument::parent(const QModelIndex& child) const {
-    if (!child.isValid()) {
-        return QModelIndex();
-    }
-
-    HOCRItem* item = mutableItemAtIndex(child)->parent();
-    if(!item) {
-        return QModelIndex();
+void HOCRDocument::updateBBoxes() {
+    if(m_dirtyItems.isEmpty()) {
+        return;
     }
-    int row = item->index();
-    return row >= 0 ? createIndex(row, 0, item) : QModelIndex();
-}
-
-int HOCRDocument::rowCount(const QModelIndex& parent) const {
-    if (parent.column() > 0) {
-        return 0;
+    // Bucket the dirty items by depth, so that every item is recomputed after all its dirty descendants
+    QVector<QVector<HOCRItem*>> levels;
+    for(HOCRItem* item : m_dirtyItems) {
+        int depth = 0;
+        for(const HOCRItem* parent = item->parent(); parent; parent = parent->parent()) {
+            ++depth;
+        }
+        if(depth >= levels.size()) {
+            levels.resize(depth + 1);
+        }
+        levels[depth].append(item);
     }
-    return !parent.isValid() ? m_pages.size() : itemAtIndex(parent)->children().size();
-}
-
-int HOCRDocument::columnCount(const QModelIndex& /*parent*/) const {
-    return 2;
-}
-
-QString HOCRDocument::displayRoleForItem(const HOCRItem* item) const {
-    QString itemClass = item->itemClass();
-    if(itemClass == "ocr_page") {
-        const HOCRPage* page = static_cast<const HOCRPage*>(item);
-        return QString("%1 (%2 %3/%4)").arg(page->title()).arg(tr("Page")).arg(item->index() + 1).arg(m_pages.size());
-    } else if(itemClass == "ocr_carea") {
-        return _("Text block");
-    } else if(itemClass == "ocr_par") {
-        return _("Paragraph");
-    } else if(itemClass == "ocr_line") {
-        return _("Textline");
-    } else if(itemClass == "ocrx_word") {
-        return item->text();
-    } else if(itemClass == "ocr_graphic") {
-        return _("Graphic");
+    for(int depth = levels.size() - 1; depth > 0; --depth) {
+        for(HOCRItem* item : levels[depth]) {
+            QRect bbox;
+            for(const HOCRItem* child : item->children()) {
+                bbox = bbox.united(child->bbox());
+            }
+            if(bbox == item->bbox()) {
+                continue;
+            }
+            item->setBBox(bbox);
+            // Ancestors only change with their children
+            HOCRItem* parent = item->parent();
+            if(parent->parent() && !m_dirtyItems.contains(parent)) {
+                m_dirtyItems.insert(parent);
+                levels[depth - 1].append(parent);
+            }
+        }
     }
-    return "";
+    m_dirtyItems.clear();
 }
 
-QIcon HOCRDocument::decorationRoleForItem(const HOCRItem* item) const {
-    QString itemClass = item->itemClass();
-    if(itemClass == "ocr_page") {
-        return QIcon(":/icons/item_page");
-    } else if(itemClass == "ocr_carea") {
-        return QIcon(":/icons/item_block");
-    } else if(itemClass == "ocr_par") {
-        return QIcon(":/icons/item_par");
-    } else if(itemClass == "ocr_line") {
-        return QIcon(":/icons/item_line");
-    } else if(itemClass == "ocrx_word") {
-        return QIcon(":/icons/item_word");
-    } else if(itemClass == "ocr_graphic") {
-        return QIcon(":/icons/item_halftone");
+void HOCRDocument::forgetDirtyItems(const HOCRItem* item) {
+    m_dirtyItems.remove(const_cast<HOCRItem*>(item));
+    for(const HOCRItem* child : item->children()) {
+        forgetDirtyItems(child);
     }
-    return QIcon();
 }
 
 void HOCRDocument::insertItem(HOCRItem* parent, HOCRItem* item, int i) {
@@ -497,16 +627,26 @@ void HOCRDocument::insertItem(HOCRItem* parent, HOCRItem* item, int i) {
         parent->insertChild(item, i);
     } else if(HOCRPage* page = dynamic_cast<HOCRPage*>(item)) {
         page->m_index = i;
+        if(!m_slots.isEmpty()) {
+            m_slots.insert(i, m_takenSlots.take(page));
+        }
         m_pages.insert(i++, page);
         for(int n = m_pages.size(); i < n; ++i) {
-            m_pages[i]->m_index = i;
+            if(m_pages[i]) {
+                m_pages[i]->m_index = i;
+            }
         }
-        emit dataChanged(index(page->index(), 0), index(m_pages.size() - 1, 0), {Qt::DisplayRole});
     }
 }
 
 void HOCRDocument::deleteItem(HOCRItem* item) {
     takeItem(item);
+    if(!m_dirtyItems.isEmpty()) {
+        forgetDirtyItems(item);
+    }
+    if(!m_takenSlots.isEmpty()) {
+        m_takenSlots.remove(dynamic_cast<HOCRPage*>(item));
+    }
     delete item;
 }
 
@@ -515,11 +655,15 @@ void HOCRDocument::takeItem(HOCRItem* item) {
         item->parent()->takeChild(item);
     } else if(HOCRPage* page = dynamic_cast<HOCRPage*>(item)) {
         int i = page->index();
+        if(!m_slots.isEmpty()) {
+            m_takenSlots.insert(page, m_slots.takeAt(i));
+        }
         m_pages.remove(i);
         for(int n = m_pages.size(); i < n; ++i) {
-            m_pages[i]->m_index = i;
+            if(m_pages[i]) {
+                m_pages[i]->m_index = i;
+            }
         }
-        emit dataChanged(index(page->index(), 0), index(m_pages.size() - 1, 0), {Qt::DisplayRole});
     }
 }
 
@@ -528,11 +672,16 @@ void HOCRDocument::takeItem(HOCRItem* item) {
 
 QMap<QString, QString> HOCRItem::s_langCache = QMap<QString, QString>();
 
+bool HOCRItem::isLineClass(const QString& itemClass) {
+    return itemClass == "ocr_line" || itemClass == "ocr_header" || itemClass == "ocr_textfloat" || itemClass == "ocr_caption";
+}
+
 QMap<QString, QString> HOCRItem::deserializeAttrGroup(const QString& string) {
     QMap<QString, QString> attrs;
     for(const QString& attr : string.split(QRegExp("\\s*;\\s*"))) {
         int splitPos = attr.indexOf(QRegExp("\\s+"));
-        attrs.insert(attr.left(splitPos), attr.mid(splitPos + 1));
+        // A name without value, as serializeAttrGroup writes empty values
+        attrs.insert(attr.left(splitPos), splitPos < 0 ? QString() : attr.mid(splitPos + 1));
     }
     return attrs;
 }
@@ -545,6 +694,11 @@ QString HOCRItem::serializeAttrGroup(const QMap<QString, QString>& attrs) {
     return list.join("; ");
 }
 
+QString HOCRItem::serializeBBox(const QRect& bbox) {
+    return QString::number(bbox.left()) + ' ' + QString::number(bbox.top()) + ' ' +
+           QString::number(bbox.right()) + ' ' + QString::number(bbox.bottom());
+}
+
 QString HOCRItem::trimmedWord(const QString& word, QString* prefix, QString* suffix) {
     QRegExp wordRe("^(\\W*)(\\w*)(\\W*)$");
     if(wordRe.indexIn(word) != -1) {
@@ -573,11 +727,7 @@ HOCRItem::HOCRItem(const QDomElement& element, HOCRPage* page, HOCRItem* parent,
     }
     // Adjust item id based on pageId
     if(parent) {
-        QString idClass = itemClass().mid(itemClass().indexOf("_") + 1);
-        int counter = page->m_idCounters.value(idClass, 0) + 1;
-        page->m_idCounters[idClass] = counter;
-        QString newId = QString("%1_%2_%3").arg(idClass).arg(page->pageId()).arg(counter);
-        m_attrs["id"] = newId;
+        assignId(page);
     }
 
     // Parse item bbox
@@ -595,17 +745,24 @@ HOCRItem::HOCRItem(const QDomElement& element, HOCRPage* page, HOCRItem* parent,
         if(nextElement.isNull()) {
             m_text.replace(QRegExp("[-\u2014]\\s*$"), "-");
         }
-    } else if(itemClass() == "ocr_line") {
+    } else if(itemClass() == "ocr_line" && m_titleAttrs.contains("baseline")) {
         // Depending on the locale, tesseract can use a comma instead of a dot as decimal separator in the baseline...
         m_titleAttrs["baseline"] = m_titleAttrs["baseline"].replace(",", ".");
     }
 }
 
+HOCRItem::HOCRItem(const QMap<QString, QString>& attrs, const QMap<QString, QString>& titleAttrs, const QRect& bbox, HOCRPage* page, HOCRItem* parent, int index)
+    : m_attrs(attrs), m_titleAttrs(titleAttrs), m_pageItem(page), m_parentItem(parent), m_index(index), m_bbox(bbox) {
+    m_titleAttrs["bbox"] = serializeBBox(bbox);
+}
+
 HOCRItem::~HOCRItem() {
     qDeleteAll(m_childItems);
 }
 
 void HOCRItem::addChild(HOCRItem* child) {
+    m_pageItem->invalidateSpatialIndex();
+    m_pageItem->m_modified = true;
     m_childItems.append(child);
     child->m_parentItem = this;
     child->m_pageItem = m_pageItem;
@@ -613,6 +770,8 @@ void HOCRItem::addChild(HOCRItem* child) {
 }
 
 void HOCRItem::insertChild(HOCRItem* child, int i) {
+    m_pageItem->invalidateSpatialIndex();
+    m_pageItem->m_modified = true;
     m_childItems.insert(i, child);
     child->m_parentItem = this;
     child->m_pageItem = m_pageItem;
@@ -631,6 +790,8 @@ void HOCRItem::takeChild(HOCRItem* child) {
     if(this != child->parent()) {
         return;
     }
+    m_pageItem->invalidateSpatialIndex();
+    m_pageItem->m_modified = true;
     int i = child->index();
     m_childItems.remove(i);
     for(int n = m_childItems.size(); i < n; ++i) {
@@ -639,6 +800,8 @@ void HOCRItem::takeChild(HOCRItem* child) {
 }
 
 QVector<HOCRItem*> HOCRItem::takeChildren() {
+    m_pageItem->invalidateSpatialIndex();
+    m_pageItem->m_modified = true;
     QVector<HOCRItem*> children(m_childItems);
     m_childItems.clear();
     return children;
@@ -710,6 +873,7 @@ void HOCRItem::setAttribute(const QString& name, const QString& value, const QSt
         }
         return;
     }
+    m_pageItem->m_modified = true;
     QStringList parts = name.split(":");
     if(name == "bold") {
         m_bold = value == "1";
@@ -724,10 +888,28 @@ void HOCRItem::setAttribute(const QString& name, const QString& value, const QSt
             QStringList bbox = value.split(QRegExp("\\s+"));
             Q_ASSERT(bbox.size() == 4);
             m_bbox.setCoords(bbox[0].toInt(), bbox[1].toInt(), bbox[2].toInt(), bbox[3].toInt());
+            m_pageItem->invalidateSpatialIndex();
         }
     }
 }
 
+void HOCRItem::setBBox(const QRect& bbox) {
+    m_bbox = bbox;
+    m_titleAttrs["bbox"] = serializeBBox(bbox);
+    m_pageItem->invalidateSpatialIndex();
+    m_pageItem->m_modified = true;
+}
+
+void HOCRItem::setEnabled(bool enabled) {
+    m_enabled = enabled;
+    m_pageItem->m_modified = true;
+}
+
+void HOCRItem::setText(const QString& newText) {
+    m_text = newText;
+    m_pageItem->m_modified = true;
+}
+
 QString HOCRItem::toHtml(int indent) const {
     QString cls = itemClass();
     QString tag;
@@ -806,28 +988,27 @@ bool HOCRItem::parseChildren(const QDomElement& element, QString language) {
     }
     return haveWords;
 }
+
+void HOCRItem::assignId(HOCRPage* page) {
+    QString idClass = itemClass().mid(itemClass().indexOf("_") + 1);
+    int counter = page->m_idCounters.value(idClass, 0) + 1;
+    page->m_idCounters[idClass] = counter;
+    m_attrs["id"] = QString("%1_%2_%3").arg(idClass).arg(page->pageId()).arg(counter);
+}
 ///////////////////////////////////////////////////////////////////////////////
 
 HOCRPage::HOCRPage(const QDomElement& element, int pageId, const QString& language, bool cleanGraphics, int index)
     : HOCRItem(element, this, nullptr, index), m_pageId(pageId) {
     m_attrs["id"] = QString("page_%1").arg(pageId);
-
-    m_sourceFile = m_titleAttrs["image"].replace(QRegExp("^['\"]"), "").replace(QRegExp("['\"]$"), "");
-    m_pageNr = m_titleAttrs["ppageno"].toInt();
-    // Code to handle pageno -> ppageno typo in previous versions of gImageReader
-    if(m_pageNr == 0) {
-        m_pageNr = m_titleAttrs["pageno"].toInt();
-        m_titleAttrs["ppageno"] = m_titleAttrs["pageno"];
-        m_titleAttrs.remove("pageno");
-    }
-    m_angle = m_titleAttrs["rot"].toDouble();
-    m_resolution = m_titleAttrs["res"].toInt();
+    parsePageAttributes();
 
     QDomElement childElement = element.firstChildElement("div");
+    bool graphics = false;
     while(!childElement.isNull()) {
         HOCRItem* item = new HOCRItem(childElement, this, this, m_childItems.size());
         m_childItems.append(item);
         if(!item->parseChildren(childElement, language)) {
+            graphics = true;
             // No word children -> treat as graphic
             if(cleanGraphics && (item->bbox().width() < 10 || item->bbox().height() < 10)) {
                 // Ignore graphics which are less than 10 x 10
@@ -840,6 +1021,64 @@ HOCRPage::HOCRPage(const QDomElement& element, int pageId, const QString& langua
         }
         childElement = childElement.nextSiblingElement();
     }
+    // Graphics and dropped blocks were numbered as text blocks, written back they are read with other ids
+    if(graphics) {
+        assignIds(pageId);
+    }
+}
+
+HOCRPage::HOCRPage(const QMap<QString, QString>& attrs, const QMap<QString, QString>& titleAttrs, const QRect& bbox)
+    : HOCRItem(attrs, titleAttrs, bbox, this, nullptr) {
+    parsePageAttributes();
+}
+
+HOCRPage::~HOCRPage() {
+    delete m_spatialIndex;
+}
+
+void HOCRPage::parsePageAttributes() {
+    m_sourceFile = m_titleAttrs["image"].replace(QRegExp("^['\"]"), "").replace(QRegExp("['\"]$"), "");
+    m_pageNr = m_titleAttrs["ppageno"].toInt();
+    // Code to handle pageno -> ppageno typo in previous versions of gImageReader
+    if(m_pageNr == 0) {
+        m_pageNr = m_titleAttrs["pageno"].toInt();
+        m_titleAttrs["ppageno"] = m_titleAttrs["pageno"];
+        m_titleAttrs.remove("pageno");
+    }
+    m_angle = m_titleAttrs["rot"].toDouble();
+    m_resolution = m_titleAttrs["res"].toInt();
+}
+
+void HOCRPage::assignIds(int pageId) {
+    // Renumber all item ids in document order, matching the ids assigned when parsing from DOM
+    m_pageId = pageId;
+    m_idCounters.clear();
+    m_attrs["id"] = QString("page_%1").arg(pageId);
+    QVector<HOCRItem*> stack;
+    for(int i = m_childItems.size() - 1; i >= 0; --i) {
+        stack.append(m_childItems[i]);
+    }
+    while(!stack.isEmpty()) {
+        HOCRItem* item = stack.takeLast();
+        item->assignId(this);
+        for(int i = item->m_childItems.size() - 1; i >= 0; --i) {
+            stack.append(item->m_childItems[i]);
+        }
+    }
+}
+
+const HOCRSpatialIndex* HOCRPage::spatialIndex() const {
+    QMutexLocker locker(&m_spatialIndexMutex);
+    if(!m_spatialIndex) {
+        m_spatialIndex = new HOCRSpatialIndex(this);
+    }
+    return m_spatialIndex;
+}
+
+void HOCRPage::invalidateSpatialIndex() {
+    QMutexLocker locker(&m_spatialIndexMutex);
+    delete m_spatialIndex;
+    m_spatialIndex = nullptr;
 }
 
 QString HOCRPage::title() const {
@@ -853,4 +1092,5 @@ void HOCRPage::convertSourcePath(const QString& basepath, bool absolute) {
         m_sourceFile = QString(".%1%2").arg("/").arg(QDir(basepath).relativeFilePath(m_sourceFile));
     }
     m_titleAttrs["image"] = QString("'%1'").arg(m_sourceFile);
+    m_modified = true;
 }
@@ -20,84 +20,178 @@
 #ifndef HOCRDOCUMENT_HH
 #define HOCRDOCUMENT_HH
 
-#include <QAbstractItemModel>
 #include <QDomDocument>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
 #include <QRect>
+#include <QScopedPointer>
+#include <QSet>
+#include <QString>
+#include <QVector>
 
 class HOCRItem;
 class HOCRPage;
+class HOCRSpatialIndex;
 
-class HOCRDocument : public QAbstractItemModel {
-    Q_OBJECT
+/*
+ * Receives the structural changes of a HOCRDocument, e.g. to forward them to a model.
+ * A null parent stands for the page list.
+ */
+class HOCRDocumentObserver {
+public:
+    virtual ~HOCRDocumentObserver() {}
+    virtual void beginResetItems() = 0;
+    virtual void endResetItems() = 0;
+    virtual void beginInsertItems(const HOCRItem* parent, int first, int last) = 0;
+    virtual void endInsertItems(const HOCRItem* parent) = 0;
+    virtual void beginRemoveItems(const HOCRItem* parent, int first, int last) = 0;
+    virtual void endRemoveItems(const HOCRItem* parent) = 0;
+    virtual void textChanged(const HOCRItem* item) = 0;
+    virtual void attributeChanged(const HOCRItem* item, const QString& name, const QString& value) = 0;
+};
 
+/*
+ * The page tree and its editing operations. Without an observer, as in batch runs,
+ * nothing is reported; HOCRDocumentModel attaches itself as observer for views.
+ */
+class HOCRDocument {
 public:
-    HOCRDocument(QObject* parent = 0);
+    HOCRDocument();
     ~HOCRDocument();
 
+    void setObserver(HOCRDocumentObserver* observer) {
+        m_observer = observer;
+    }
     void clear();
 
     void setDefaultLanguage(const QString& language) {
         m_defaultLanguage = language;
     }
+    const QString& defaultLanguage() const {
+        return m_defaultLanguage;
+    }
 
     QString toHTML() const;
-
-    QModelIndex addPage(const QDomElement& pageElement, bool cleanGraphics);
-    const HOCRPage* page(int i) const {
-        return m_pages.value(i);
+    // Same markup as toHTML, streamed page by page. Unmodified pages of the lazily read file which
+    // HOCRPage would take over unchanged are copied from it verbatim, so the device must not write
+    // to that file in place.
+    bool writeHTML(QIODevice* device) const;
+
+    HOCRPage* addPage(const QDomElement& pageElement, bool cleanGraphics);
+    HOCRPage* addPage(HOCRPage* page);
+    // Lazy mode: only the page boundaries of the hOCR file are indexed, and the tree of a page is built
+    // from its byte range when first accessed. Trees handed out const are cached up to the cache limit,
+    // beyond it the least recently used unpinned ones are dropped again. Trees handed out non-const are
+    // kept for good, as they may be edited. The file stays mapped until the document is cleared.
+    // Files ending in .gz or .zst are decompressed to a temporary file first, which is removed with
+    // the document (on POSIX systems, as soon as it is open).
+    bool addPages(const QString& filename, bool cleanGraphics);
+    void setPageCacheLimit(qint64 bytes) {
+        m_pageCacheLimit = bytes;
     }
+    // Keeps the trees of pages [first, last) alive, e.g. while other threads work on them
+    void pinPages(int first, int last) const;
+    void unpinPages(int first, int last) const;
+    // Pins pages [first, last) for its lifetime, also on early returns
+    class PagePins {
+    public:
+        PagePins(const HOCRDocument& document, int first, int last) : m_document(document), m_first(first), m_last(last) {
+            m_document.pinPages(m_first, m_last);
+        }
+        ~PagePins() {
+            m_document.unpinPages(m_first, m_last);
+        }
+    private:
+        const HOCRDocument& m_document;
+        int m_first;
+        int m_last;
+    };
+    const HOCRPage* page(int i) const;
+    HOCRPage* page(int i);
     int pageCount() const {
         return m_pages.size();
     }
 
-    const HOCRItem* itemAtIndex(const QModelIndex& index) const {
-        return index.isValid() ? static_cast<HOCRItem*>(index.internalPointer()) : nullptr;
+    // Edits between beginEdits and the matching endEdits only mark the ancestors of the items
+    // they touch, endEdits then recomputes each marked bbox once, deepest first
+    void beginEdits() {
+        ++m_editDepth;
     }
-    bool editItemAttribute(const QModelIndex& index, const QString& name, const QString& value, const QString& attrItemClass = QString());
-    QModelIndex moveItem(const QModelIndex& itemIndex, const QModelIndex& newParent, int row);
-    QModelIndex swapItems(const QModelIndex& parent, int startRow, int endRow);
-    QModelIndex mergeItems(const QModelIndex& parent, int startRow, int endRow);
-    QModelIndex splitItem(const QModelIndex& item, int startRow, int endRow);
-    QModelIndex addItem(const QModelIndex& parent, const QDomElement& element);
-    bool removeItem(const QModelIndex& index);
-
-    QModelIndex nextIndex(const QModelIndex& current);
-    QModelIndex prevIndex(const QModelIndex& current);
+    void endEdits();
+    class EditBatch {
+    public:
+        explicit EditBatch(HOCRDocument& document) : m_document(document) {
+            m_document.beginEdits();
+        }
+        ~EditBatch() {
+            m_document.endEdits();
+        }
+    private:
+        HOCRDocument& m_document;
+    };
+
+    // Rows are children of parent, or pages if parent is null
+    bool setItemBBox(HOCRItem* item, const QRect& bbox);
+    bool editItemAttribute(HOCRItem* item, const QString& name, const QString& value, const QString& attrItemClass = QString());
+    bool moveItem(HOCRItem* item, HOCRItem* newParent, int row);
+    HOCRItem* swapItems(HOCRItem* parent, int firstRow, int secondRow);
+    HOCRItem* mergeItems(HOCRItem* parent, int startRow, int endRow);
+    HOCRItem* splitItem(HOCRItem* item, int startRow, int endRow);
+    HOCRItem* addItem(HOCRItem* parent, const QDomElement& element);
+    bool removeItem(HOCRItem* item);
 
     bool referencesSource(const QString& filename) const;
-    QModelIndex searchPage(const QString& filename, int pageNr) const;
-    QModelIndex searchAtCanvasPos(const QModelIndex& pageIndex, const QPoint& pos) const;
+    const HOCRPage* searchPage(const QString& filename, int pageNr) const;
+    const HOCRItem* searchAtCanvasPos(const HOCRItem* item, const QPoint& pos) const;
+    QVector<const HOCRItem*> searchInRect(const HOCRItem* item, const QRect& rect, const QString& itemClass = "ocrx_word", bool contained = false) const;
     void convertSourcePaths(const QString& basepath, bool absolute);
 
-    QVariant data(const QModelIndex& index, int role) const override;
-    bool setData(const QModelIndex& index, const QVariant& value, int role) override;
-    Qt::ItemFlags flags(const QModelIndex& index) const override;
-    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
-    QModelIndex parent(const QModelIndex& child) const override;
-    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
-    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
-
-signals:
-    void itemAttributeChanged(const QModelIndex& itemIndex, const QString& name, const QString& value);
-
 private:
+    HOCRDocumentObserver* m_observer = nullptr;
     int m_pageIdCounter = 0;
     QString m_defaultLanguage = "en_US";
 
     QVector<HOCRPage*> m_pages;
-
-    QString displayRoleForItem(const HOCRItem* item) const;
-    QIcon decorationRoleForItem(const HOCRItem* item) const;
-
-    bool checkItemSpelling(const HOCRItem* item) const;
+    int m_editDepth = 0;
+
+    struct PageSlot {
+        qint64 offset = -1; // Byte range in the lazily read file, if the page comes from there
+        qint64 length = 0;
+        int pageId = 0;
+        QString sourceFile;
+        int pageNr = 0;
+        int pins = 0;
+        bool resident = true; // Never dropped
+        quint64 lastUse = 0;
+    };
+    // Lazy mode state, m_slots runs parallel to m_pages and is empty for fully built documents
+    QScopedPointer<QFile> m_source; // A QTemporaryFile for decompressed input
+    const char* m_sourceData = nullptr;
+    bool m_sourceCleanGraphics = true;
+    QString m_sourceLanguage;
+    mutable QMutex m_pageMutex;
+    QVector<PageSlot> m_slots;
+    QHash<const HOCRPage*, PageSlot> m_takenSlots;
+    QMap<quint64, HOCRPage*> m_pageCache;
+    quint64 m_pageUseCounter = 0;
+    qint64 m_pageCacheCost = 0;
+    qint64 m_pageCacheLimit = 256 << 20;
+
+    QSet<HOCRItem*> m_dirtyItems;
+
+    HOCRItem* child(HOCRItem* parent, int row);
+    HOCRPage* loadPage(int i, bool keep);
+    void trimPageCache(const HOCRPage* keep);
+    void closeSource();
     void insertItem(HOCRItem* parent, HOCRItem* item, int i);
     void deleteItem(HOCRItem* item);
     void takeItem(HOCRItem* item);
-    void recursiveDataChanged(const QModelIndex& parent, const QVector<int>& roles, const QStringList& itemClasses = QStringList());
     void recomputeBBoxes(HOCRItem* item);
-    HOCRItem* mutableItemAtIndex(const QModelIndex& index) const {
-        return index.isValid() ? static_cast<HOCRItem*>(index.internalPointer()) : nullptr;
-    }
+    void updateBBoxes();
+    void forgetDirtyItems(const HOCRItem* item);
 };
 
 class HOCRItem {
@@ -106,6 +200,7 @@ public:
     typedef QMap<QString, QMap<QString, int>> AttrOccurenceMap_t;
 
     HOCRItem(const QDomElement& element, HOCRPage* page, HOCRItem* parent, int index = -1);
+    HOCRItem(const QMap<QString, QString>& attrs, const QMap<QString, QString>& titleAttrs, const QRect& bbox, HOCRPage* page, HOCRItem* parent, int index = -1);
     virtual ~HOCRItem();
     HOCRPage* page() const {
         return m_pageItem;
@@ -165,27 +260,30 @@ public:
     void removeChild(HOCRItem* child);
     void takeChild(HOCRItem* child);
     QVector<HOCRItem*> takeChildren();
-    void setEnabled(bool enabled) {
-        m_enabled = enabled;
-    }
-    void setText(const QString& newText) {
-        m_text = newText;
-    }
+    void setEnabled(bool enabled);
+    void setText(const QString& newText);
     void setAttribute(const QString& name, const QString& value, const QString& attrItemClass = QString());
+    void setBBox(const QRect& bbox);
 
     static QMap<QString, QString> deserializeAttrGroup(const QString& string);
     static QString serializeAttrGroup(const QMap<QString, QString>& attrs);
+    static QString serializeBBox(const QRect& bbox);
     static QString trimmedWord(const QString& word, QString* prefix = nullptr, QString* suffix = nullptr);
+    // Tesseract writes headers, floating text and captions as lines of their own classes
+    static bool isLineClass(const QString& itemClass);
 
 protected:
     friend class HOCRDocument;
     friend class HOCRPage;
+    friend class HOCRPageBuilder;
+    friend class HOCRPageScanner;
+    friend class HOCRSnapshot;
 
     static QMap<QString, QString> s_langCache;
 
     QString m_text;
-    bool m_bold;
-    bool m_italic;
+    bool m_bold = false;
+    bool m_italic = false;
 
     QMap<QString, QString> m_attrs;
     QMap<QString, QString> m_titleAttrs;
@@ -198,12 +296,15 @@ protected:
     QRect m_bbox;
 
     bool parseChildren(const QDomElement& element, QString language);
+    void assignId(HOCRPage* page);
 };
 
 
 class HOCRPage : public HOCRItem {
 public:
     HOCRPage(const QDomElement& element, int pageId, const QString& language, bool cleanGraphics, int index);
+    HOCRPage(const QMap<QString, QString>& attrs, const QMap<QString, QString>& titleAttrs, const QRect& bbox);
+    ~HOCRPage();
 
     const QString& sourceFile() const {
         return m_sourceFile;
@@ -222,19 +323,34 @@ public:
         return m_pageId;
     }
     QString title() const;
+    // Built on first use, dropped whenever the item tree or a bbox changes. Building is serialized, as
+    // pages are read from several threads; edits must not run concurrently with readers
+    const HOCRSpatialIndex* spatialIndex() const;
+    void invalidateSpatialIndex();
+    // Whether the tree was edited since it was built or added to the document
+    bool isModified() const {
+        return m_modified;
+    }
 
 private:
     friend class HOCRItem;
     friend class HOCRDocument;
+    friend class HOCRPageBuilder;
+    friend class HOCRSnapshot;
 
-    int m_pageId;
+    int m_pageId = 0;
     QMap<QString, int> m_idCounters;
     QString m_sourceFile;
     int m_pageNr;
     double m_angle;
     int m_resolution;
+    mutable QMutex m_spatialIndexMutex;
+    mutable HOCRSpatialIndex* m_spatialIndex = nullptr;
+    bool m_modified = false;
 
     void convertSourcePath(const QString& basepath, bool absolute);
+    void parsePageAttributes();
+    void assignIds(int pageId);
 };
 
 
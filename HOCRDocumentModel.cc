@@ -0,0 +1,344 @@
+#include <QColor>
+#include <QIcon>
+#include <QPalette>
+#include "common.hh"
+#include "HOCRDocumentModel.hh"
+
+
+HOCRDocumentModel::HOCRDocumentModel(HOCRDocument* document, QObject* parent)
+    : QAbstractItemModel(parent), m_document(document) {
+    m_document->setObserver(this);
+}
+
+HOCRDocumentModel::~HOCRDocumentModel() {
+    m_document->setObserver(nullptr);
+}
+
+void HOCRDocumentModel::setDictionary(const WordDictionary* dictionary) {
+    m_dictionary = dictionary;
+    recursiveDataChanged(QModelIndex(), {Qt::ForegroundRole}, {"ocrx_word"});
+}
+
+QModelIndex HOCRDocumentModel::addPage(const QDomElement& pageElement, bool cleanGraphics) {
+    return indexAtItem(m_document->addPage(pageElement, cleanGraphics));
+}
+
+QModelIndex HOCRDocumentModel::addPage(HOCRPage* page) {
+    return indexAtItem(m_document->addPage(page));
+}
+
+QModelIndex HOCRDocumentModel::indexAtItem(const HOCRItem* item) const {
+    return item ? createIndex(item->index(), 0, const_cast<HOCRItem*>(item)) : QModelIndex();
+}
+
+bool HOCRDocumentModel::editItemAttribute(const QModelIndex& index, const QString& name, const QString& value, const QString& attrItemClass) {
+    return m_document->editItemAttribute(mutableItemAtIndex(index), name, value, attrItemClass);
+}
+
+QModelIndex HOCRDocumentModel::moveItem(const QModelIndex& itemIndex, const QModelIndex& newParent, int row) {
+    HOCRItem* item = mutableItemAtIndex(itemIndex);
+    return m_document->moveItem(item, mutableItemAtIndex(newParent), row) ? indexAtItem(item) : QModelIndex();
+}
+
+QModelIndex HOCRDocumentModel::swapItems(const QModelIndex& parent, int firstRow, int secondRow) {
+    return indexAtItem(m_document->swapItems(mutableItemAtIndex(parent), firstRow, secondRow));
+}
+
+QModelIndex HOCRDocumentModel::mergeItems(const QModelIndex& parent, int startRow, int endRow) {
+    return indexAtItem(m_document->mergeItems(mutableItemAtIndex(parent), startRow, endRow));
+}
+
+QModelIndex HOCRDocumentModel::splitItem(const QModelIndex& index, int startRow, int endRow) {
+    return indexAtItem(m_document->splitItem(mutableItemAtIndex(index), startRow, endRow));
+}
+
+QModelIndex HOCRDocumentModel::addItem(const QModelIndex& parent, const QDomElement& element) {
+    return indexAtItem(m_document->addItem(mutableItemAtIndex(parent), element));
+}
+
+bool HOCRDocumentModel::removeItem(const QModelIndex& index) {
+    return m_document->removeItem(mutableItemAtIndex(index));
+}
+
+QModelIndex HOCRDocumentModel::nextIndex(const QModelIndex& current) {
+    QModelIndex idx = current;
+    // If the current index is invalid return first index
+    if(!idx.isValid()) {
+        return index(0, 0);
+    }
+    // If item has children, return first child
+    if(rowCount(idx) > 0) {
+        return idx.child(0, 0);
+    }
+    // Return next possible sibling
+    QModelIndex next = idx.sibling(idx.row() + 1, 0);
+    while(idx.isValid() && !next.isValid()) {
+        idx = idx.parent();
+        next = idx.sibling(idx.row() + 1, 0);
+    }
+    if(!idx.isValid()) {
+        // Wrap around
+        return index(0, 0);
+    }
+    return next;
+}
+
+QModelIndex HOCRDocumentModel::prevIndex(const QModelIndex& current) {
+    QModelIndex idx = current;
+    // If the current index is invalid return last index
+    if(!idx.isValid()) {
+        return index(rowCount() - 1, 0);
+    }
+    // Return last possible leaf of previous sibling, if any, or parent
+    if(idx.row() > 0) {
+        idx = idx.sibling(idx.row() - 1, 0);
+    } else {
+        if(idx.parent().isValid()) {
+            return idx.parent();
+        }
+        // Wrap around
+        idx = index(rowCount() - 1, 0);
+    }
+    while(rowCount(idx) > 0) {
+        idx = idx.child(rowCount(idx) - 1, 0);
+    }
+    return idx;
+}
+
+QModelIndex HOCRDocumentModel::searchPage(const QString& filename, int pageNr) const {
+    return indexAtItem(m_document->searchPage(filename, pageNr));
+}
+
+QModelIndex HOCRDocumentModel::searchAtCanvasPos(const QModelIndex& pageIndex, const QPoint& pos) const {
+    return indexAtItem(m_document->searchAtCanvasPos(itemAtIndex(pageIndex), pos));
+}
+
+QModelIndexList HOCRDocumentModel::searchInRect(const QModelIndex& pageIndex, const QRect& rect, const QString& itemClass, bool contained) const {
+    QModelIndexList result;
+    for(const HOCRItem* hit : m_document->searchInRect(itemAtIndex(pageIndex), rect, itemClass, contained)) {
+        result.append(indexAtItem(hit));
+    }
+    return result;
+}
+
+QVariant HOCRDocumentModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    HOCRItem* item = mutableItemAtIndex(index);
+
+    if(index.column() == 0) {
+        switch (role) {
+        case Qt::DisplayRole:
+        case Qt::EditRole:
+            return displayRoleForItem(item);
+        case Qt::DecorationRole:
+            return decorationRoleForItem(item);
+        case Qt::ForegroundRole: {
+            bool enabled = item->isEnabled();
+            const HOCRItem* parent = item->parent();
+            while(enabled && parent) {
+                enabled = parent->isEnabled();
+                parent = parent->parent();
+            }
+            if(!enabled) {
+                return QVariant::fromValue(QPalette().color(QPalette::Disabled, QPalette::Text));
+            } else if(item->itemClass() == "ocrx_word" && !checkItemSpelling(item)) {
+                return QVariant::fromValue(QColor(208, 80, 82));
+            }
+            break;
+        }
+        case Qt::CheckStateRole:
+            return item->isEnabled() ? Qt::Checked : Qt::Unchecked;
+        default:
+            break;
+        }
+    } else if(index.column() == 1) {
+        if(role == Qt::DisplayRole && item->itemClass() == "ocrx_word") {
+            return item->getTitleAttributes()["x_wconf"];
+        }
+    }
+    return QVariant();
+}
+
+bool HOCRDocumentModel::setData(const QModelIndex& index, const QVariant& value, int role) {
+    if(!index.isValid()) {
+        return false;
+    }
+
+    HOCRItem* item = mutableItemAtIndex(index);
+    if(role == Qt::EditRole && item->itemClass() == "ocrx_word") {
+        item->setText(value.toString());
+        emit dataChanged(index, index, {Qt::DisplayRole, Qt::ForegroundRole});
+        return true;
+    } else if(role == Qt::CheckStateRole) {
+        item->setEnabled(value == Qt::Checked);
+        emit dataChanged(index, index, {Qt::CheckStateRole});
+        recursiveDataChanged(index, {Qt::CheckStateRole});
+        return true;
+    }
+    return false;
+}
+
+void HOCRDocumentModel::recursiveDataChanged(const QModelIndex& parent, const QVector<int>& roles, const QStringList& itemClasses) {
+    int rows = rowCount(parent);
+    if(rows > 0) {
+        QModelIndex firstChild = index(0, 0, parent);
+        QString childItemClass = itemAtIndex(firstChild)->itemClass();
+        if(itemClasses.isEmpty() || itemClasses.contains(childItemClass)) {
+            emit dataChanged(firstChild, index(rows - 1, 0, parent), roles);
+        }
+        for(int i = 0; i < rows; ++i) {
+            recursiveDataChanged(index(i, 0, parent), roles, itemClasses);
+        }
+    }
+}
+
+bool HOCRDocumentModel::checkItemSpelling(const HOCRItem* item) const {
+    if(!m_dictionary) {
+        return true;
+    }
+    QString word = HOCRItem::trimmedWord(item->text());
+    return word.isEmpty() || m_dictionary->contains(word);
+}
+
+void HOCRDocumentModel::pagesChanged() {
+    // Page titles include the page count
+    int pageCount = m_document->pageCount();
+    if(pageCount > 0) {
+        emit dataChanged(index(0, 0), index(pageCount - 1, 0), {Qt::DisplayRole});
+    }
+}
+
+Qt::ItemFlags HOCRDocumentModel::flags(const QModelIndex& index) const {
+    if (!index.isValid()) {
+        return 0;
+    }
+
+    HOCRItem* item = mutableItemAtIndex(index);
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable | (item->itemClass() == "ocrx_word" && index.column() == 0 ? Qt::ItemIsEditable : Qt::NoItemFlags);
+}
+
+QModelIndex HOCRDocumentModel::index(int row, int column, const QModelIndex& parent) const {
+    if (!hasIndex(row, column, parent)) {
+        return QModelIndex();
+    }
+
+    HOCRItem* childItem = nullptr;
+    if(!parent.isValid()) {
+        childItem = m_document->page(row);
+    } else {
+        HOCRItem* parentItem = mutableItemAtIndex(parent);
+        childItem = parentItem->children().value(row);
+    }
+    return childItem ? createIndex(row, column, childItem) : QModelIndex();
+}
+
+QModelIndex HOCRDocumentModel::parent(const QModelIndex& child) const {
+    if (!child.isValid()) {
+        return QModelIndex();
+    }
+
+    HOCRItem* item = mutableItemAtIndex(child)->parent();
+    if(!item) {
+        return QModelIndex();
+    }
+    int row = item->index();
+    return row >= 0 ? createIndex(row, 0, item) : QModelIndex();
+}
+
+int HOCRDocumentModel::rowCount(const QModelIndex& parent) const {
+    if (parent.column() > 0) {
+        return 0;
+    }
+    return !parent.isValid() ? m_document->pageCount() : itemAtIndex(parent)->children().size();
+}
+
+int HOCRDocumentModel::columnCount(const QModelIndex& /*parent*/) const {
+    return 2;
+}
+
+QString HOCRDocumentModel::displayRoleForItem(const HOCRItem* item) const {
+    QString itemClass = item->itemClass();
+    if(itemClass == "ocr_page") {
+        const HOCRPage* page = static_cast<const HOCRPage*>(item);
+        return QString("%1 (%2 %3/%4)").arg(page->title()).arg(tr("Page")).arg(item->index() + 1).arg(m_document->pageCount());
+    } else if(itemClass == "ocr_carea") {
+        return _("Text block");
+    } else if(itemClass == "ocr_par") {
+        return _("Paragraph");
+    } else if(itemClass == "ocr_line") {
+        return _("Textline");
+    } else if(itemClass == "ocrx_word") {
+        return item->text();
+    } else if(itemClass == "ocr_graphic") {
+        return _("Graphic");
+    }
+    return "";
+}
+
+QIcon HOCRDocumentModel::decorationRoleForItem(const HOCRItem* item) const {
+    QString itemClass = item->itemClass();
+    if(itemClass == "ocr_page") {
+        return QIcon(":/icons/item_page");
+    } else if(itemClass == "ocr_carea") {
+        return QIcon(":/icons/item_block");
+    } else if(itemClass == "ocr_par") {
+        return QIcon(":/icons/item_par");
+    } else if(itemClass == "ocr_line") {
+        return QIcon(":/icons/item_line");
+    } else if(itemClass == "ocrx_word") {
+        return QIcon(":/icons/item_word");
+    } else if(itemClass == "ocr_graphic") {
+        return QIcon(":/icons/item_halftone");
+    }
+    return QIcon();
+}
+
+void HOCRDocumentModel::beginResetItems() {
+    beginResetModel();
+}
+
+void HOCRDocumentModel::endResetItems() {
+    endResetModel();
+}
+
+void HOCRDocumentModel::beginInsertItems(const HOCRItem* parent, int first, int last) {
+    beginInsertRows(indexAtItem(parent), first, last);
+}
+
+void HOCRDocumentModel::endInsertItems(const HOCRItem* parent) {
+    endInsertRows();
+    if(!parent) {
+        pagesChanged();
+    }
+}
+
+void HOCRDocumentModel::beginRemoveItems(const HOCRItem* parent, int first, int last) {
+    beginRemoveRows(indexAtItem(parent), first, last);
+}
+
+void HOCRDocumentModel::endRemoveItems(const HOCRItem* parent) {
+    endRemoveRows();
+    if(!parent) {
+        pagesChanged();
+    }
+}
+
+void HOCRDocumentModel::textChanged(const HOCRItem* item) {
+    QModelIndex index = indexAtItem(item);
+    emit dataChanged(index, index, {Qt::DisplayRole, Qt::ForegroundRole});
+}
+
+void HOCRDocumentModel::attributeChanged(const HOCRItem* item, const QString& name, const QString& value) {
+    QModelIndex index = indexAtItem(item);
+    if(name == "title:x_wconf") {
+        QModelIndex colIdx = index.sibling(index.row(), 1);
+        emit dataChanged(colIdx, colIdx, {Qt::DisplayRole});
+    }
+    if(name == "lang") {
+        recursiveDataChanged(index, {Qt::DisplayRole}, {"ocrx_word"});
+    }
+    emit itemAttributeChanged(index, name, value);
+}
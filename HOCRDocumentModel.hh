@@ -0,0 +1,83 @@
+#ifndef HOCRDOCUMENTMODEL_HH
+#define HOCRDOCUMENTMODEL_HH
+
+#include <QAbstractItemModel>
+#include "HOCRDocument.hh"
+#include "WordDictionary.hh"
+
+/*
+ * Item model over a HOCRDocument for views. The model attaches itself as observer of the
+ * document for its lifetime; the document stays owned by the caller.
+ */
+class HOCRDocumentModel : public QAbstractItemModel, public HOCRDocumentObserver {
+    Q_OBJECT
+
+public:
+    HOCRDocumentModel(HOCRDocument* document, QObject* parent = 0);
+    ~HOCRDocumentModel();
+
+    HOCRDocument* document() const {
+        return m_document;
+    }
+    // Words missing from the dictionary are highlighted, the dictionary stays owned by the caller
+    void setDictionary(const WordDictionary* dictionary);
+
+    QModelIndex addPage(const QDomElement& pageElement, bool cleanGraphics);
+    QModelIndex addPage(HOCRPage* page);
+
+    const HOCRItem* itemAtIndex(const QModelIndex& index) const {
+        return index.isValid() ? static_cast<HOCRItem*>(index.internalPointer()) : nullptr;
+    }
+    QModelIndex indexAtItem(const HOCRItem* item) const;
+    bool editItemAttribute(const QModelIndex& index, const QString& name, const QString& value, const QString& attrItemClass = QString());
+    QModelIndex moveItem(const QModelIndex& itemIndex, const QModelIndex& newParent, int row);
+    QModelIndex swapItems(const QModelIndex& parent, int startRow, int endRow);
+    QModelIndex mergeItems(const QModelIndex& parent, int startRow, int endRow);
+    QModelIndex splitItem(const QModelIndex& item, int startRow, int endRow);
+    QModelIndex addItem(const QModelIndex& parent, const QDomElement& element);
+    bool removeItem(const QModelIndex& index);
+
+    QModelIndex nextIndex(const QModelIndex& current);
+    QModelIndex prevIndex(const QModelIndex& current);
+
+    QModelIndex searchPage(const QString& filename, int pageNr) const;
+    QModelIndex searchAtCanvasPos(const QModelIndex& pageIndex, const QPoint& pos) const;
+    QModelIndexList searchInRect(const QModelIndex& pageIndex, const QRect& rect, const QString& itemClass = "ocrx_word", bool contained = false) const;
+
+    QVariant data(const QModelIndex& index, int role) const override;
+    bool setData(const QModelIndex& index, const QVariant& value, int role) override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+
+signals:
+    void itemAttributeChanged(const QModelIndex& itemIndex, const QString& name, const QString& value);
+
+private:
+    HOCRDocument* m_document;
+    const WordDictionary* m_dictionary = nullptr;
+
+    QString displayRoleForItem(const HOCRItem* item) const;
+    QIcon decorationRoleForItem(const HOCRItem* item) const;
+
+    bool checkItemSpelling(const HOCRItem* item) const;
+    void recursiveDataChanged(const QModelIndex& parent, const QVector<int>& roles, const QStringList& itemClasses = QStringList());
+    void pagesChanged();
+    HOCRItem* mutableItemAtIndex(const QModelIndex& index) const {
+        return index.isValid() ? static_cast<HOCRItem*>(index.internalPointer()) : nullptr;
+    }
+
+    // HOCRDocumentObserver
+    void beginResetItems() override;
+    void endResetItems() override;
+    void beginInsertItems(const HOCRItem* parent, int first, int last) override;
+    void endInsertItems(const HOCRItem* parent) override;
+    void beginRemoveItems(const HOCRItem* parent, int first, int last) override;
+    void endRemoveItems(const HOCRItem* parent) override;
+    void textChanged(const HOCRItem* item) override;
+    void attributeChanged(const HOCRItem* item, const QString& name, const QString& value) override;
+};
+
+#endif // HOCRDOCUMENTMODEL_HH
@@ -0,0 +1,182 @@
+#include <cmath>
+#include <cstring>
+#include <tesseract/resultiterator.h>
+#include <QRegExp>
+#include "HOCRDocument.hh"
+#include "HOCRPageBuilder.hh"
+
+static QRect boundingBox(const tesseract::ResultIterator* it, tesseract::PageIteratorLevel level) {
+    int left = 0, top = 0, right = 0, bottom = 0;
+    it->BoundingBox(level, &left, &top, &right, &bottom);
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+static QMap<QString, QString> lineTitleAttributes(const tesseract::ResultIterator* it, const QRect& bbox) {
+    QMap<QString, QString> titleAttrs;
+    tesseract::Orientation orientation;
+    tesseract::WritingDirection writingDirection;
+    tesseract::TextlineOrder textlineOrder;
+    float deskewAngle;
+    it->Orientation(&orientation, &writingDirection, &textlineOrder, &deskewAngle);
+    int x1, y1, x2, y2;
+    if(orientation != tesseract::ORIENTATION_PAGE_UP) {
+        titleAttrs["textangle"] = QString::number(360 - orientation * 90);
+    } else if(it->Baseline(tesseract::RIL_TEXTLINE, &x1, &y1, &x2, &y2) && x1 != x2) {
+        // y = p1 * x + p0, with the bottom left corner of the line as origin
+        x1 -= bbox.left();
+        x2 -= bbox.left();
+        y1 -= bbox.bottom();
+        y2 -= bbox.bottom();
+        double p1 = (y2 - y1) / double(x2 - x1);
+        double p0 = y1 - p1 * x1;
+        titleAttrs["baseline"] = QString("%1 %2").arg(std::round(p1 * 1000.0) / 1000.0).arg(std::round(p0 * 1000.0) / 1000.0);
+    }
+    float rowHeight, descenders, ascenders;
+    it->RowAttributes(&rowHeight, &descenders, &ascenders);
+    titleAttrs["x_size"] = QString::number(rowHeight);
+    titleAttrs["x_descenders"] = QString::number(-descenders);
+    titleAttrs["x_ascenders"] = QString::number(ascenders);
+    return titleAttrs;
+}
+
+HOCRPage* HOCRPageBuilder::build(tesseract::ResultIterator* it, const QRect& pageRect, const QMap<QString, QString>& pageTitleAttrs,
+                                 const QString& language, bool cleanGraphics) {
+    QMap<QString, QString> pageAttrs;
+    pageAttrs["class"] = "ocr_page";
+    HOCRPage* page = new HOCRPage(pageAttrs, pageTitleAttrs, pageRect);
+    if(!it) {
+        return page;
+    }
+
+    HOCRItem* block = nullptr;
+    HOCRItem* par = nullptr;
+    HOCRItem* line = nullptr;
+    QString parLanguage = language;
+    const char* parTessLanguage = nullptr;
+    bool parLtr = true;
+    while(!it->Empty(tesseract::RIL_BLOCK)) {
+        if(it->Empty(tesseract::RIL_WORD)) {
+            it->Next(tesseract::RIL_WORD);
+            continue;
+        }
+        if(!block || it->IsAtBeginningOf(tesseract::RIL_BLOCK)) {
+            QMap<QString, QString> attrs;
+            attrs["class"] = "ocr_carea";
+            block = new HOCRItem(attrs, QMap<QString, QString>(), boundingBox(it, tesseract::RIL_BLOCK), page, page);
+            page->addChild(block);
+            par = line = nullptr;
+        }
+        if(!par || it->IsAtBeginningOf(tesseract::RIL_PARA)) {
+            QMap<QString, QString> attrs;
+            attrs["class"] = "ocr_par";
+            parLtr = it->ParagraphIsLtr();
+            if(!parLtr) {
+                attrs["dir"] = "rtl";
+            }
+            parTessLanguage = it->WordRecognitionLanguage();
+            parLanguage = itemLanguage(parTessLanguage, language);
+            par = new HOCRItem(attrs, QMap<QString, QString>(), boundingBox(it, tesseract::RIL_PARA), page, block);
+            block->addChild(par);
+            line = nullptr;
+        }
+        if(!line || it->IsAtBeginningOf(tesseract::RIL_TEXTLINE)) {
+            QMap<QString, QString> attrs;
+            switch(it->BlockType()) {
+            case PT_HEADING_TEXT:
+                attrs["class"] = "ocr_header";
+                break;
+            case PT_PULLOUT_TEXT:
+                attrs["class"] = "ocr_textfloat";
+                break;
+            case PT_CAPTION_TEXT:
+                attrs["class"] = "ocr_caption";
+                break;
+            default:
+                attrs["class"] = "ocr_line";
+            }
+            QRect bbox = boundingBox(it, tesseract::RIL_TEXTLINE);
+            line = new HOCRItem(attrs, lineTitleAttributes(it, bbox), bbox, page, par);
+            par->addChild(line);
+        }
+
+        const char* wordTessLanguage = it->WordRecognitionLanguage();
+        bool ownLanguage = wordTessLanguage && (!parTessLanguage || std::strcmp(wordTessLanguage, parTessLanguage) != 0);
+        addWord(it, line, ownLanguage ? itemLanguage(wordTessLanguage, parLanguage) : parLanguage, parLtr);
+        it->Next(tesseract::RIL_WORD);
+    }
+
+    // Blocks without any words are graphics, tiny ones are dropped
+    for(int i = page->m_childItems.size() - 1; i >= 0; --i) {
+        HOCRItem* item = page->m_childItems[i];
+        if(hasWords(item)) {
+            continue;
+        }
+        if(cleanGraphics && (item->bbox().width() < 10 || item->bbox().height() < 10)) {
+            page->removeChild(item);
+        } else {
+            item->setAttribute("class", "ocr_graphic");
+            qDeleteAll(item->m_childItems);
+            item->m_childItems.clear();
+        }
+    }
+    return page;
+}
+
+HOCRItem* HOCRPageBuilder::addWord(tesseract::ResultIterator* it, HOCRItem* line, const QString& language, bool parLtr) {
+    bool bold = false, italic = false, underlined = false, monospace = false, serif = false, smallcaps = false;
+    int pointSize = 0, fontId = -1;
+    const char* fontName = it->WordFontAttributes(&bold, &italic, &underlined, &monospace, &serif, &smallcaps, &pointSize, &fontId);
+
+    QMap<QString, QString> attrs;
+    attrs["class"] = "ocrx_word";
+    attrs["lang"] = language;
+    tesseract::StrongScriptDirection direction = it->WordDirection();
+    if(direction == tesseract::DIR_LEFT_TO_RIGHT && !parLtr) {
+        attrs["dir"] = "ltr";
+    } else if(direction == tesseract::DIR_RIGHT_TO_LEFT && parLtr) {
+        attrs["dir"] = "rtl";
+    }
+    QMap<QString, QString> titleAttrs;
+    titleAttrs["x_wconf"] = QString::number(int(it->Confidence(tesseract::RIL_WORD)));
+    if(fontName) {
+        titleAttrs["x_font"] = QString::fromUtf8(fontName);
+    }
+    titleAttrs["x_fsize"] = QString::number(pointSize);
+
+    HOCRItem* word = new HOCRItem(attrs, titleAttrs, boundingBox(it, tesseract::RIL_WORD), line->page(), line);
+    char* text = it->GetUTF8Text(tesseract::RIL_WORD);
+    word->m_text = QString::fromUtf8(text);
+    delete[] text;
+    word->m_bold = bold;
+    word->m_italic = italic;
+    // For the last word items of the line, ensure the correct hyphen is used
+    if(it->IsAtFinalElement(tesseract::RIL_TEXTLINE, tesseract::RIL_WORD)) {
+        word->m_text.replace(QRegExp("[-\u2014]\\s*$"), "-");
+    }
+    line->addChild(word);
+    return word;
+}
+
+QString HOCRPageBuilder::itemLanguage(const char* tessLanguage, const QString& language) {
+    if(!tessLanguage || !*tessLanguage) {
+        return language;
+    }
+    QString lang = QString::fromUtf8(tessLanguage);
+    auto it = HOCRItem::s_langCache.find(lang);
+    if(it == HOCRItem::s_langCache.end()) {
+        it = HOCRItem::s_langCache.insert(lang, "en_US");
+    }
+    return it.value();
+}
+
+bool HOCRPageBuilder::hasWords(const HOCRItem* item) {
+    if(item->itemClass() == "ocrx_word") {
+        return !item->text().isEmpty();
+    }
+    for(const HOCRItem* child : item->children()) {
+        if(hasWords(child)) {
+            return true;
+        }
+    }
+    return false;
+}
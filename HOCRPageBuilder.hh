@@ -0,0 +1,31 @@
+#ifndef HOCRPAGEBUILDER_HH
+#define HOCRPAGEBUILDER_HH
+
+#include <QMap>
+#include <QRect>
+#include <QString>
+
+class HOCRItem;
+class HOCRPage;
+namespace tesseract {
+class ResultIterator;
+}
+
+/*
+ * Builds a HOCRPage straight from Tesseract's recognition results.
+ * The tree, classes and title attributes match what parsing the output of GetHOCRText
+ * with HOCRDocument::addPage(QDomElement, cleanGraphics) gives, without the XML round trip.
+ */
+class HOCRPageBuilder {
+public:
+    // pageTitleAttrs are the page title attributes besides the bbox (image, ppageno, rot, res)
+    static HOCRPage* build(tesseract::ResultIterator* it, const QRect& pageRect, const QMap<QString, QString>& pageTitleAttrs,
+                           const QString& language, bool cleanGraphics);
+
+private:
+    static HOCRItem* addWord(tesseract::ResultIterator* it, HOCRItem* line, const QString& language, bool parLtr);
+    static QString itemLanguage(const char* tessLanguage, const QString& language);
+    static bool hasWords(const HOCRItem* item);
+};
+
+#endif // HOCRPAGEBUILDER_HH
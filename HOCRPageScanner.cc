@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cstring>
+#include <QRect>
+#include <QRegExp>
+#include <QStringList>
+#include "HOCRDocument.hh"
+#include "HOCRPageScanner.hh"
+
+bool HOCRPageScanner::scan(const char* data, qint64 size, QVector<Page>& pages) {
+    const char* end = data + size;
+    const char* pos = data;
+    int depth = 0;
+    Page page = {-1, 0, {}};
+    while((pos = static_cast<const char*>(std::memchr(pos, '<', end - pos)))) {
+        const char* close = nullptr;
+        if(end - pos >= 4 && std::memcmp(pos, "<!--", 4) == 0) {
+            close = find(pos + 4, end, "-->");
+        } else if(end - pos >= 9 && std::memcmp(pos, "<![CDATA[", 9) == 0) {
+            close = find(pos + 9, end, "]]>");
+        } else if(end - pos >= 2 && (pos[1] == '?' || pos[1] == '!')) {
+            close = tagEnd(pos, end);
+        } else if(end - pos >= 2 && pos[1] == '/') {
+            close = tagEnd(pos, end);
+            if(!close || --depth < 0) {
+                return false;
+            }
+            if(depth == 1 && page.offset >= 0) {
+                page.length = close + 1 - data - page.offset;
+                pages.append(page);
+                page.offset = -1;
+            }
+        } else {
+            close = tagEnd(pos, end);
+            if(!close) {
+                return false;
+            }
+            const char* nameEnd = pos + 1;
+            while(nameEnd < close && !std::strchr(" \t\r\n/", *nameEnd)) {
+                ++nameEnd;
+            }
+            bool selfClosing = close[-1] == '/';
+            if(depth == 1 && nameEnd - pos == 4 && std::memcmp(pos + 1, "div", 3) == 0) {
+                page.offset = pos - data;
+                page.titleAttrs = HOCRItem::deserializeAttrGroup(attributes(nameEnd, close).value("title"));
+                if(selfClosing) {
+                    page.length = close + 1 - pos;
+                    pages.append(page);
+                    page.offset = -1;
+                }
+            }
+            if(!selfClosing) {
+                ++depth;
+            }
+        }
+        if(!close) {
+            return false;
+        }
+        pos = close + 1;
+    }
+    return depth == 0;
+}
+
+bool HOCRPageScanner::isCanonical(const char* data, qint64 size, int pageId, bool cleanGraphics) {
+    struct Element {
+        QString itemClass;
+        QByteArray tag;
+        QRect bbox;
+        bool hasWords = false;
+        bool hasChildren = false;
+        bool lastChildWord = false;
+        QString lastWord; // Text of the last child word
+    };
+    const char* end = data + size;
+    const char* pos = data;
+    QVector<Element> stack;
+    QMap<QString, int> idCounters;
+    QRegExp hyphen("[-\u2014]\\s*$");
+    while(pos < end) {
+        if(!stack.isEmpty()) {
+            // As HOCRItem::toHtml, tags are separated by a line break and the indentation of the next one
+            const char* next = static_cast<const char*>(std::memchr(pos, '<', end - pos));
+            int indent = next && end - next >= 2 && next[1] == '/' ? stack.size() : stack.size() + 1;
+            if(!next || next - pos != 1 + indent || *pos != '\n' || std::count(pos + 1, next, ' ') != indent) {
+                return false;
+            }
+            pos = next;
+        }
+        const char* close = end - pos >= 2 && *pos == '<' && pos[1] != '!' && pos[1] != '?' ? tagEnd(pos, end) : nullptr;
+        if(!close) {
+            return false;
+        }
+        QByteArray tagText = QByteArray::fromRawData(pos, close + 1 - pos);
+        if(pos[1] == '/') {
+            if(stack.isEmpty()) {
+                return false;
+            }
+            Element element = stack.takeLast();
+            if(tagText != "</" + element.tag + ">") {
+                return false;
+            }
+            if(element.lastChildWord && hyphen.indexIn(element.lastWord) >= 0 && !element.lastWord.endsWith('-')) {
+                // The last word of an item gets its line-end hyphen replaced
+                return false;
+            }
+            if(stack.size() == 1 && !element.hasWords) {
+                // Word-less blocks become childless graphics, small ones are dropped
+                if(element.itemClass != "ocr_graphic" || element.hasChildren
+                        || (cleanGraphics && (element.bbox.width() < 10 || element.bbox.height() < 10))) {
+                    return false;
+                }
+            }
+            pos = close + 1;
+            if(stack.isEmpty()) {
+                break;
+            }
+            stack.last().hasWords |= element.hasWords;
+            continue;
+        }
+        const char* nameEnd = pos + 1;
+        while(nameEnd < close && !std::strchr(" \t\r\n/", *nameEnd)) {
+            ++nameEnd;
+        }
+        QByteArray name(pos + 1, nameEnd - pos - 1);
+        QMap<QString, QString> attrs = attributes(nameEnd, close);
+        QMap<QString, QString> titleAttrs = HOCRItem::deserializeAttrGroup(attrs.take("title"));
+        QString itemClass = attrs.value("class");
+        QString id = attrs.value("id");
+        QString lang = attrs.value("lang");
+        QStringList bbox = titleAttrs.value("bbox").split(QRegExp("\\s+"));
+        QByteArray tag = itemClass == "ocr_page" || itemClass == "ocr_carea" || itemClass == "ocr_graphic" ? "div" : itemClass == "ocr_par" ? "p" : "span";
+        if(bbox.size() != 4 || itemClass.isEmpty() || name != tag) {
+            return false;
+        }
+        // The tag has to be written as HOCRItem::toHtml writes it, title first and the others by name
+        QString expected = QString("<%1 title=\"%2\"").arg(QString(tag), HOCRItem::serializeAttrGroup(titleAttrs));
+        for(auto it = attrs.begin(), itEnd = attrs.end(); it != itEnd; ++it) {
+            expected += QString(" %1=\"%2\"").arg(it.key(), it.value());
+        }
+        if(expected.toUtf8() + ">" != tagText) {
+            return false;
+        }
+        Element element;
+        element.itemClass = itemClass;
+        element.tag = tag;
+        element.bbox.setCoords(bbox[0].toInt(), bbox[1].toInt(), bbox[2].toInt(), bbox[3].toInt());
+        if(stack.isEmpty()) {
+            // As HOCRPage::parsePageAttributes
+            QString image = titleAttrs.value("image");
+            QString pageNr = titleAttrs.value("ppageno");
+            if(pos != data || name != "div" || id != QString("page_%1").arg(pageId)
+                    || !titleAttrs.contains("rot") || !titleAttrs.contains("res") || !titleAttrs.contains("image")
+                    || image.contains(QRegExp("^['\"]|['\"]$")) || !titleAttrs.contains("ppageno")
+                    || (pageNr.toInt() == 0 && (!pageNr.isEmpty() || titleAttrs.contains("pageno")))) {
+                return false;
+            }
+        } else {
+            if(stack.size() == 1 && name != "div") {
+                return false;
+            }
+            stack.last().hasChildren = true;
+            stack.last().lastChildWord = false;
+            // As HOCRItem::assignId and HOCRItem::parseChildren
+            QString idClass = itemClass.mid(itemClass.indexOf("_") + 1);
+            if(id != QString("%1_%2_%3").arg(idClass).arg(pageId).arg(++idCounters[idClass])) {
+                return false;
+            }
+            if(itemClass == "ocrx_word" ? lang.isEmpty() || HOCRItem::s_langCache.value(lang, "en_US") != lang : !lang.isEmpty()) {
+                return false;
+            }
+            if(itemClass == "ocr_line" && titleAttrs.value("baseline").contains(',')) {
+                return false;
+            }
+        }
+        pos = close + 1;
+        if(itemClass != "ocrx_word") {
+            stack.append(element);
+            continue;
+        }
+        // Word text, only wrapped in the markup HOCRItem::toHtml writes for bold and italic
+        const char* wordEnd = stack.isEmpty() ? nullptr : find(pos, end, "</span>");
+        if(!wordEnd) {
+            return false;
+        }
+        QByteArray content(pos, wordEnd - 6 - pos);
+        if(content.startsWith("<strong>")) {
+            if(!content.endsWith("</strong>")) {
+                return false;
+            }
+            content = content.mid(8, content.size() - 17);
+        }
+        if(content.startsWith("<em>")) {
+            if(!content.endsWith("</em>")) {
+                return false;
+            }
+            content = content.mid(4, content.size() - 9);
+        }
+        QString text = unescaped(content);
+        if(content.contains('<') || text.toHtmlEscaped().toUtf8() != content) {
+            return false;
+        }
+        stack.last().lastChildWord = true;
+        stack.last().lastWord = text;
+        stack.last().hasWords |= !text.isEmpty();
+        pos = wordEnd + 1;
+    }
+    return pos == end && stack.isEmpty() && size > 0;
+}
+
+// Returns the last character of the first occurrence of pattern
+const char* HOCRPageScanner::find(const char* begin, const char* end, const char* pattern) {
+    const char* patternEnd = pattern + std::strlen(pattern);
+    const char* pos = std::search(begin, end, pattern, patternEnd);
+    return pos != end ? pos + (patternEnd - pattern) - 1 : nullptr;
+}
+
+// Returns the closing '>' of the tag starting at begin, skipping quoted attribute values
+const char* HOCRPageScanner::tagEnd(const char* begin, const char* end) {
+    char quote = 0;
+    for(const char* pos = begin + 1; pos < end; ++pos) {
+        if(quote) {
+            if(*pos == quote) {
+                quote = 0;
+            }
+        } else if(*pos == '"' || *pos == '\'') {
+            quote = *pos;
+        } else if(*pos == '>') {
+            return pos;
+        }
+    }
+    return nullptr;
+}
+
+QMap<QString, QString> HOCRPageScanner::attributes(const char* tagBegin, const char* tagEnd) {
+    QMap<QString, QString> attrs;
+    const char* pos = tagBegin;
+    while(pos < tagEnd) {
+        while(pos < tagEnd && std::strchr(" \t\r\n/", *pos)) {
+            ++pos;
+        }
+        const char* nameBegin = pos;
+        while(pos < tagEnd && !std::strchr(" \t\r\n=/", *pos)) {
+            ++pos;
+        }
+        QString attrName = QString::fromUtf8(nameBegin, pos - nameBegin);
+        while(pos < tagEnd && std::strchr(" \t\r\n", *pos)) {
+            ++pos;
+        }
+        if(pos == tagEnd || *pos != '=') {
+            continue;
+        }
+        ++pos;
+        while(pos < tagEnd && std::strchr(" \t\r\n", *pos)) {
+            ++pos;
+        }
+        const char* valueBegin = pos;
+        const char* valueEnd;
+        if(pos < tagEnd && (*pos == '"' || *pos == '\'')) {
+            valueBegin = ++pos;
+            valueEnd = std::find(pos, tagEnd, pos[-1]);
+            pos = valueEnd < tagEnd ? valueEnd + 1 : tagEnd;
+        } else {
+            while(pos < tagEnd && !std::strchr(" \t\r\n", *pos)) {
+                ++pos;
+            }
+            valueEnd = pos;
+        }
+        attrs.insert(attrName, unescaped(QByteArray(valueBegin, valueEnd - valueBegin)));
+    }
+    return attrs;
+}
+
+QString HOCRPageScanner::unescaped(const QByteArray& value) {
+    QString text = QString::fromUtf8(value);
+    if(!text.contains('&')) {
+        return text;
+    }
+    static const QMap<QString, QString> entities = {
+        {"amp", "&"}, {"lt", "<"}, {"gt", ">"}, {"quot", "\""}, {"apos", "'"}
+    };
+    QString result;
+    result.reserve(text.size());
+    for(int i = 0, n = text.size(); i < n; ++i) {
+        int semicolon = text[i] == '&' ? text.indexOf(';', i + 1) : -1;
+        if(semicolon < 0) {
+            result += text[i];
+            continue;
+        }
+        QString entity = text.mid(i + 1, semicolon - i - 1);
+        bool ok = false;
+        if(entity.startsWith("#x")) {
+            uint codepoint = entity.mid(2).toUInt(&ok, 16);
+            result += ok ? QString::fromUcs4(&codepoint, 1) : QString();
+        } else if(entity.startsWith("#")) {
+            uint codepoint = entity.mid(1).toUInt(&ok, 10);
+            result += ok ? QString::fromUcs4(&codepoint, 1) : QString();
+        } else if(entities.contains(entity)) {
+            result += entities[entity];
+            ok = true;
+        }
+        if(ok) {
+            i = semicolon;
+        } else {
+            result += text[i];
+        }
+    }
+    return result;
+}
@@ -0,0 +1,36 @@
+#ifndef HOCRPAGESCANNER_HH
+#define HOCRPAGESCANNER_HH
+
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+/*
+ * Finds the page divs of a hOCR document, i.e. the div elements directly below its root
+ * element, without building a DOM. Only the tags are looked at, and only the title of the
+ * page divs themselves is decoded.
+ */
+class HOCRPageScanner {
+public:
+    struct Page {
+        qint64 offset;
+        qint64 length;
+        QMap<QString, QString> titleAttrs;
+    };
+
+    // Fails if the tags are not balanced
+    static bool scan(const char* data, qint64 size, QVector<Page>& pages);
+    // Whether building a HOCRPage from the page div in data and writing it back would give the same
+    // bytes: markup laid out as HOCRItem::toHtml writes it, ids already numbered for pageId, languages,
+    // graphics, page title, baselines and line-end hyphens already normalized. Anything unexpected
+    // counts as not canonical.
+    static bool isCanonical(const char* data, qint64 size, int pageId, bool cleanGraphics);
+
+private:
+    static const char* find(const char* begin, const char* end, const char* pattern);
+    static const char* tagEnd(const char* begin, const char* end);
+    static QMap<QString, QString> attributes(const char* tagBegin, const char* tagEnd);
+    static QString unescaped(const QByteArray& value);
+};
+
+#endif // HOCRPAGESCANNER_HH
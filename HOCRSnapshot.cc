@@ -0,0 +1,250 @@
+#include <cstring>
+#include "HOCRDocument.hh"
+#include "HOCRSnapshot.hh"
+
+static const char s_magic[8] = {'H', 'O', 'C', 'R', 'S', 'N', 'A', 'P'};
+
+static quint32 internString(const QString& string, QHash<QString, quint32>& strings, QVector<QString>& stringList) {
+    auto it = strings.find(string);
+    if(it == strings.end()) {
+        it = strings.insert(string, stringList.size());
+        stringList.append(string);
+    }
+    return it.value();
+}
+
+static qint64 alignedSize(qint64 size) {
+    return (size + 7) & ~qint64(7);
+}
+
+HOCRSnapshot::~HOCRSnapshot() {
+    close();
+}
+
+void HOCRSnapshot::collectItem(const HOCRItem* item, qint32 parent, QVector<ItemRecord>& items, QVector<AttrRecord>& attrs, QHash<QString, quint32>& strings, QVector<QString>& stringList) {
+    ItemRecord record;
+    record.bbox[0] = qToLittleEndian<qint32>(item->bbox().left());
+    record.bbox[1] = qToLittleEndian<qint32>(item->bbox().top());
+    record.bbox[2] = qToLittleEndian<qint32>(item->bbox().right());
+    record.bbox[3] = qToLittleEndian<qint32>(item->bbox().bottom());
+    record.parent = qToLittleEndian<qint32>(parent);
+    record.firstAttr = qToLittleEndian<quint32>(attrs.size());
+    quint32 attrCount = 0;
+    const QMap<QString, QString>& itemAttrs = item->m_attrs;
+    for(auto it = itemAttrs.begin(), itEnd = itemAttrs.end(); it != itEnd; ++it) {
+        AttrRecord attr;
+        attr.key = qToLittleEndian<quint32>(internString(it.key(), strings, stringList));
+        attr.value = qToLittleEndian<quint32>(internString(it.value(), strings, stringList));
+        attrs.append(attr);
+        ++attrCount;
+    }
+    const QMap<QString, QString>& titleAttrs = item->m_titleAttrs;
+    for(auto it = titleAttrs.begin(), itEnd = titleAttrs.end(); it != itEnd; ++it) {
+        // The bbox is stored numerically in the item record
+        if(it.key() == "bbox") {
+            continue;
+        }
+        AttrRecord attr;
+        attr.key = qToLittleEndian<quint32>(internString(it.key(), strings, stringList) | TitleAttrBit);
+        attr.value = qToLittleEndian<quint32>(internString(it.value(), strings, stringList));
+        attrs.append(attr);
+        ++attrCount;
+    }
+    record.attrCount = qToLittleEndian<quint32>(attrCount);
+    record.text = qToLittleEndian<quint32>(internString(item->m_text, strings, stringList));
+    quint32 flags = (item->isEnabled() ? FlagEnabled : 0) | (item->m_bold ? FlagBold : 0) | (item->m_italic ? FlagItalic : 0);
+    record.flags = qToLittleEndian<quint32>(flags);
+
+    qint32 index = items.size();
+    items.append(record);
+    for(const HOCRItem* child : item->children()) {
+        collectItem(child, index, items, attrs, strings, stringList);
+    }
+}
+
+// A short write is as much a failure as an error
+static bool writeAll(QIODevice* device, const char* data, qint64 size) {
+    return device->write(data, size) == size;
+}
+
+bool HOCRSnapshot::write(const HOCRDocument& document, QIODevice* device) {
+    int pageCount = document.pageCount();
+    QHash<QString, quint32> strings;
+    QVector<QString> stringList;
+    internString(QString(), strings, stringList);
+
+    QVector<QVector<ItemRecord>> pageItems(pageCount);
+    QVector<QVector<AttrRecord>> pageAttrs(pageCount);
+    QVector<PageEntry> pageTable(pageCount);
+    qint64 offset = alignedSize(sizeof(Header) + pageCount * sizeof(PageEntry));
+    for(int i = 0; i < pageCount; ++i) {
+        const HOCRPage* page = document.page(i);
+        collectItem(page, -1, pageItems[i], pageAttrs[i], strings, stringList);
+        PageEntry& entry = pageTable[i];
+        entry.offset = qToLittleEndian<quint64>(offset);
+        entry.itemCount = qToLittleEndian<quint32>(pageItems[i].size());
+        entry.attrCount = qToLittleEndian<quint32>(pageAttrs[i].size());
+        std::memcpy(entry.bbox, pageItems[i][0].bbox, sizeof(entry.bbox));
+        entry.pageNr = qToLittleEndian<qint32>(page->pageNr());
+        entry.resolution = qToLittleEndian<qint32>(page->resolution());
+        offset = alignedSize(offset + pageItems[i].size() * sizeof(ItemRecord) + pageAttrs[i].size() * sizeof(AttrRecord));
+    }
+
+    QVector<QByteArray> utf8Strings;
+    utf8Strings.reserve(stringList.size());
+    QVector<quint32> stringOffsets;
+    stringOffsets.reserve(stringList.size() + 1);
+    quint32 stringOffset = 0;
+    for(const QString& string : stringList) {
+        utf8Strings.append(string.toUtf8());
+        stringOffsets.append(qToLittleEndian<quint32>(stringOffset));
+        stringOffset += utf8Strings.last().size();
+    }
+    stringOffsets.append(qToLittleEndian<quint32>(stringOffset));
+
+    Header header;
+    std::memcpy(header.magic, s_magic, sizeof(header.magic));
+    header.version = qToLittleEndian<quint32>(Version);
+    header.pageCount = qToLittleEndian<quint32>(pageCount);
+    header.stringTableOffset = qToLittleEndian<quint64>(offset);
+    header.stringCount = qToLittleEndian<quint32>(stringList.size());
+    header.reserved = 0;
+
+    static const char padding[8] = {};
+    // Sequential devices have no position, it is counted here
+    qint64 pos = sizeof(Header) + pageCount * sizeof(PageEntry);
+    bool ok = writeAll(device, reinterpret_cast<const char*>(&header), sizeof(Header));
+    ok = ok && writeAll(device, reinterpret_cast<const char*>(pageTable.constData()), pageCount * sizeof(PageEntry));
+    for(int i = 0; ok && i < pageCount; ++i) {
+        ok = writeAll(device, padding, qFromLittleEndian(pageTable[i].offset) - pos);
+        ok = ok && writeAll(device, reinterpret_cast<const char*>(pageItems[i].constData()), pageItems[i].size() * sizeof(ItemRecord));
+        ok = ok && writeAll(device, reinterpret_cast<const char*>(pageAttrs[i].constData()), pageAttrs[i].size() * sizeof(AttrRecord));
+        pos = qFromLittleEndian(pageTable[i].offset) + pageItems[i].size() * sizeof(ItemRecord) + pageAttrs[i].size() * sizeof(AttrRecord);
+    }
+    ok = ok && writeAll(device, padding, offset - pos);
+    ok = ok && writeAll(device, reinterpret_cast<const char*>(stringOffsets.constData()), stringOffsets.size() * sizeof(quint32));
+    for(int i = 0, n = utf8Strings.size(); ok && i < n; ++i) {
+        ok = writeAll(device, utf8Strings[i].constData(), utf8Strings[i].size());
+    }
+    return ok;
+}
+
+bool HOCRSnapshot::open(const QString& filename) {
+    close();
+    m_file.setFileName(filename);
+    if(!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    m_size = m_file.size();
+    if(m_size < qint64(sizeof(Header)) || !(m_data = m_file.map(0, m_size))) {
+        close();
+        return false;
+    }
+    m_header = reinterpret_cast<const Header*>(m_data);
+    quint64 pageCount = qFromLittleEndian(m_header->pageCount);
+    quint64 stringTableOffset = qFromLittleEndian(m_header->stringTableOffset);
+    quint64 stringCount = qFromLittleEndian(m_header->stringCount);
+    if(std::memcmp(m_header->magic, s_magic, sizeof(s_magic)) != 0 || qFromLittleEndian(m_header->version) != Version ||
+            sizeof(Header) + pageCount * sizeof(PageEntry) > stringTableOffset ||
+            stringTableOffset + (stringCount + 1) * sizeof(quint32) > quint64(m_size)) {
+        close();
+        return false;
+    }
+    m_pageTable = reinterpret_cast<const PageEntry*>(m_data + sizeof(Header));
+    for(quint64 i = 0; i < pageCount; ++i) {
+        quint64 end = qFromLittleEndian(m_pageTable[i].offset) + qFromLittleEndian(m_pageTable[i].itemCount) * sizeof(ItemRecord) + qFromLittleEndian(m_pageTable[i].attrCount) * sizeof(AttrRecord);
+        if(end > stringTableOffset) {
+            close();
+            return false;
+        }
+    }
+    m_stringOffsets = reinterpret_cast<const quint32*>(m_data + stringTableOffset);
+    m_stringData = reinterpret_cast<const char*>(m_stringOffsets + stringCount + 1);
+    // string() reads between neighbouring offsets, so they have to ascend within the string data
+    quint64 stringDataSize = quint64(m_size) - quint64(m_stringData - reinterpret_cast<const char*>(m_data));
+    quint32 previous = 0;
+    for(quint64 i = 0; i <= stringCount; ++i) {
+        quint32 stringOffset = qFromLittleEndian(m_stringOffsets[i]);
+        if(stringOffset < previous || stringOffset > stringDataSize) {
+            close();
+            return false;
+        }
+        previous = stringOffset;
+    }
+    return true;
+}
+
+void HOCRSnapshot::close() {
+    if(m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+    m_file.close();
+    m_data = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+    m_pageTable = nullptr;
+    m_stringOffsets = nullptr;
+    m_stringData = nullptr;
+}
+
+QString HOCRSnapshot::string(quint32 id) const {
+    if(!m_header || id >= qFromLittleEndian(m_header->stringCount)) {
+        return QString();
+    }
+    quint32 begin = qFromLittleEndian(m_stringOffsets[id]);
+    quint32 end = qFromLittleEndian(m_stringOffsets[id + 1]);
+    return end > begin ? QString::fromUtf8(m_stringData + begin, end - begin) : QString();
+}
+
+HOCRPage* HOCRSnapshot::readPage(int page) const {
+    if(page < 0 || page >= pageCount()) {
+        return nullptr;
+    }
+    int itemCount = qFromLittleEndian(m_pageTable[page].itemCount);
+    quint32 attrCount = qFromLittleEndian(m_pageTable[page].attrCount);
+    const ItemRecord* itemRecords = items(page);
+    const AttrRecord* attrRecords = attrs(page);
+
+    HOCRPage* pageItem = nullptr;
+    QVector<HOCRItem*> itemList(itemCount);
+    for(int i = 0; i < itemCount; ++i) {
+        const ItemRecord& record = itemRecords[i];
+        quint32 firstAttr = qFromLittleEndian(record.firstAttr);
+        quint32 nAttrs = qFromLittleEndian(record.attrCount);
+        qint32 parent = qFromLittleEndian(record.parent);
+        if(firstAttr + nAttrs > attrCount || (i == 0) != (parent < 0) || parent >= i) {
+            delete pageItem;
+            return nullptr;
+        }
+        QMap<QString, QString> itemAttrs;
+        QMap<QString, QString> titleAttrs;
+        for(quint32 iAttr = firstAttr; iAttr < firstAttr + nAttrs; ++iAttr) {
+            quint32 key = qFromLittleEndian(attrRecords[iAttr].key);
+            QString value = string(qFromLittleEndian(attrRecords[iAttr].value));
+            if(key & TitleAttrBit) {
+                titleAttrs.insert(string(key & ~TitleAttrBit), value);
+            } else {
+                itemAttrs.insert(string(key), value);
+            }
+        }
+        QRect bbox;
+        bbox.setCoords(qFromLittleEndian(record.bbox[0]), qFromLittleEndian(record.bbox[1]), qFromLittleEndian(record.bbox[2]), qFromLittleEndian(record.bbox[3]));
+
+        HOCRItem* item = nullptr;
+        if(i == 0) {
+            pageItem = new HOCRPage(itemAttrs, titleAttrs, bbox);
+            item = pageItem;
+        } else {
+            HOCRItem* parentItem = itemList[parent];
+            item = new HOCRItem(itemAttrs, titleAttrs, bbox, pageItem, parentItem);
+            parentItem->addChild(item);
+        }
+        quint32 flags = qFromLittleEndian(record.flags);
+        item->m_text = string(qFromLittleEndian(record.text));
+        item->m_enabled = flags & FlagEnabled;
+        item->m_bold = flags & FlagBold;
+        item->m_italic = flags & FlagItalic;
+        itemList[i] = item;
+    }
+    return pageItem;
+}
@@ -0,0 +1,100 @@
+#ifndef HOCRSNAPSHOT_HH
+#define HOCRSNAPSHOT_HH
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <QtEndian>
+
+class HOCRDocument;
+class HOCRItem;
+class HOCRPage;
+
+/*
+ * Versioned binary snapshot of a HOCRDocument.
+ *
+ * Layout (all integers little endian):
+ *   Header
+ *   PageEntry[pageCount]              page offset table
+ *   per page: ItemRecord[itemCount]   items in document order, page first
+ *             AttrRecord[attrCount]   item attributes, referenced by ItemRecord::firstAttr
+ *   string table: quint32 offsets[stringCount + 1], followed by the UTF-8 string data
+ *
+ * All strings (attribute names and values, word texts) are interned in the string table.
+ * Records have a fixed width, so a page can be read straight from the mapped file.
+ */
+class HOCRSnapshot {
+public:
+    static const quint32 Version = 1;
+
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 pageCount;
+        quint64 stringTableOffset;
+        quint32 stringCount;
+        quint32 reserved;
+    };
+    struct PageEntry {
+        quint64 offset;
+        quint32 itemCount;
+        quint32 attrCount;
+        qint32 bbox[4];
+        qint32 pageNr;
+        qint32 resolution;
+    };
+    enum ItemFlags { FlagEnabled = 1, FlagBold = 2, FlagItalic = 4 };
+    struct ItemRecord {
+        qint32 bbox[4];
+        qint32 parent;
+        quint32 firstAttr;
+        quint32 attrCount;
+        quint32 text;
+        quint32 flags;
+    };
+    // Title attributes are stored with TitleAttrBit set in the key
+    static const quint32 TitleAttrBit = 0x80000000u;
+    struct AttrRecord {
+        quint32 key;
+        quint32 value;
+    };
+
+    HOCRSnapshot() {}
+    ~HOCRSnapshot();
+
+    static bool write(const HOCRDocument& document, QIODevice* device);
+
+    bool open(const QString& filename);
+    void close();
+
+    int pageCount() const {
+        return m_header ? int(qFromLittleEndian(m_header->pageCount)) : 0;
+    }
+    const PageEntry* pageEntry(int page) const {
+        return &m_pageTable[page];
+    }
+    const ItemRecord* items(int page) const {
+        return reinterpret_cast<const ItemRecord*>(m_data + qFromLittleEndian(m_pageTable[page].offset));
+    }
+    const AttrRecord* attrs(int page) const {
+        return reinterpret_cast<const AttrRecord*>(items(page) + qFromLittleEndian(m_pageTable[page].itemCount));
+    }
+    QString string(quint32 id) const;
+
+    // Builds the item tree of a page, the caller takes ownership
+    HOCRPage* readPage(int page) const;
+
+private:
+    QFile m_file;
+    const uchar* m_data = nullptr;
+    qint64 m_size = 0;
+    const Header* m_header = nullptr;
+    const PageEntry* m_pageTable = nullptr;
+    const quint32* m_stringOffsets = nullptr;
+    const char* m_stringData = nullptr;
+
+    static void collectItem(const HOCRItem* item, qint32 parent, QVector<ItemRecord>& items, QVector<AttrRecord>& attrs, QHash<QString, quint32>& strings, QVector<QString>& stringList);
+};
+
+#endif // HOCRSNAPSHOT_HH
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cmath>
+#include "HOCRDocument.hh"
+#include "HOCRSpatialIndex.hh"
+
+HOCRSpatialIndex::HOCRSpatialIndex(const HOCRPage* page)
+    : m_page(page), m_bounds(page->bbox()) {
+    for(const HOCRItem* child : page->children()) {
+        addItems(child);
+    }
+    if(m_entries.isEmpty() || m_bounds.width() <= 0 || m_bounds.height() <= 0) {
+        return;
+    }
+    // Aim for roughly two entries per cell, with cells following the page aspect ratio
+    int nCells = std::max(1, m_entries.size() / 2);
+    m_cols = std::max(1, int(std::ceil(std::sqrt(double(nCells) * m_bounds.width() / m_bounds.height()))));
+    m_rows = std::max(1, (nCells + m_cols - 1) / m_cols);
+    m_cellWidth = std::max(1, (m_bounds.width() + m_cols - 1) / m_cols);
+    m_cellHeight = std::max(1, (m_bounds.height() + m_rows - 1) / m_rows);
+    m_cols = (m_bounds.width() + m_cellWidth - 1) / m_cellWidth;
+    m_rows = (m_bounds.height() + m_cellHeight - 1) / m_cellHeight;
+    m_cells.resize(m_cols * m_rows);
+
+    for(int i = 0, n = m_entries.size(); i < n; ++i) {
+        const QRect& bbox = m_entries[i]->bbox();
+        if(bbox.isEmpty()) {
+            continue;
+        }
+        QRect range = cellRange(bbox);
+        for(int row = range.top(); row <= range.bottom(); ++row) {
+            for(int col = range.left(); col <= range.right(); ++col) {
+                m_cells[row * m_cols + col].append(i);
+            }
+        }
+    }
+}
+
+void HOCRSpatialIndex::addItems(const HOCRItem* item) {
+    m_entries.append(item);
+    for(const HOCRItem* child : item->children()) {
+        addItems(child);
+    }
+}
+
+QRect HOCRSpatialIndex::cellRange(const QRect& rect) const {
+    // Items and positions outside the page are clamped to the border cells
+    int left = qBound(0, (rect.left() - m_bounds.left()) / m_cellWidth, m_cols - 1);
+    int right = qBound(0, (rect.right() - m_bounds.left()) / m_cellWidth, m_cols - 1);
+    int top = qBound(0, (rect.top() - m_bounds.top()) / m_cellHeight, m_rows - 1);
+    int bottom = qBound(0, (rect.bottom() - m_bounds.top()) / m_cellHeight, m_rows - 1);
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+const HOCRItem* HOCRSpatialIndex::itemAt(const QPoint& pos) const {
+    if(m_cells.isEmpty()) {
+        return nullptr;
+    }
+    QRect range = cellRange(QRect(pos, QSize(1, 1)));
+    // Cell entries are in document order, so the children of the current item come after it, each
+    // before its own descendants: the first containing child of the current item is the next match
+    const HOCRItem* current = m_page;
+    for(int i : m_cells[range.top() * m_cols + range.left()]) {
+        const HOCRItem* item = m_entries[i];
+        if(item->parent() == current && item->bbox().contains(pos)) {
+            current = item;
+        }
+    }
+    return current != m_page ? current : nullptr;
+}
+
+QVector<const HOCRItem*> HOCRSpatialIndex::itemsInRect(const QRect& rect, const QString& itemClass, bool contained) const {
+    QVector<const HOCRItem*> result;
+    if(m_cells.isEmpty() || !rect.isValid()) {
+        return result;
+    }
+    QRect range = cellRange(rect);
+    QVector<int> candidates;
+    for(int row = range.top(); row <= range.bottom(); ++row) {
+        for(int col = range.left(); col <= range.right(); ++col) {
+            candidates += m_cells[row * m_cols + col];
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    for(int i : candidates) {
+        const HOCRItem* item = m_entries[i];
+        if(!itemClass.isEmpty() && item->itemClass() != itemClass) {
+            continue;
+        }
+        if(contained ? rect.contains(item->bbox()) : rect.intersects(item->bbox())) {
+            result.append(item);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,40 @@
+#ifndef HOCRSPATIALINDEX_HH
+#define HOCRSPATIALINDEX_HH
+
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+class HOCRItem;
+class HOCRPage;
+
+/*
+ * Uniform grid over the items of a page, used for point and rectangle queries.
+ * Every item except the page itself is registered in all cells its bbox overlaps.
+ * The index holds raw item pointers and must be rebuilt whenever the page tree changes.
+ */
+class HOCRSpatialIndex {
+public:
+    explicit HOCRSpatialIndex(const HOCRPage* page);
+
+    // Descends from the page into the first child containing pos at each level, like a walk of the tree
+    const HOCRItem* itemAt(const QPoint& pos) const;
+    // Returns the items intersecting (or, if contained is set, lying inside) rect, in document order
+    QVector<const HOCRItem*> itemsInRect(const QRect& rect, const QString& itemClass = QString(), bool contained = false) const;
+
+private:
+    const HOCRPage* m_page;
+    QRect m_bounds;
+    int m_cellWidth = 1;
+    int m_cellHeight = 1;
+    int m_cols = 0;
+    int m_rows = 0;
+    // Items in document order
+    QVector<const HOCRItem*> m_entries;
+    QVector<QVector<int>> m_cells;
+
+    void addItems(const HOCRItem* item);
+    QRect cellRange(const QRect& rect) const;
+};
+
+#endif // HOCRSPATIALINDEX_HH
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cstring>
+#include <QtEndian>
+#include "HOCRDocument.hh"
+#include "HOCRTextIndex.hh"
+
+static const char s_magic[8] = {'H', 'O', 'C', 'R', 'I', 'D', 'X', '1'};
+
+static int compareTerm(const char* text, quint32 length, const QByteArray& term) {
+    int cmp = std::memcmp(text, term.constData(), std::min<quint32>(length, term.size()));
+    if(cmp != 0) {
+        return cmp;
+    }
+    return length < quint32(term.size()) ? -1 : (length > quint32(term.size()) ? 1 : 0);
+}
+
+static void collectWords(const HOCRItem* item, int pageNr, QHash<QString, QVector<HOCRTextIndex::Posting>>& terms) {
+    if(!item->isEnabled()) {
+        return;
+    }
+    if(item->itemClass() == "ocrx_word") {
+        QString term = HOCRTextIndex::normalize(item->text());
+        if(!term.isEmpty()) {
+            const QRect& bbox = item->bbox();
+            HOCRTextIndex::Posting posting;
+            posting.page = qToLittleEndian<qint32>(pageNr);
+            posting.bbox[0] = qToLittleEndian<qint32>(bbox.left());
+            posting.bbox[1] = qToLittleEndian<qint32>(bbox.top());
+            posting.bbox[2] = qToLittleEndian<qint32>(bbox.right());
+            posting.bbox[3] = qToLittleEndian<qint32>(bbox.bottom());
+            posting.confidence = qToLittleEndian<qint32>(item->getTitleAttributes().value("x_wconf").toInt());
+            terms[term].append(posting);
+        }
+        return;
+    }
+    for(const HOCRItem* child : item->children()) {
+        collectWords(child, pageNr, terms);
+    }
+}
+
+HOCRTextIndex::~HOCRTextIndex() {
+    close();
+}
+
+QString HOCRTextIndex::normalize(const QString& word) {
+    return HOCRItem::trimmedWord(word).toCaseFolded();
+}
+
+void HOCRTextIndex::addPage(const HOCRPage* page) {
+    collectWords(page, page->pageNr(), m_terms);
+}
+
+bool HOCRTextIndex::write(QIODevice* device) const {
+    QVector<QPair<QByteArray, const QVector<Posting>*>> terms;
+    terms.reserve(m_terms.size());
+    for(auto it = m_terms.begin(), itEnd = m_terms.end(); it != itEnd; ++it) {
+        terms.append(qMakePair(it.key().toUtf8(), &it.value()));
+    }
+    std::sort(terms.begin(), terms.end(), [](const QPair<QByteArray, const QVector<Posting>*>& a, const QPair<QByteArray, const QVector<Posting>*>& b) {
+        return compareTerm(a.first.constData(), a.first.size(), b.first) < 0;
+    });
+
+    QVector<TermEntry> termTable;
+    termTable.reserve(terms.size());
+    quint32 textOffset = 0;
+    quint32 postingCount = 0;
+    for(const auto& term : terms) {
+        TermEntry entry;
+        entry.textOffset = qToLittleEndian<quint32>(textOffset);
+        entry.textLength = qToLittleEndian<quint32>(term.first.size());
+        entry.firstPosting = qToLittleEndian<quint32>(postingCount);
+        entry.postingCount = qToLittleEndian<quint32>(term.second->size());
+        termTable.append(entry);
+        textOffset += term.first.size();
+        postingCount += term.second->size();
+    }
+
+    Header header;
+    std::memcpy(header.magic, s_magic, sizeof(header.magic));
+    header.version = qToLittleEndian<quint32>(Version);
+    header.termCount = qToLittleEndian<quint32>(terms.size());
+    header.postingCount = qToLittleEndian<quint32>(postingCount);
+    header.reserved = 0;
+
+    bool ok = device->write(reinterpret_cast<const char*>(&header), sizeof(Header)) == sizeof(Header);
+    ok = ok && device->write(reinterpret_cast<const char*>(termTable.constData()), termTable.size() * sizeof(TermEntry)) == qint64(termTable.size() * sizeof(TermEntry));
+    for(int i = 0, n = terms.size(); ok && i < n; ++i) {
+        qint64 size = terms[i].second->size() * sizeof(Posting);
+        ok = device->write(reinterpret_cast<const char*>(terms[i].second->constData()), size) == size;
+    }
+    for(int i = 0, n = terms.size(); ok && i < n; ++i) {
+        ok = device->write(terms[i].first) == terms[i].first.size();
+    }
+    return ok;
+}
+
+bool HOCRTextIndex::open(const QString& filename) {
+    close();
+    m_file.setFileName(filename);
+    if(!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    quint64 size = m_file.size();
+    if(size < sizeof(Header) || !(m_data = m_file.map(0, size))) {
+        close();
+        return false;
+    }
+    m_header = reinterpret_cast<const Header*>(m_data);
+    quint64 termCount = qFromLittleEndian(m_header->termCount);
+    quint64 postingCount = qFromLittleEndian(m_header->postingCount);
+    quint64 textOffset = sizeof(Header) + termCount * sizeof(TermEntry) + postingCount * sizeof(Posting);
+    if(std::memcmp(m_header->magic, s_magic, sizeof(s_magic)) != 0 || qFromLittleEndian(m_header->version) != Version || textOffset > size) {
+        close();
+        return false;
+    }
+    m_termTable = reinterpret_cast<const TermEntry*>(m_data + sizeof(Header));
+    m_postings = reinterpret_cast<const Posting*>(m_termTable + termCount);
+    m_textData = reinterpret_cast<const char*>(m_data + textOffset);
+    for(quint64 i = 0; i < termCount; ++i) {
+        const TermEntry& entry = m_termTable[i];
+        if(textOffset + qFromLittleEndian(entry.textOffset) + qFromLittleEndian(entry.textLength) > size ||
+                quint64(qFromLittleEndian(entry.firstPosting)) + qFromLittleEndian(entry.postingCount) > postingCount) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void HOCRTextIndex::close() {
+    if(m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+    m_file.close();
+    m_data = nullptr;
+    m_header = nullptr;
+    m_termTable = nullptr;
+    m_postings = nullptr;
+    m_textData = nullptr;
+}
+
+int HOCRTextIndex::termCount() const {
+    return m_header ? int(qFromLittleEndian(m_header->termCount)) : m_terms.size();
+}
+
+QVector<HOCRTextIndex::Hit> HOCRTextIndex::find(const QString& word) const {
+    QVector<Hit> hits;
+    if(!m_header) {
+        return hits;
+    }
+    QByteArray term = normalize(word).toUtf8();
+    int lo = 0, hi = int(qFromLittleEndian(m_header->termCount)) - 1;
+    while(lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        const TermEntry& entry = m_termTable[mid];
+        int cmp = compareTerm(m_textData + qFromLittleEndian(entry.textOffset), qFromLittleEndian(entry.textLength), term);
+        if(cmp < 0) {
+            lo = mid + 1;
+        } else if(cmp > 0) {
+            hi = mid - 1;
+        } else {
+            const Posting* posting = m_postings + qFromLittleEndian(entry.firstPosting);
+            for(quint32 i = 0, n = qFromLittleEndian(entry.postingCount); i < n; ++i, ++posting) {
+                Hit hit;
+                hit.page = qFromLittleEndian(posting->page);
+                hit.bbox.setCoords(qFromLittleEndian(posting->bbox[0]), qFromLittleEndian(posting->bbox[1]), qFromLittleEndian(posting->bbox[2]), qFromLittleEndian(posting->bbox[3]));
+                hit.confidence = qFromLittleEndian(posting->confidence);
+                hits.append(hit);
+            }
+            break;
+        }
+    }
+    return hits;
+}
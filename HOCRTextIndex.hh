@@ -0,0 +1,80 @@
+#ifndef HOCRTEXTINDEX_HH
+#define HOCRTEXTINDEX_HH
+
+#include <QFile>
+#include <QHash>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+class HOCRPage;
+
+/*
+ * Inverted index of normalized word -> (page, bbox, confidence).
+ *
+ * Sidecar file layout (all integers little endian):
+ *   Header
+ *   TermEntry[termCount]   sorted by the UTF-8 bytes of the term
+ *   Posting[postingCount]  grouped by term
+ *   UTF-8 term data
+ */
+class HOCRTextIndex {
+public:
+    static const quint32 Version = 1;
+
+    struct Hit {
+        int page;
+        QRect bbox;
+        int confidence;
+    };
+
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 termCount;
+        quint32 postingCount;
+        quint32 reserved;
+    };
+    struct TermEntry {
+        quint32 textOffset;
+        quint32 textLength;
+        quint32 firstPosting;
+        quint32 postingCount;
+    };
+    struct Posting {
+        qint32 page;
+        qint32 bbox[4];
+        qint32 confidence;
+    };
+
+    HOCRTextIndex() {}
+    ~HOCRTextIndex();
+
+    static QString normalize(const QString& word);
+
+    // Building
+    void addPage(const HOCRPage* page);
+    // Writes the index to device, which stays owned by the caller
+    bool write(QIODevice* device) const;
+    void clear() {
+        m_terms.clear();
+    }
+
+    // Querying
+    bool open(const QString& filename);
+    void close();
+    int termCount() const;
+    QVector<Hit> find(const QString& word) const;
+
+private:
+    QHash<QString, QVector<Posting>> m_terms;
+
+    QFile m_file;
+    const uchar* m_data = nullptr;
+    const Header* m_header = nullptr;
+    const TermEntry* m_termTable = nullptr;
+    const Posting* m_postings = nullptr;
+    const char* m_textData = nullptr;
+};
+
+#endif // HOCRTEXTINDEX_HH
@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <cstring>
+#include <QtEndian>
+#include "HOCRDocument.hh"
+#include "HOCRWordTable.hh"
+
+namespace {
+
+// Minimal FlatBuffers builder, enough for the Schema, Message and Footer tables of the Arrow
+// format. As in the reference implementation the buffer is built back to front, so offsets
+// of objects count from its end until the buffer is finished.
+class FlatBuilder {
+public:
+    quint32 size() const {
+        return m_buf.size();
+    }
+    template<typename T>
+    void addScalar(int field, T value) {
+        align(sizeof(T));
+        push(value);
+        m_fields.push_back(std::make_pair(field, size()));
+    }
+    void addOffset(int field, quint32 object) {
+        pushOffset(object);
+        m_fields.push_back(std::make_pair(field, size()));
+    }
+    quint32 createString(const char* text) {
+        size_t length = std::strlen(text);
+        align(4, length + 1);
+        m_buf.insert(m_buf.begin(), 0);
+        m_buf.insert(m_buf.begin(), text, text + length);
+        push<quint32>(length);
+        return size();
+    }
+    quint32 createOffsetVector(const std::vector<quint32>& objects) {
+        align(4, objects.size() * 4);
+        for(auto it = objects.rbegin(); it != objects.rend(); ++it) {
+            pushOffset(*it);
+        }
+        push<quint32>(objects.size());
+        return size();
+    }
+    // data holds count little endian structs
+    quint32 createStructVector(const std::vector<quint8>& data, quint32 count, size_t alignment) {
+        align(4, data.size());
+        align(alignment, data.size());
+        m_buf.insert(m_buf.begin(), data.begin(), data.end());
+        push<quint32>(count);
+        return size();
+    }
+    void startTable() {
+        m_fields.clear();
+        m_tableStart = size();
+    }
+    quint32 endTable() {
+        align(4);
+        push<qint32>(0);
+        quint32 object = size();
+        int fieldCount = 0;
+        for(const auto& field : m_fields) {
+            fieldCount = std::max(fieldCount, field.first + 1);
+        }
+        std::vector<quint16> vtable(fieldCount, 0);
+        for(const auto& field : m_fields) {
+            vtable[field.first] = object - field.second;
+        }
+        for(auto it = vtable.rbegin(); it != vtable.rend(); ++it) {
+            push<quint16>(*it);
+        }
+        push<quint16>(object - m_tableStart);
+        push<quint16>(4 + 2 * fieldCount);
+        // The table starts with the signed distance back to its vtable
+        qint32 vtableDistance = size() - object;
+        for(size_t i = 0; i < 4; ++i) {
+            m_buf[m_buf.size() - object + i] = quint8(quint32(vtableDistance) >> (8 * i));
+        }
+        m_fields.clear();
+        return object;
+    }
+    std::vector<quint8> finish(quint32 root) {
+        align(m_minAlign, 4);
+        pushOffset(root);
+        return m_buf;
+    }
+
+private:
+    std::vector<quint8> m_buf;
+    std::vector<std::pair<int, quint32>> m_fields;
+    quint32 m_tableStart = 0;
+    size_t m_minAlign = 4;
+
+    void align(size_t alignment, size_t extra = 0) {
+        m_minAlign = std::max(m_minAlign, alignment);
+        m_buf.insert(m_buf.begin(), (alignment - (m_buf.size() + extra) % alignment) % alignment, 0);
+    }
+    template<typename T>
+    void push(T value) {
+        quint8 bytes[sizeof(T)];
+        for(size_t i = 0; i < sizeof(T); ++i) {
+            bytes[i] = quint8(quint64(value) >> (8 * i));
+        }
+        m_buf.insert(m_buf.begin(), bytes, bytes + sizeof(T));
+    }
+    void pushOffset(quint32 object) {
+        align(4);
+        push<quint32>(size() + 4 - object);
+    }
+};
+
+template<typename T>
+void appendLittleEndian(std::vector<quint8>& data, T value) {
+    for(size_t i = 0; i < sizeof(T); ++i) {
+        data.push_back(quint8(quint64(value) >> (8 * i)));
+    }
+}
+
+// Constants of Arrow's Schema.fbs, Message.fbs and File.fbs
+enum ArrowType : quint8 { TypeInt = 2, TypeFloatingPoint = 3, TypeUtf8 = 5 };
+enum ArrowMessageHeader : quint8 { HeaderSchema = 1, HeaderRecordBatch = 3 };
+const qint16 MetadataV5 = 4;
+const qint16 PrecisionSingle = 1;
+
+struct Column {
+    const char* name;
+    ArrowType type;
+};
+const Column s_columns[] = {
+    {"page", TypeInt}, {"line", TypeInt}, {"word", TypeUtf8},
+    {"left", TypeInt}, {"top", TypeInt}, {"right", TypeInt}, {"bottom", TypeInt},
+    {"confidence", TypeInt}, {"font_size", TypeFloatingPoint}
+};
+const int s_columnCount = sizeof(s_columns) / sizeof(s_columns[0]);
+
+quint32 buildSchema(FlatBuilder& fbb, bool bigEndian) {
+    std::vector<quint32> fields;
+    for(const Column& column : s_columns) {
+        fbb.startTable();
+        if(column.type == TypeInt) {
+            fbb.addScalar<qint32>(0, 32);  // bitWidth
+            fbb.addScalar<quint8>(1, 1);   // is_signed
+        } else if(column.type == TypeFloatingPoint) {
+            fbb.addScalar<qint16>(0, PrecisionSingle);
+        }
+        quint32 type = fbb.endTable();
+        quint32 name = fbb.createString(column.name);
+        quint32 children = fbb.createOffsetVector({});
+        fbb.startTable();
+        fbb.addOffset(0, name);
+        fbb.addScalar<quint8>(1, 0);  // nullable
+        fbb.addScalar<quint8>(2, column.type);
+        fbb.addOffset(3, type);
+        fbb.addOffset(5, children);
+        fields.push_back(fbb.endTable());
+    }
+    quint32 fieldVector = fbb.createOffsetVector(fields);
+    fbb.startTable();
+    fbb.addScalar<qint16>(0, bigEndian ? 1 : 0);
+    fbb.addOffset(1, fieldVector);
+    return fbb.endTable();
+}
+
+std::vector<quint8> buildMessage(FlatBuilder& fbb, ArrowMessageHeader headerType, quint32 header, qint64 bodyLength) {
+    fbb.startTable();
+    fbb.addScalar<qint64>(3, bodyLength);
+    fbb.addOffset(2, header);
+    fbb.addScalar<qint16>(0, MetadataV5);
+    fbb.addScalar<quint8>(1, headerType);
+    return fbb.finish(fbb.endTable());
+}
+
+std::vector<quint8> schemaMessage(bool bigEndian) {
+    FlatBuilder fbb;
+    quint32 schema = buildSchema(fbb, bigEndian);
+    return buildMessage(fbb, HeaderSchema, schema, 0);
+}
+
+// buffers holds (offset, length) pairs relative to the message body
+std::vector<quint8> recordBatchMessage(qint64 rows, const std::vector<qint64>& buffers, qint64 bodyLength) {
+    std::vector<quint8> nodeData;
+    for(int i = 0; i < s_columnCount; ++i) {
+        appendLittleEndian<qint64>(nodeData, rows);
+        appendLittleEndian<qint64>(nodeData, 0);  // null_count
+    }
+    std::vector<quint8> bufferData;
+    for(qint64 value : buffers) {
+        appendLittleEndian<qint64>(bufferData, value);
+    }
+    FlatBuilder fbb;
+    quint32 nodes = fbb.createStructVector(nodeData, s_columnCount, 8);
+    quint32 bufferVector = fbb.createStructVector(bufferData, buffers.size() / 2, 8);
+    fbb.startTable();
+    fbb.addScalar<qint64>(0, rows);
+    fbb.addOffset(1, nodes);
+    fbb.addOffset(2, bufferVector);
+    quint32 recordBatch = fbb.endTable();
+    return buildMessage(fbb, HeaderRecordBatch, recordBatch, bodyLength);
+}
+
+// blocks holds (offset, metaDataLength, bodyLength) triples
+std::vector<quint8> footer(const std::vector<qint64>& blocks, bool bigEndian) {
+    std::vector<quint8> blockData;
+    for(size_t i = 0; i + 2 < blocks.size(); i += 3) {
+        appendLittleEndian<qint64>(blockData, blocks[i]);
+        appendLittleEndian<qint32>(blockData, blocks[i + 1]);
+        appendLittleEndian<qint32>(blockData, 0);  // padding
+        appendLittleEndian<qint64>(blockData, blocks[i + 2]);
+    }
+    FlatBuilder fbb;
+    quint32 schema = buildSchema(fbb, bigEndian);
+    quint32 dictionaries = fbb.createStructVector({}, 0, 8);
+    quint32 recordBatches = fbb.createStructVector(blockData, blocks.size() / 3, 8);
+    fbb.startTable();
+    fbb.addScalar<qint16>(0, MetadataV5);
+    fbb.addOffset(1, schema);
+    fbb.addOffset(2, dictionaries);
+    fbb.addOffset(3, recordBatches);
+    return fbb.finish(fbb.endTable());
+}
+
+} // namespace
+
+// Column data is written in host order, the schema records which one that is
+static const bool s_bigEndian = Q_BYTE_ORDER == Q_BIG_ENDIAN;
+static const char s_magic[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+
+template<typename T>
+static void appendBuffer(QByteArray& body, std::vector<qint64>& buffers, const T* data, qint64 size) {
+    buffers.push_back(body.size());
+    buffers.push_back(size);
+    body.append(reinterpret_cast<const char*>(data), size);
+    body.append(QByteArray((8 - size % 8) % 8, '\0'));
+}
+
+bool HOCRWordTable::open(QIODevice* device) {
+    m_device = device;
+    m_ok = device->isWritable();
+    m_offset = 0;
+    m_batches.clear();
+    m_wordOffsets.assign(1, 0);
+    return write(s_magic, sizeof(s_magic)) && writeMessage(schemaMessage(s_bigEndian), QByteArray(), nullptr);
+}
+
+bool HOCRWordTable::addPage(const HOCRPage* page) {
+    qint32 line = -1;
+    collectWords(page, page->pageNr(), line);
+    if(m_ok && int(m_page.size()) >= m_batchRows) {
+        writeBatch();
+    }
+    return m_ok;
+}
+
+void HOCRWordTable::collectWords(const HOCRItem* item, qint32 pageNr, qint32& line) {
+    if(!item->isEnabled()) {
+        return;
+    }
+    QString itemClass = item->itemClass();
+    if(HOCRItem::isLineClass(itemClass)) {
+        ++line;
+    } else if(itemClass == "ocrx_word") {
+        QMap<QString, QString> titleAttrs = item->getTitleAttributes();
+        const QRect& bbox = item->bbox();
+        m_page.push_back(pageNr);
+        m_line.push_back(line);
+        m_wordData.append(item->text().toUtf8());
+        m_wordOffsets.push_back(m_wordData.size());
+        m_bbox[0].push_back(bbox.left());
+        m_bbox[1].push_back(bbox.top());
+        m_bbox[2].push_back(bbox.right());
+        m_bbox[3].push_back(bbox.bottom());
+        m_confidence.push_back(titleAttrs.contains("x_wconf") ? titleAttrs["x_wconf"].toInt() : -1);
+        m_fontSize.push_back(titleAttrs["x_fsize"].toFloat());
+        return;
+    }
+    for(const HOCRItem* child : item->children()) {
+        collectWords(child, pageNr, line);
+    }
+}
+
+bool HOCRWordTable::writeBatch() {
+    qint64 rows = m_page.size();
+    // Each column has a (here empty) validity buffer followed by its values, in schema order
+    QByteArray body;
+    std::vector<qint64> buffers;
+    auto appendInts = [&](const std::vector<qint32>& values) {
+        appendBuffer<char>(body, buffers, nullptr, 0);
+        appendBuffer(body, buffers, values.data(), values.size() * sizeof(qint32));
+    };
+    appendInts(m_page);
+    appendInts(m_line);
+    appendBuffer<char>(body, buffers, nullptr, 0);
+    appendBuffer(body, buffers, m_wordOffsets.data(), m_wordOffsets.size() * sizeof(qint32));
+    appendBuffer(body, buffers, m_wordData.constData(), m_wordData.size());
+    for(const std::vector<qint32>& coordinate : m_bbox) {
+        appendInts(coordinate);
+    }
+    appendInts(m_confidence);
+    appendBuffer<char>(body, buffers, nullptr, 0);
+    appendBuffer(body, buffers, m_fontSize.data(), m_fontSize.size() * sizeof(float));
+
+    Block block;
+    writeMessage(recordBatchMessage(rows, buffers, body.size()), body, &block);
+    m_batches.push_back(block);
+
+    m_page.clear();
+    m_line.clear();
+    m_wordOffsets.assign(1, 0);
+    m_wordData.clear();
+    for(std::vector<qint32>& coordinate : m_bbox) {
+        coordinate.clear();
+    }
+    m_confidence.clear();
+    m_fontSize.clear();
+    return m_ok;
+}
+
+// Encapsulated IPC message: continuation marker, metadata length, metadata padded to 8 bytes, body
+bool HOCRWordTable::writeMessage(const std::vector<quint8>& metadata, const QByteArray& body, Block* block) {
+    qint64 start = m_offset;
+    qint32 length = (metadata.size() + 7) & ~7;
+    quint32 prefix[2] = {qToLittleEndian<quint32>(0xFFFFFFFFu), qToLittleEndian<quint32>(length)};
+    write(reinterpret_cast<const char*>(prefix), sizeof(prefix));
+    write(reinterpret_cast<const char*>(metadata.data()), metadata.size());
+    write(QByteArray(length - metadata.size(), '\0').constData(), length - metadata.size());
+    write(body.constData(), body.size());
+    if(block) {
+        block->offset = start;
+        block->metaDataLength = sizeof(prefix) + length;
+        block->bodyLength = body.size();
+    }
+    return m_ok;
+}
+
+bool HOCRWordTable::close() {
+    if(!m_device) {
+        return m_ok;
+    }
+    if(!m_page.empty()) {
+        writeBatch();
+    }
+    std::vector<qint64> blocks;
+    for(const Block& block : m_batches) {
+        blocks.push_back(block.offset);
+        blocks.push_back(block.metaDataLength);
+        blocks.push_back(block.bodyLength);
+    }
+    // End of stream marker, footer, footer length, trailing magic
+    quint32 endOfStream[2] = {qToLittleEndian<quint32>(0xFFFFFFFFu), 0};
+    std::vector<quint8> footerData = footer(blocks, s_bigEndian);
+    qint32 footerLength = qToLittleEndian<qint32>(footerData.size());
+    write(reinterpret_cast<const char*>(endOfStream), sizeof(endOfStream));
+    write(reinterpret_cast<const char*>(footerData.data()), footerData.size());
+    write(reinterpret_cast<const char*>(&footerLength), sizeof(footerLength));
+    write(s_magic, 6);
+    m_device = nullptr;
+    return m_ok;
+}
+
+bool HOCRWordTable::write(const char* data, qint64 size) {
+    if(m_ok && size > 0) {
+        m_ok = m_device->write(data, size) == size;
+        m_offset += size;
+    }
+    return m_ok;
+}
@@ -0,0 +1,64 @@
+#ifndef HOCRWORDTABLE_HH
+#define HOCRWORDTABLE_HH
+
+#include <QByteArray>
+#include <QIODevice>
+#include <vector>
+
+class HOCRItem;
+class HOCRPage;
+
+/*
+ * Word table of a HOCRDocument as an Arrow IPC file (Feather v2), one row per enabled ocrx_word:
+ *
+ *   page        int32    HOCRPage::pageNr
+ *   line        int32    index of the line (ocr_line, ocr_header, ocr_textfloat, ocr_caption) within its page
+ *   word        utf8
+ *   left, top, right, bottom   int32
+ *   confidence  int32    x_wconf, -1 if missing
+ *   font_size   float32  x_fsize, 0 if missing
+ *
+ * Pages are appended in batches, a record batch is written whenever batchRows rows have
+ * accumulated and by close(). Buffers are 8 byte aligned, so the columns can be used straight
+ * from a mapped file.
+ */
+class HOCRWordTable {
+public:
+    static const int BatchRows = 1 << 16;
+
+    explicit HOCRWordTable(int batchRows = BatchRows) : m_batchRows(batchRows) {}
+
+    // Writes the file header and schema to device, which stays owned by the caller
+    bool open(QIODevice* device);
+    bool addPage(const HOCRPage* page);
+    // Writes the pending rows and the footer
+    bool close();
+
+private:
+    struct Block {
+        qint64 offset;
+        qint32 metaDataLength;
+        qint64 bodyLength;
+    };
+
+    int m_batchRows;
+    QIODevice* m_device = nullptr;
+    qint64 m_offset = 0;
+    bool m_ok = false;
+    std::vector<Block> m_batches;
+
+    std::vector<qint32> m_page;
+    std::vector<qint32> m_line;
+    std::vector<qint32> m_wordOffsets;
+    QByteArray m_wordData;
+    std::vector<qint32> m_bbox[4];
+    std::vector<qint32> m_confidence;
+    std::vector<float> m_fontSize;
+
+    void collectWords(const HOCRItem* item, qint32 pageNr, qint32& line);
+    bool writeBatch();
+    bool writeMessage(const std::vector<quint8>& metadata, const QByteArray& body, Block* block);
+    bool write(const char* data, qint64 size);
+};
+
+#endif // HOCRWORDTABLE_HH
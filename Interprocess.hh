@@ -5,6 +5,8 @@
 #include <boost/interprocess/containers/vector.hpp>
 #include <boost/interprocess/containers/string.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
+#include <atomic>
+#include <cstdint>
 
 using namespace boost::interprocess;
 enum ERROR_CODE {
@@ -49,4 +51,89 @@ public:
     bool m_uniformziLineSpacing;
     int m_preserveSpaceWidth;
 };
+enum PDF_BACKEND {
+    PDF_BACKEND_PODOFO = 0,
+    PDF_BACKEND_QPRINTER
+};
+struct ExportOptions {
+public:
+    ExportOptions() : m_buildTextIndex(false), m_pdfBackend(PDF_BACKEND::PDF_BACKEND_PODOFO), m_pdfImageLayer(false)
+        , m_txtPageSeparator(false), m_correctionConfidence(60), m_correctionDistance(2), m_pageBufferBudgetMB(256)
+        , m_renderAheadPages(0) {}
+    bool m_buildTextIndex;/*write <outPath>.idx word index*/
+    PDF_BACKEND m_pdfBackend;
+    bool m_pdfImageLayer;/*page image under invisible text*/
+    bool m_txtPageSeparator;/*form feed between pages of txt output*/
+    int m_correctionConfidence;/*words below this x_wconf are looked up in the dictionary, if one is given*/
+    int m_correctionDistance;/*max edit distance of a dictionary correction*/
+    int m_pageBufferBudgetMB;/*rendered page images held at once, rendering waits beyond it; 0 for no limit*/
+    int m_renderAheadPages;/*pages rendered ahead of recognition within the budget; 0 renders each page when it is recognized*/
+};
+enum PIPELINE_STAGE {
+    STAGE_POPPLER_LOAD = 0,
+    STAGE_RENDER,
+    STAGE_PREPROCESS,
+    STAGE_RECOGNIZE,
+    STAGE_HOCR_PARSE,
+    STAGE_EXPORT,
+    STAGE_COUNT
+};
+inline const char* stageName(PIPELINE_STAGE stage) {
+    static const char* const names[STAGE_COUNT] = {"poppler_load", "render", "preprocess", "recognize", "hocr_parse", "export"};
+    return names[stage];
+}
+// Durations of one stage in log2 buckets: bucket 0 counts durations below 1us, bucket i those in
+// [2^(i-1), 2^i) us, the last one everything longer
+struct StageHistogram {
+    static const int BucketCount = 32;
+    std::atomic<std::uint64_t> m_buckets[BucketCount];
+    std::atomic<std::uint64_t> m_count;
+    std::atomic<std::uint64_t> m_totalUs;
+    std::atomic<std::uint64_t> m_maxUs;
+};
+// Written by EndProcess while it runs, from several threads, and read by FrontUI at any time.
+// Only lock-free atomics, which work across processes.
+struct PipelineStats {
+public:
+    PipelineStats() {
+        for(StageHistogram& histogram : m_stages) {
+            for(std::atomic<std::uint64_t>& bucket : histogram.m_buckets) {
+                bucket = 0;
+            }
+            histogram.m_count = 0;
+            histogram.m_totalUs = 0;
+            histogram.m_maxUs = 0;
+        }
+        m_pagesRecognized = 0;
+        m_pagesRead = 0;
+        m_bytesWritten = 0;
+        m_peakRssBytes = 0;
+        m_pageBufferPeakBytes = 0;
+        m_pageBufferStallUs = 0;
+        m_finished = false;
+    }
+    void record(PIPELINE_STAGE stage, std::uint64_t us) {
+        StageHistogram& histogram = m_stages[stage];
+        int bucket = 0;
+        while(bucket < StageHistogram::BucketCount - 1 && (us >> bucket) != 0) {
+            ++bucket;
+        }
+        histogram.m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        histogram.m_count.fetch_add(1, std::memory_order_relaxed);
+        histogram.m_totalUs.fetch_add(us, std::memory_order_relaxed);
+        raise(histogram.m_maxUs, us);
+    }
+    static void raise(std::atomic<std::uint64_t>& value, std::uint64_t candidate) {
+        std::uint64_t current = value.load(std::memory_order_relaxed);
+        while(current < candidate && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {}
+    }
+    StageHistogram m_stages[STAGE_COUNT];
+    std::atomic<std::uint64_t> m_pagesRecognized;
+    std::atomic<std::uint64_t> m_pagesRead;/*pages of hOCR or snapshot input*/
+    std::atomic<std::uint64_t> m_bytesWritten;/*size of the published targets and indexes*/
+    std::atomic<std::uint64_t> m_peakRssBytes;
+    std::atomic<std::uint64_t> m_pageBufferPeakBytes;/*high-water mark of the page buffer budget*/
+    std::atomic<std::uint64_t> m_pageBufferStallUs;/*time rendering waited for the budget*/
+    std::atomic<bool> m_finished;/*set once the last stage is recorded, which may be after m_progress reached 100*/
+};
 #endif // INTERPROCESS_HH
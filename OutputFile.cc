@@ -0,0 +1,153 @@
+#include <QFileInfo>
+#ifdef WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "OutputFile.hh"
+
+OutputFile::OutputFile(const QString& target)
+    : m_target(target), m_file(partPath(target)) {
+}
+
+OutputFile::~OutputFile() {
+    close();
+}
+
+bool OutputFile::publish(const QString& target) {
+    QFile file(partPath(target));
+    bool ok = file.exists() && file.open(QIODevice::ReadWrite) && syncFile(file);
+    file.close();
+    ok = ok && replaceFile(file.fileName(), target);
+    if(!ok) {
+        file.remove();
+    }
+    return ok;
+}
+
+bool OutputFile::open(OpenMode mode) {
+    if((mode & ReadOnly) || !(mode & WriteOnly) || isOpen()) {
+        return false;
+    }
+    // The writer thread hands whole buffers to the file, a second buffer in QFile would only copy them
+    if(!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        setErrorString(m_file.errorString());
+        return false;
+    }
+    m_buffer.clear();
+    m_buffer.reserve(BufferSize);
+    m_queue.clear();
+    m_stop = false;
+    m_failed = false;
+    m_writer = std::thread(&OutputFile::run, this);
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void OutputFile::close() {
+    if(isOpen()) {
+        finishWrites();
+        m_file.close();
+        m_file.remove();
+        QIODevice::close();
+    }
+}
+
+bool OutputFile::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(!m_buffer.isEmpty()) {
+        m_condition.wait(lock, [this] { return m_failed || int(m_queue.size()) < BufferCount; });
+        if(!m_failed) {
+            m_queue.push_back(std::move(m_buffer));
+            m_condition.notify_all();
+        }
+        m_buffer = QByteArray();
+        m_buffer.reserve(BufferSize);
+    }
+    return !m_failed;
+}
+
+bool OutputFile::commit() {
+    if(!isOpen()) {
+        return false;
+    }
+    bool ok = finishWrites() && syncFile(m_file);
+    m_file.close();
+    ok = ok && m_file.error() == QFile::NoError && replaceFile(m_file.fileName(), m_target);
+    if(!ok) {
+        m_file.remove();
+    }
+    QIODevice::close();
+    return ok;
+}
+
+qint64 OutputFile::writeData(const char* data, qint64 size) {
+    m_buffer.append(data, size);
+    if(m_buffer.size() >= BufferSize && !flush()) {
+        setErrorString(m_file.errorString());
+        return -1;
+    }
+    return size;
+}
+
+void OutputFile::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true) {
+        m_condition.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if(m_queue.empty()) {
+            break;
+        }
+        QByteArray buffer = m_queue.front();
+        lock.unlock();
+        bool ok = m_file.write(buffer) == buffer.size();
+        lock.lock();
+        m_queue.pop_front();
+        if(!ok) {
+            // Later buffers are dropped, the writing thread sees the failure with its next flush
+            m_failed = true;
+            m_queue.clear();
+        }
+        m_condition.notify_all();
+    }
+}
+
+bool OutputFile::finishWrites() {
+    bool ok = flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    if(m_writer.joinable()) {
+        m_writer.join();
+    }
+    return ok && !m_failed;
+}
+
+bool OutputFile::syncFile(QFile& file) {
+#ifdef WIN32
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+bool OutputFile::replaceFile(const QString& from, const QString& to) {
+#ifdef WIN32
+    return MoveFileExW(reinterpret_cast<LPCWSTR>(from.utf16()), reinterpret_cast<LPCWSTR>(to.utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    if(::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) != 0) {
+        return false;
+    }
+    // The new directory entry has to reach the disk as well
+    int dir = ::open(QFile::encodeName(QFileInfo(to).absolutePath()).constData(), O_RDONLY);
+    if(dir >= 0) {
+        ::fsync(dir);
+        ::close(dir);
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,67 @@
+#ifndef OUTPUTFILE_HH
+#define OUTPUTFILE_HH
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+
+/*
+ * Write only device for export targets. Writes are collected in large buffers, which a dedicated
+ * thread appends to partPath(target), so the caller never waits on the disk unless BufferCount
+ * buffers are already queued. commit() waits for the writes, syncs the file and renames it over
+ * target: readers see either the previous target or the complete new one. Closing or destroying
+ * the device without a commit removes the part file.
+ */
+class OutputFile : public QIODevice {
+public:
+    static const int BufferSize = 4 << 20;
+    static const int BufferCount = 4;
+
+    explicit OutputFile(const QString& target);
+    ~OutputFile();
+
+    static QString partPath(const QString& target) {
+        return target + ".part";
+    }
+    // For files written by other means to partPath(target): syncs and renames it
+    static bool publish(const QString& target);
+
+    bool isSequential() const override {
+        return true;
+    }
+    bool open(OpenMode mode) override;
+    void close() override;
+    // Queues the buffered data even if the buffer is not full, e.g. to let whole pages reach the part file
+    bool flush();
+    bool commit();
+
+protected:
+    qint64 readData(char* /*data*/, qint64 /*maxSize*/) override {
+        return -1;
+    }
+    qint64 writeData(const char* data, qint64 size) override;
+
+private:
+    QString m_target;
+    QFile m_file;
+    QByteArray m_buffer;
+
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<QByteArray> m_queue;
+    bool m_stop = false;
+    bool m_failed = false;
+
+    void run();
+    bool finishWrites();
+    static bool syncFile(QFile& file);
+    static bool replaceFile(const QString& from, const QString& to);
+};
+
+#endif // OUTPUTFILE_HH
@@ -0,0 +1,40 @@
+#include <chrono>
+#include "Interprocess.hh"
+#include "PageBufferBudget.hh"
+
+void PageBufferBudget::setLimit(qint64 limit) {
+    QMutexLocker locker(&m_mutex);
+    m_limit = limit;
+    m_released.wakeAll();
+}
+
+void PageBufferBudget::acquire(qint64 bytes) {
+    QMutexLocker locker(&m_mutex);
+    if(m_limit > 0 && m_inFlight > 0 && m_inFlight + bytes > m_limit) {
+        auto start = std::chrono::steady_clock::now();
+        do {
+            m_released.wait(&m_mutex);
+        } while(m_limit > 0 && m_inFlight > 0 && m_inFlight + bytes > m_limit);
+        if(m_stats) {
+            m_stats->m_pageBufferStallUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    m_inFlight += bytes;
+    if(m_inFlight > m_highWater) {
+        m_highWater = m_inFlight;
+        if(m_stats) {
+            PipelineStats::raise(m_stats->m_pageBufferPeakBytes, m_highWater);
+        }
+    }
+}
+
+void PageBufferBudget::release(qint64 bytes) {
+    QMutexLocker locker(&m_mutex);
+    m_inFlight -= bytes;
+    m_released.wakeAll();
+}
+
+qint64 PageBufferBudget::highWater() const {
+    QMutexLocker locker(&m_mutex);
+    return m_highWater;
+}
@@ -0,0 +1,53 @@
+#ifndef PAGEBUFFERBUDGET_HH
+#define PAGEBUFFERBUDGET_HH
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QtGlobal>
+
+struct PipelineStats;
+
+/*
+ * Bounds the bytes of rendered page images alive at once. Rendering acquires a page's share before
+ * it allocates the image and blocks while the budget is used up; the share is released once the
+ * page is done with. A request is always admitted while nothing else is in flight, so a page larger
+ * than the whole budget still gets through, just alone.
+ */
+class PageBufferBudget {
+public:
+    // 0 for no limit
+    explicit PageBufferBudget(qint64 limit = 0) : m_limit(limit) {}
+
+    void setLimit(qint64 limit);
+    // The high-water mark and the time spent waiting are reported to stats, which may be null
+    void setStats(PipelineStats* stats) {
+        m_stats = stats;
+    }
+    void acquire(qint64 bytes);
+    void release(qint64 bytes);
+    qint64 highWater() const;
+
+    // Holds bytes of the budget for its lifetime
+    class Reservation {
+    public:
+        Reservation(PageBufferBudget& budget, qint64 bytes) : m_budget(budget), m_bytes(bytes) {
+            m_budget.acquire(m_bytes);
+        }
+        ~Reservation() {
+            m_budget.release(m_bytes);
+        }
+    private:
+        PageBufferBudget& m_budget;
+        qint64 m_bytes;
+    };
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_released;
+    qint64 m_limit;
+    qint64 m_inFlight = 0;
+    qint64 m_highWater = 0;
+    PipelineStats* m_stats = nullptr;
+};
+
+#endif // PAGEBUFFERBUDGET_HH
@@ -1 +1,327 @@
 #include "Painter.hh"
+#include "CCITTFax4Encoder.hh"
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <podofo/podofo.h>
+
+// Hands what PoDoFo writes to a std::ostream on to a QIODevice
+class DeviceStreamBuffer : public std::streambuf {
+public:
+    explicit DeviceStreamBuffer(QIODevice* device) : m_device(device) {}
+
+protected:
+    int_type overflow(int_type c) override {
+        if(traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+        char ch = traits_type::to_char_type(c);
+        return m_device->write(&ch, 1) == 1 ? c : traits_type::eof();
+    }
+    std::streamsize xsputn(const char* data, std::streamsize size) override {
+        return std::max<qint64>(m_device->write(data, size), 0);
+    }
+
+private:
+    QIODevice* m_device;
+};
+
+PoDoFoPDFPainter::PoDoFoPDFPainter(QIODevice* device, const QString& creator, const QFont& defaultFont)
+    : m_defaultFontFamily(defaultFont.family()), m_defaultFontSize(defaultFont.pointSizeF()) {
+    openDocument(device, creator);
+}
+
+PoDoFoPDFPainter::~PoDoFoPDFPainter() {
+    delete m_painter;
+    // Fonts are owned by the document
+    delete m_document;
+    delete m_outputDevice;
+    delete m_stream;
+    delete m_streamBuffer;
+}
+
+void PoDoFoPDFPainter::openDocument(QIODevice* device, const QString& creator) {
+    try {
+        m_streamBuffer = new DeviceStreamBuffer(device);
+        m_stream = new std::ostream(m_streamBuffer);
+        m_outputDevice = new PoDoFo::PdfOutputDevice(m_stream);
+        m_document = new PoDoFo::PdfStreamedDocument(m_outputDevice);
+        m_document->GetInfo()->SetCreator(PoDoFo::PdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(creator.toUtf8().data())));
+    } catch(PoDoFo::PdfError& err) {
+        delete m_document;
+        m_document = nullptr;
+        m_errMsg = QString("Failed to create PDF document: %1").arg(PoDoFo::PdfError::ErrorMessage(err.GetError()));
+    }
+    m_encoding = PoDoFo::PdfEncodingFactory::GlobalIdentityEncodingInstance();
+    m_painter = new PoDoFo::PdfPainter();
+}
+
+PoDoFo::PdfFont* PoDoFoPDFPainter::getFont(QString family, bool bold, bool italic) {
+    QString key = family + (bold ? "@bold" : "") + (italic ? "@italic" : "");
+    auto it = m_fontCache.find(key);
+    if(it == m_fontCache.end()) {
+        if(family.isEmpty() || !m_fontDatabase.hasFamily(family)) {
+            family = m_defaultFontFamily;
+        }
+        PoDoFo::PdfFont* font = nullptr;
+        try {
+            font = m_document->CreateFontSubset(family.toLocal8Bit().data(), bold, italic, false, m_encoding);
+        } catch(PoDoFo::PdfError& /*err*/) {
+            font = nullptr;
+        }
+        if(!font && family != m_defaultFontFamily) {
+            font = getFont(m_defaultFontFamily, false, false);
+        }
+        it = m_fontCache.insert(key, font);
+    }
+    return it.value();
+}
+
+void PoDoFoPDFPainter::setFontFamily(const QString& family, bool bold, bool italic) {
+    PoDoFo::PdfFont* curFont = m_painter->GetFont();
+    PoDoFo::PdfFont* font = getFont(family, bold, italic);
+    if(!font || font == curFont) {
+        return;
+    }
+    float curSize = curFont ? curFont->GetFontSize() : m_defaultFontSize;
+    m_painter->SetFont(font);
+    font->SetFontSize(curSize);
+}
+
+void PoDoFoPDFPainter::setFontSize(double pointSize, bool defaultFont) {
+    if(defaultFont) {
+        m_defaultFontSize = pointSize;
+    } else if(m_painter->GetFont()) {
+        m_painter->GetFont()->SetFontSize(pointSize);
+    }
+}
+
+void PoDoFoPDFPainter::drawText(double x, double y, const QString& text) {
+    if(!m_painter->GetFont()) {
+        return;
+    }
+    PoDoFo::PdfString pdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(text.toUtf8().data()));
+    m_painter->DrawText(m_offsetX + x, m_pageHeight - m_offsetY - y, pdfString);
+}
+
+void PoDoFoPDFPainter::setTextInvisible(bool invisible) {
+    m_textInvisible = invisible;
+    m_painter->SetTextRenderingMode(invisible ? PoDoFo::ePdfTextRenderingMode_Invisible : PoDoFo::ePdfTextRenderingMode_Fill);
+}
+
+EncodedImage PoDoFoPDFPainter::encodeImage(const QImage& image, const PDFSettings& settings) const {
+    QImage img = convertedImage(image, settings.colorFormat, settings.conversionFlags);
+    if(img.format() != QImage::Format_Mono && img.format() != QImage::Format_Indexed8 &&
+            img.format() != QImage::Format_Grayscale8 && img.format() != QImage::Format_RGB888) {
+        img = img.convertToFormat(QImage::Format_RGB888);
+    }
+    EncodedImage encoded;
+    encoded.width = img.width();
+    encoded.height = img.height();
+    encoded.bitsPerComponent = img.format() == QImage::Format_Mono ? 1 : 8;
+    encoded.gray = img.format() != QImage::Format_RGB888;
+    // Qt usually puts white at index 0 of mono images, i.e. set bits are black
+    bool blackIsOne = encoded.bitsPerComponent == 1 && qGray(img.color(0)) > qGray(img.color(1));
+    if(settings.compression == PDFSettings::CompressJpeg && encoded.bitsPerComponent == 8) {
+        encoded.filter = EncodedImage::FilterDCT;
+        QBuffer buffer(&encoded.data);
+        img.save(&buffer, "jpg", settings.compressionQuality);
+    } else if(settings.compression == PDFSettings::CompressFax4 && encoded.bitsPerComponent == 1) {
+        encoded.filter = EncodedImage::FilterFax4;
+        std::vector<unsigned char> data = CCITTFax4Encoder::encode(img.constBits(), encoded.width, encoded.height, img.bytesPerLine(), blackIsOne);
+        encoded.data = QByteArray(reinterpret_cast<const char*>(data.data()), data.size());
+    } else {
+        encoded.filter = EncodedImage::FilterFlate;
+        // Samples are written row by row without the scanline padding of QImage
+        int rowBytes = (encoded.width * img.depth() + 7) / 8;
+        QByteArray data(rowBytes * encoded.height, 0);
+        for(int y = 0; y < encoded.height; ++y) {
+            std::memcpy(data.data() + y * rowBytes, img.constScanLine(y), rowBytes);
+        }
+        // In DeviceGray a zero bit is black
+        if(blackIsOne) {
+            for(int i = 0, n = data.size(); i < n; ++i) {
+                data[i] = ~data[i];
+            }
+        }
+        // qCompress prefixes the zlib stream with the uncompressed size
+        encoded.data = qCompress(data).mid(4);
+    }
+    return encoded;
+}
+
+void PoDoFoPDFPainter::drawEncodedImage(const QRect& bbox, const EncodedImage& image) {
+    if(image.data.isEmpty()) {
+        return;
+    }
+    PoDoFo::PdfImage pdfImage(m_document);
+    pdfImage.SetImageColorSpace(image.gray ? PoDoFo::ePdfColorSpace_DeviceGray : PoDoFo::ePdfColorSpace_DeviceRGB);
+    PoDoFo::PdfDictionary& dict = pdfImage.GetObject()->GetDictionary();
+    PoDoFo::EPdfFilter filter = PoDoFo::ePdfFilter_FlateDecode;
+    if(image.filter == EncodedImage::FilterDCT) {
+        filter = PoDoFo::ePdfFilter_DCTDecode;
+    } else if(image.filter == EncodedImage::FilterFax4) {
+        filter = PoDoFo::ePdfFilter_CCITTFaxDecode;
+        PoDoFo::PdfDictionary decodeParms;
+        decodeParms.AddKey("Columns", PoDoFo::PdfObject(PoDoFo::pdf_int64(image.width)));
+        decodeParms.AddKey("Rows", PoDoFo::PdfObject(PoDoFo::pdf_int64(image.height)));
+        decodeParms.AddKey("K", PoDoFo::PdfObject(PoDoFo::pdf_int64(-1))); // Pure two-dimensional encoding (Group 4)
+        dict.AddKey("DecodeParms", PoDoFo::PdfObject(decodeParms));
+    }
+    dict.AddKey(PoDoFo::PdfName::KeyFilter, PoDoFo::PdfName(PoDoFo::PdfFilterFactory::FilterTypeToName(filter)));
+    // The data is already filtered, it is appended as is
+    PoDoFo::PdfMemoryInputStream is(image.data.constData(), image.data.size());
+    pdfImage.SetImageDataRaw(image.width, image.height, image.bitsPerComponent, &is);
+    m_painter->DrawImage(m_offsetX + bbox.x(), m_pageHeight - m_offsetY - (bbox.y() + bbox.height()),
+                         &pdfImage, bbox.width() / double(image.width), bbox.height() / double(image.height));
+}
+
+double PoDoFoPDFPainter::getAverageCharWidth() const {
+    PoDoFo::PdfFont* font = m_painter->GetFont();
+    return font ? font->GetFontMetrics()->CharWidth(static_cast<unsigned char>('x')) : 0.0;
+}
+
+double PoDoFoPDFPainter::getTextWidth(const QString& text) const {
+    PoDoFo::PdfFont* font = m_painter->GetFont();
+    if(!font) {
+        return 0.0;
+    }
+    double fontSize = font->GetFontSize();
+    if(fontSize <= 0) {
+        return 0.0;
+    }
+    QHash<uint, double>& advances = m_advances[font];
+    double width = 0.0;
+    for(int i = 0, n = text.size(); i < n; ++i) {
+        uint codepoint = text[i].unicode();
+        int len = 1;
+        if(text[i].isHighSurrogate() && i + 1 < n && text[i + 1].isLowSurrogate()) {
+            codepoint = QChar::surrogateToUcs4(text[i], text[i + 1]);
+            len = 2;
+        }
+        auto it = advances.find(codepoint);
+        if(it == advances.end()) {
+            PoDoFo::PdfString pdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(text.mid(i, len).toUtf8().data()));
+            it = advances.insert(codepoint, font->GetFontMetrics()->StringWidth(pdfString) / fontSize);
+        }
+        width += it.value();
+        i += len - 1;
+    }
+    return width * fontSize;
+}
+
+// Keeps the size 1 metrics it has seen per family, only misses go to the painter
+class PoDoFoPDFPainter::Measurer : public TextMeasurer {
+public:
+    explicit Measurer(PoDoFoPDFPainter* painter) : m_painter(painter) {}
+    void setFont(const QString& family, double pointSize) override {
+        m_family = family;
+        m_size = pointSize;
+        m_advances = &m_familyAdvances[family];
+    }
+    double averageCharWidth() override {
+        auto it = m_averageCharWidths.find(m_family);
+        if(it == m_averageCharWidths.end()) {
+            it = m_averageCharWidths.insert(m_family, m_painter->unitAverageCharWidth(m_family));
+        }
+        return it.value() * m_size;
+    }
+    double textWidth(const QString& text) override {
+        if(!m_advances || m_size <= 0) {
+            return 0.0;
+        }
+        double width = 0.0;
+        for(int i = 0, n = text.size(); i < n; ++i) {
+            uint codepoint = text[i].unicode();
+            int len = 1;
+            if(text[i].isHighSurrogate() && i + 1 < n && text[i + 1].isLowSurrogate()) {
+                codepoint = QChar::surrogateToUcs4(text[i], text[i + 1]);
+                len = 2;
+            }
+            auto it = m_advances->find(codepoint);
+            if(it == m_advances->end()) {
+                it = m_advances->insert(codepoint, m_painter->unitAdvance(m_family, codepoint, text.mid(i, len)));
+            }
+            width += it.value();
+            i += len - 1;
+        }
+        return width * m_size;
+    }
+private:
+    PoDoFoPDFPainter* m_painter;
+    QString m_family;
+    double m_size = 0.0;
+    QHash<QString, double> m_averageCharWidths;
+    QHash<QString, QHash<uint, double>> m_familyAdvances;
+    QHash<uint, double>* m_advances = nullptr;
+};
+
+TextMeasurer* PoDoFoPDFPainter::createMeasurer() {
+    return new Measurer(this);
+}
+
+double PoDoFoPDFPainter::unitAverageCharWidth(const QString& family) {
+    QMutexLocker locker(&m_metricsMutex);
+    PoDoFo::PdfFont* font = getFont(family, false, false);
+    if(!font || font->GetFontSize() <= 0) {
+        return 0.0;
+    }
+    return font->GetFontMetrics()->CharWidth(static_cast<unsigned char>('x')) / font->GetFontSize();
+}
+
+double PoDoFoPDFPainter::unitAdvance(const QString& family, uint codepoint, const QString& character) {
+    QMutexLocker locker(&m_metricsMutex);
+    PoDoFo::PdfFont* font = getFont(family, false, false);
+    if(!font || font->GetFontSize() <= 0) {
+        return 0.0;
+    }
+    QHash<uint, double>& advances = m_advances[font];
+    auto it = advances.find(codepoint);
+    if(it == advances.end()) {
+        PoDoFo::PdfString pdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(character.toUtf8().data()));
+        it = advances.insert(codepoint, font->GetFontMetrics()->StringWidth(pdfString) / font->GetFontSize());
+    }
+    return it.value();
+}
+
+bool PoDoFoPDFPainter::createPage(double width, double height, double offsetX, double offsetY, QString& errMsg) {
+    if(!m_document) {
+        errMsg = m_errMsg;
+        return false;
+    }
+    try {
+        PoDoFo::PdfPage* pdfPage = m_document->CreatePage(PoDoFo::PdfRect(0, 0, width, height));
+        m_painter->SetPage(pdfPage);
+        m_painter->SetTextRenderingMode(m_textInvisible ? PoDoFo::ePdfTextRenderingMode_Invisible : PoDoFo::ePdfTextRenderingMode_Fill);
+        PoDoFo::PdfFont* font = getFont(m_defaultFontFamily, false, false);
+        if(font) {
+            m_painter->SetFont(font);
+            font->SetFontSize(m_defaultFontSize);
+        }
+    } catch(PoDoFo::PdfError& err) {
+        errMsg = QString("Failed to create page: %1").arg(PoDoFo::PdfError::ErrorMessage(err.GetError()));
+        return false;
+    }
+    m_pageHeight = height;
+    m_offsetX = offsetX;
+    m_offsetY = offsetY;
+    return true;
+}
+
+void PoDoFoPDFPainter::finishPage() {
+    m_painter->FinishPage();
+}
+
+bool PoDoFoPDFPainter::finishDocument(QString& errMsg) {
+    if(!m_document) {
+        errMsg = m_errMsg;
+        return false;
+    }
+    try {
+        m_document->Close();
+    } catch(PoDoFo::PdfError& err) {
+        errMsg = QString("Failed to write PDF: %1").arg(PoDoFo::PdfError::ErrorMessage(err.GetError()));
+        return false;
+    }
+    return true;
+}
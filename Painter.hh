@@ -10,6 +10,16 @@
 #include <QBuffer>
 #include <QMutexLocker>
 #include <QTimer>
+#include <iosfwd>
+#include "GlyphCache.hh"
+
+namespace PoDoFo {
+class PdfEncoding;
+class PdfFont;
+class PdfOutputDevice;
+class PdfPainter;
+class PdfStreamedDocument;
+}
 
 struct PDFSettings {
     QImage::Format colorFormat;
@@ -24,14 +34,67 @@ struct PDFSettings {
     double detectedFontScaling;
 };
 
+/*
+ * A page image in the form a painter appends it to the document, see PDFPainter::encodeImage.
+ * Stream based backends fill data with the filtered stream, QPainter based ones keep the converted image.
+ */
+struct EncodedImage {
+    enum Filter { FilterNone, FilterFlate, FilterDCT, FilterFax4 };
+    Filter filter = FilterNone;
+    int width = 0;
+    int height = 0;
+    int bitsPerComponent = 8;
+    bool gray = false;
+    QByteArray data;
+    QImage image;
+
+    bool isNull() const {
+        return data.isEmpty() && image.isNull();
+    }
+};
+
+/*
+ * Text positioned by the layout pass, in page units. Replaying the runs with setFontFamily,
+ * setFontSize and drawText paints the page text.
+ */
+struct GlyphRun {
+    double x;
+    double y;
+    QString fontFamily;
+    double fontSize;
+    QString text;
+};
+
+/*
+ * Measures text with the same metrics as the painter it was created from, so that pages can be
+ * laid out on other threads. An instance belongs to one thread and must not outlive its painter.
+ */
+class TextMeasurer {
+public:
+    virtual ~TextMeasurer() {}
+    virtual void setFont(const QString& family, double pointSize) = 0;
+    virtual double averageCharWidth() = 0;
+    virtual double textWidth(const QString& text) = 0;
+};
+
 class PDFPainter {
 public:
+    virtual ~PDFPainter() {}
     virtual void setFontFamily(const QString& family, bool bold, bool italic) = 0;
     virtual void setFontSize(double pointSize, bool defaultFont = false) = 0;
     virtual void drawText(double x, double y, const QString& text) = 0;
-    virtual void drawImage(const QRect& bbox, const QImage& image, const PDFSettings& settings) = 0;
+    // Invisible text is still extractable and searchable, e.g. when laid over the page image
+    virtual void setTextInvisible(bool invisible) = 0;
+    void drawImage(const QRect& bbox, const QImage& image, const PDFSettings& settings) {
+        drawEncodedImage(bbox, encodeImage(image, settings));
+    }
+    // Only reads the painter configuration, so it may run for several images concurrently
+    virtual EncodedImage encodeImage(const QImage& image, const PDFSettings& settings) const = 0;
+    virtual void drawEncodedImage(const QRect& bbox, const EncodedImage& image) = 0;
     virtual double getAverageCharWidth() const = 0;
     virtual double getTextWidth(const QString& text) const = 0;
+    // Measurers of one painter may run concurrently, but not while the painter draws
+    virtual TextMeasurer* createMeasurer() = 0;
     virtual bool createPage(double /*width*/, double /*height*/, double /*offsetX*/, double /*offsetY*/, QString& /*errMsg*/) { return true; }
     virtual void finishPage() {}
     virtual bool finishDocument(QString& /*errMsg*/) { return true; }
@@ -64,59 +127,112 @@ protected:
 class QPainterPDFPainter : public PDFPainter {
 public:
     QPainterPDFPainter(QPainter* painter, const QFont& defaultFont)
-        : m_painter(painter), m_defaultFont(defaultFont) {
-        m_curFont = m_defaultFont;
+        : m_painter(painter), m_defaultFont(defaultFont), m_glyphCache(defaultFont) {
+        m_curFamily = m_defaultFont.family();
+        m_curSize = m_defaultFont.pointSizeF();
     }
     void setFontFamily(const QString& family, bool bold, bool italic) override {
-        float curSize = m_curFont.pointSize();
-        if(m_fontDatabase.hasFamily(family)) {
-            m_curFont.setFamily(family);
-        }  else {
-            m_curFont = m_defaultFont;
-        }
-        m_curFont.setPointSize(curSize);
-        m_curFont.setBold(bold);
-        m_curFont.setItalic(italic);
-        m_painter->setFont(m_curFont);
+        m_curFamily = family;
+        m_curBold = bold;
+        m_curItalic = italic;
+        applyFont();
     }
     void setFontSize(double pointSize, bool defaultFont) override {
         if(defaultFont) {
-            if(pointSize != m_defaultFont.pointSize()) {
-                m_defaultFont.setPointSize(pointSize);
-            }
-        } else {
-            if(pointSize != m_curFont.pointSize()) {
-                m_curFont.setPointSize(pointSize);
-                m_painter->setFont(m_curFont);
+            if(pointSize != m_defaultFont.pointSizeF()) {
+                m_defaultFont.setPointSizeF(pointSize);
             }
+        } else if(pointSize != m_curSize) {
+            m_curSize = pointSize;
+            applyFont();
         }
     }
     void drawText(double x, double y, const QString& text) override {
         m_painter->drawText(m_offsetX + x, m_offsetY + y, text);
     }
-    void drawImage(const QRect& bbox, const QImage& image, const PDFSettings& settings) override {
-        QImage img = convertedImage(image, settings.colorFormat, settings.conversionFlags);
+    void setTextInvisible(bool invisible) override {
+        m_textInvisible = invisible;
+        applyPen();
+    }
+    EncodedImage encodeImage(const QImage& image, const PDFSettings& settings) const override {
+        EncodedImage encoded;
+        encoded.image = convertedImage(image, settings.colorFormat, settings.conversionFlags);
         if(settings.compression == PDFSettings::CompressJpeg) {
             QByteArray data;
             QBuffer buffer(&data);
-            img.save(&buffer, "jpg", settings.compressionQuality);
-            img = QImage::fromData(data);
+            encoded.image.save(&buffer, "jpg", settings.compressionQuality);
+            encoded.image = QImage::fromData(data);
         }
-        m_painter->drawImage(bbox, img);
+        return encoded;
+    }
+    void drawEncodedImage(const QRect& bbox, const EncodedImage& image) override {
+        m_painter->drawImage(QRectF(bbox).translated(m_offsetX, m_offsetY), image.image);
     }
     double getAverageCharWidth() const override {
-        return m_painter->fontMetrics().averageCharWidth();
+        return m_curFont ? m_curFont->averageCharWidth : m_painter->fontMetrics().averageCharWidth();
     }
     double getTextWidth(const QString& text) const override {
-        return m_painter->fontMetrics().width(text);
+        return m_curFont ? m_glyphCache.textWidth(m_curFont, text) : m_painter->fontMetrics().width(text);
+    }
+    TextMeasurer* createMeasurer() override {
+        return new Measurer(m_glyphCache.defaultFont());
     }
 protected:
-    QFontDatabase m_fontDatabase;
+    // Resolves fonts like applyFont, from a cache of its own
+    class Measurer : public TextMeasurer {
+    public:
+        explicit Measurer(const QFont& defaultFont) : m_glyphCache(defaultFont) {}
+        void setFont(const QString& family, double pointSize) override {
+            m_font = m_glyphCache.font(family, pointSize, false, false);
+        }
+        double averageCharWidth() override {
+            return m_font ? m_font->averageCharWidth : 0.0;
+        }
+        double textWidth(const QString& text) override {
+            return m_font ? m_glyphCache.textWidth(m_font, text) : 0.0;
+        }
+    private:
+        GlyphAdvanceCache m_glyphCache;
+        GlyphAdvanceCache::Font* m_font = nullptr;
+    };
+
+
     QPainter* m_painter;
-    QFont m_curFont;
     QFont m_defaultFont;
+    mutable GlyphAdvanceCache m_glyphCache;
+    GlyphAdvanceCache::Font* m_curFont = nullptr;
+    QString m_curFamily;
+    double m_curSize;
+    bool m_curBold = false;
+    bool m_curItalic = false;
+    bool m_textInvisible = false;
     double m_offsetX = 0.0;
     double m_offsetY = 0.0;
+
+    void resetFont() {
+        m_curFamily = m_defaultFont.family();
+        m_curSize = m_defaultFont.pointSizeF();
+        m_curBold = m_curItalic = false;
+        m_curFont = nullptr;
+        applyFont();
+    }
+    void applyPen() {
+        if(m_painter) {
+            // A fully transparent pen keeps the text in the content stream
+            m_painter->setPen(m_textInvisible ? QColor(Qt::transparent) : QColor(Qt::black));
+        }
+    }
+    void applyFont() {
+        if(!m_painter) {
+            return;
+        }
+        // Fonts are resolved once, the painter font only changes if the resolved font does
+        GlyphAdvanceCache::Font* font = m_glyphCache.font(m_curFamily, m_curSize, m_curBold, m_curItalic);
+        if(font != m_curFont) {
+            m_curFont = font;
+            m_painter->setFont(font->font);
+        }
+    }
 };
 
 class QPrinterPDFPainter : public QPainterPDFPainter {
@@ -153,8 +269,8 @@ public:
             }
             m_firstPage = false;
         }
-        m_curFont = m_defaultFont;
-        m_painter->setFont(m_curFont);
+        resetFont();
+        applyPen();
         m_offsetX = offsetX;
         m_offsetY = offsetY;
         return true;
@@ -162,9 +278,11 @@ public:
     bool finishDocument(QString& /*errMsg*/) override {
         return m_painter->end();
     }
-    void drawImage(const QRect& bbox, const QImage& image, const PDFSettings& settings) override {
-        QImage img = convertedImage(image, settings.colorFormat, settings.conversionFlags);
-        m_painter->drawImage(bbox, img);
+    EncodedImage encodeImage(const QImage& image, const PDFSettings& settings) const override {
+        // The PDF engine compresses images itself
+        EncodedImage encoded;
+        encoded.image = convertedImage(image, settings.colorFormat, settings.conversionFlags);
+        return encoded;
     }
 
 private:
@@ -172,4 +290,52 @@ private:
     bool m_firstPage = true;
 };
 
+class PoDoFoPDFPainter : public PDFPainter {
+public:
+    // Writes the document to device, which has to stay open until the painter is destroyed
+    PoDoFoPDFPainter(QIODevice* device, const QString& creator, const QFont& defaultFont);
+    ~PoDoFoPDFPainter();
+    void setFontFamily(const QString& family, bool bold, bool italic) override;
+    void setFontSize(double pointSize, bool defaultFont = false) override;
+    void drawText(double x, double y, const QString& text) override;
+    void setTextInvisible(bool invisible) override;
+    EncodedImage encodeImage(const QImage& image, const PDFSettings& settings) const override;
+    void drawEncodedImage(const QRect& bbox, const EncodedImage& image) override;
+    double getAverageCharWidth() const override;
+    double getTextWidth(const QString& text) const override;
+    TextMeasurer* createMeasurer() override;
+    bool createPage(double width, double height, double offsetX, double offsetY, QString& errMsg) override;
+    void finishPage() override;
+    bool finishDocument(QString& errMsg) override;
+
+private:
+    QFontDatabase m_fontDatabase;
+    std::streambuf* m_streamBuffer = nullptr;
+    std::ostream* m_stream = nullptr;
+    PoDoFo::PdfOutputDevice* m_outputDevice = nullptr;
+    PoDoFo::PdfStreamedDocument* m_document = nullptr;
+    PoDoFo::PdfPainter* m_painter = nullptr;
+    const PoDoFo::PdfEncoding* m_encoding = nullptr;
+    QMap<QString, PoDoFo::PdfFont*> m_fontCache;
+    // Per font advances at size 1, by codepoint
+    mutable QHash<const PoDoFo::PdfFont*, QHash<uint, double>> m_advances;
+    QString m_defaultFontFamily;
+    double m_defaultFontSize;
+    bool m_textInvisible = false;
+    QString m_errMsg;
+    double m_pageHeight = 0.0;
+    double m_offsetX = 0.0;
+    double m_offsetY = 0.0;
+    // Serializes the font lookups of measurers
+    QMutex m_metricsMutex;
+
+    class Measurer;
+
+    void openDocument(QIODevice* device, const QString& creator);
+    PoDoFo::PdfFont* getFont(QString family, bool bold, bool italic);
+    // Metrics at size 1 of the font drawn for family, as used by getAverageCharWidth and getTextWidth
+    double unitAverageCharWidth(const QString& family);
+    double unitAdvance(const QString& family, uint codepoint, const QString& character);
+};
+
 #endif // PAINTER_HH
@@ -3,6 +3,7 @@
 #include <poppler-qt5.h>
 #include <cmath>
 #include "Render.hh"
+#include "Trace.hh"
 
 void DisplayRenderer::adjustImage(QImage& image, int brightness, int contrast, bool invert) const {
     if(brightness == 0 && contrast == 0 && !invert) {
@@ -56,6 +57,12 @@ QImage ImageRenderer::render(int page, double resolution) const {
     return reader.read().convertToFormat(QImage::Format_RGB32);
 }
 
+QSize ImageRenderer::renderSize(int page, double resolution) const {
+    QImageReader reader(m_filename);
+    reader.jumpToImage(page - 1);
+    return reader.size() * resolution / 100.0;
+}
+
 PDFRenderer::PDFRenderer(const QString& filename, const QByteArray& password) : DisplayRenderer(filename) {
     m_document = Poppler::Document::load(filename);
     if(m_document) {
@@ -73,10 +80,15 @@ PDFRenderer::~PDFRenderer() {
 }
 
 QImage PDFRenderer::render(int page, double resolution) const {
+    TraceSpan span("PDFRenderer::render");
     if(!m_document) {
         return QImage();
     }
-    m_mutex.lock();
+    {
+        // Waiting for the document shows up as its own span
+        TraceSpan span("PDFRenderer::m_mutex");
+        m_mutex.lock();
+    }
     Poppler::Page* poppage = m_document->page(page - 1);
     m_mutex.unlock();
     QImage image = poppage->renderToImage(resolution, resolution);
@@ -84,6 +96,21 @@ QImage PDFRenderer::render(int page, double resolution) const {
     return image.convertToFormat(QImage::Format_RGB32);
 }
 
+QSize PDFRenderer::renderSize(int page, double resolution) const {
+    if(!m_document) {
+        return QSize();
+    }
+    QMutexLocker locker(&m_mutex);
+    Poppler::Page* poppage = m_document->page(page - 1);
+    if(!poppage) {
+        return QSize();
+    }
+    // Page sizes are in points
+    QSizeF size = poppage->pageSizeF() * resolution / 72.0;
+    delete poppage;
+    return QSize(int(std::ceil(size.width())), int(std::ceil(size.height())));
+}
+
 int PDFRenderer::getNPages() const {
     return m_document ? m_document->numPages() : 1;
 }
@@ -3,6 +3,7 @@
 #include <QByteArray>
 #include <QString>
 #include <QMutex>
+#include <QSize>
 
 class QImage;
 namespace Poppler {
@@ -14,6 +15,8 @@ public:
     DisplayRenderer(const QString& filename) : m_filename(filename) {}
     virtual ~DisplayRenderer() {}
     virtual QImage render(int page, double resolution) const = 0;
+    // Size of the image render would return, without rendering it
+    virtual QSize renderSize(int page, double resolution) const = 0;
     virtual int getNPages() const = 0;
 
     void adjustImage(QImage& image, int brightness, int contrast, bool invert) const;
@@ -26,6 +29,7 @@ class ImageRenderer : public DisplayRenderer {
 public:
     ImageRenderer(const QString& filename) ;
     QImage render(int page, double resolution) const override;
+    QSize renderSize(int page, double resolution) const override;
     int getNPages() const override {
         return m_pageCount;
     }
@@ -38,6 +42,7 @@ public:
     PDFRenderer(const QString& filename, const QByteArray& password);
     ~PDFRenderer();
     QImage render(int page, double resolution) const override;
+    QSize renderSize(int page, double resolution) const override;
     int getNPages() const override;
 
 private:
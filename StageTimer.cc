@@ -0,0 +1,44 @@
+#ifdef WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "StageTimer.hh"
+
+void StageTimer::stop() {
+    if(!m_stats) {
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start);
+    m_stats->record(m_stage, elapsed.count());
+    updatePeakRss(m_stats);
+    m_stats = nullptr;
+}
+
+void StageTimer::updatePeakRss(PipelineStats* stats) {
+    if(!stats) {
+        return;
+    }
+    std::uint64_t peak = 0;
+#ifdef WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        peak = counters.PeakWorkingSetSize;
+    }
+#else
+    // ru_maxrss is in kilobytes on Linux
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+        peak = std::uint64_t(usage.ru_maxrss) * 1024;
+    }
+#endif
+    PipelineStats::raise(stats->m_peakRssBytes, peak);
+}
+
+void StageTimer::finish(PipelineStats* stats) {
+    if(stats) {
+        updatePeakRss(stats);
+        stats->m_finished = true;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef STAGETIMER_HH
+#define STAGETIMER_HH
+
+#include <chrono>
+#include "Interprocess.hh"
+
+/*
+ * Adds the time from construction to destruction (or stop()) to a stage of the shared PipelineStats,
+ * and updates its peak RSS. Does nothing without a stats block, e.g. if FrontUI does not provide one.
+ */
+class StageTimer {
+public:
+    StageTimer(PipelineStats* stats, PIPELINE_STAGE stage)
+        : m_stats(stats), m_stage(stage), m_start(std::chrono::steady_clock::now()) {}
+    ~StageTimer() {
+        stop();
+    }
+    void stop();
+
+    static void updatePeakRss(PipelineStats* stats);
+    // Marks the stats complete, after a last peak RSS update
+    static void finish(PipelineStats* stats);
+    // Calls finish when it goes out of scope, so failed jobs are marked complete as well
+    class Finisher {
+    public:
+        explicit Finisher(PipelineStats* stats) : m_stats(stats) {}
+        ~Finisher() {
+            StageTimer::finish(m_stats);
+        }
+    private:
+        PipelineStats* m_stats;
+    };
+
+private:
+    PipelineStats* m_stats;
+    PIPELINE_STAGE m_stage;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#endif // STAGETIMER_HH
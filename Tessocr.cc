@@ -4,16 +4,31 @@
 #else
 #include <poppler-qt5.h>
 #endif
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <new>
 #include <thread>
+#include <omp.h>
+#include <tesseract/resultiterator.h>
 #include <QTextStream>
 #include <QImageReader>
 #ifdef DEBUG
 #include <iostream>
 #endif
+#include "CompressedStream.hh"
 #include "HOCRDocument.hh"
+#include "HOCRPageBuilder.hh"
+#include "HOCRSnapshot.hh"
+#include "HOCRWordTable.hh"
 #include "Render.hh"
 #include "PaperSize.hh"
+#include "Trace.hh"
+#include "UnicodeScript.hh"
 
 OcrParam::OcrParam(const QString& password, const QString& lang,
                    const QList<int>& pages, const PdfPostProcess& pdfPostProcess)
@@ -31,7 +46,8 @@ struct ReadSessionData {
 };
 
 
-QRectF GetSceneBoundingRect(QPixmap pixmap) {
+// Pages are rendered off the GUI thread, so images are used throughout instead of pixmaps
+QRectF GetSceneBoundingRect(const QImage& pixmap) {
     // We cannot use m_imageItem->sceneBoundingRect() since its pixmap
     // can currently be downscaled and therefore have slightly different
     // proportions.
@@ -60,10 +76,11 @@ TessOcr::TessOcr(const QString& parentOfTessdataDir)
     pdfSettings.overlay = false;
     pdfSettings.detectedFontScaling = 100 / 100.;
     m_pdfSettings = pdfSettings;
+    m_pageBudget.setLimit(qint64(m_exportOptions.m_pageBufferBudgetMB) << 20);
 }
 
 
-QImage GetImage(const QRectF& rect, QPixmap pixmap) {
+QImage GetImage(const QRectF& rect, const QImage& pixmap) {
     QImage image(rect.width(), rect.height(), QImage::Format_RGB32);
     image.fill(Qt::black);
     QPainter painter(&image);
@@ -73,23 +90,18 @@ QImage GetImage(const QRectF& rect, QPixmap pixmap) {
     t.rotate(0);
     t.translate(-0.5 * pixmap.width(), -0.5 * pixmap.height());
     painter.setTransform(t);
-    painter.drawPixmap(0, 0, pixmap);
+    painter.drawImage(0, 0, pixmap);
     return image;
 }
 
-QList<QImage> TessOcr::GetOCRAreas(const QFileInfo& fileinfo, int resolution, int page) {
-
-    DisplayRenderer* render = nullptr;
-    if(fileinfo.completeSuffix().toLower().compare("pdf") == 0) {
-        render = new PDFRenderer(fileinfo.filePath(), "");
-    } else {
-        render = new ImageRenderer(fileinfo.filePath());
-    }
-    QImage image = render->render(page, resolution);
-    QPixmap pixmap = QPixmap::fromImage(image);
-    QRectF rect = GetSceneBoundingRect(pixmap);
-    QImage processedImage = GetImage(rect, pixmap);
-    delete render;
+QList<QImage> TessOcr::GetOCRAreas(const DisplayRenderer& renderer, int resolution, int page) {
+    TraceSpan span("GetOCRAreas");
+    StageTimer renderTimer(m_stats, STAGE_RENDER);
+    QImage image = renderer.render(page, resolution);
+    renderTimer.stop();
+    StageTimer preprocessTimer(m_stats, STAGE_PREPROCESS);
+    QRectF rect = GetSceneBoundingRect(image);
+    QImage processedImage = GetImage(rect, image);
     return QList<QImage>() << processedImage;
 }
 
@@ -101,41 +113,55 @@ QPageSize TessOcr::GetPdfPageSize(const HOCRDocument* hocrdocument) {
     return QPageSize(QSize(pageWidth, pageHeight), "custom", QPageSize::ExactMatch);
 }
 
-void TessOcr::read(const char* hocrtext, PageData pageData) {
-    QDomDocument doc;
-    doc.setContent(QString::fromUtf8(hocrtext));
-
-    QDomElement pageDiv = doc.firstChildElement("div");
-    QMap<QString, QString> attrs = HOCRItem::deserializeAttrGroup(pageDiv.attribute("title"));
+void TessOcr::read(tesseract::TessBaseAPI& tess, const QRect& pageRect, const PageData& pageData) {
+    TraceSpan span("read");
+    QMap<QString, QString> attrs;
     attrs["image"] = QString("'%1'").arg(pageData.filename);
     attrs["ppageno"] = QString::number(pageData.page);
     attrs["rot"] = QString::number(pageData.angle);
     attrs["res"] = QString::number(pageData.resolution);
-    pageDiv.setAttribute("title", HOCRItem::serializeAttrGroup(attrs));
-    m_hocrDocument.addPage(pageDiv, true);
+    StageTimer timer(m_stats, STAGE_HOCR_PARSE);
+    tesseract::ResultIterator* it = tess.GetIterator();
+    m_hocrDocument.addPage(HOCRPageBuilder::build(it, pageRect, attrs, m_hocrDocument.defaultLanguage(), true));
+    delete it;
+    indexPage(m_hocrDocument.pageCount() - 1);
+}
+
+void TessOcr::indexPage(int page) {
+    // With a dictionary, pages are indexed by CorrectWords once their words are final
+    if(m_exportOptions.m_buildTextIndex && !m_dictionary.isOpen()) {
+        const HOCRDocument& document = m_hocrDocument;
+        m_textIndex.addPage(document.page(page));
+    }
 }
 
 PDFSettings& TessOcr::GetPdfSettings() {
     return m_pdfSettings;
 }
 
-// Unicode blocks http://www.fileformat.info/info/unicode/block/index.htm
+// Whether a word is set off by spaces, judged by its first character, or its last one if it precedes the next word
 bool spacedWord(const QString& text, bool prevWord) {
-    short unicode = (prevWord ? text.at(text.size() - 1) : text.at(0)).unicode();
-    // CJK Word
-    std::vector<std::pair<int, int>> cjkWordRange{{0x2480, 0x303f}, {0x31c0, 0x9fff}
-        , {0xf900, 0xfaff}, {0xfe30, 0xfe4f}, {0x20000, 0x2fa1f}};
-    for(int i = 0; i < cjkWordRange.size(); i++) {
-        if(unicode < cjkWordRange[i].first) {
-            return true;
-        } else if(unicode >= cjkWordRange[i].first && unicode <= cjkWordRange[i].second) {
-            return false;
+    if(text.isEmpty()) {
+        return true;
+    }
+    uint codepoint;
+    if(prevWord) {
+        int i = text.size() - 1;
+        codepoint = text[i].unicode();
+        if(text[i].isLowSurrogate() && i > 0 && text[i - 1].isHighSurrogate()) {
+            codepoint = QChar::surrogateToUcs4(text[i - 1], text[i]);
+        }
+    } else {
+        codepoint = text[0].unicode();
+        if(text[0].isHighSurrogate() && text.size() > 1 && text[1].isLowSurrogate()) {
+            codepoint = QChar::surrogateToUcs4(text[0], text[1]);
         }
     }
-    return true;
+    return !UnicodeScript::isUnspaced(char32_t(codepoint));
 }
 
-void TessOcr::printChildren(PDFPainter& painter, const HOCRItem* item, const PDFSettings& pdfSettings, double px2pu, double imgScale) {
+void TessOcr::layoutChildren(TextMeasurer& measurer, const HOCRItem* item, const PDFSettings& pdfSettings, double px2pu,
+                             double defaultFontSize, QVector<GlyphRun>& runs) {
     if(!item->isEnabled()) {
         return;
     }
@@ -158,28 +184,30 @@ void TessOcr::printChildren(PDFPainter& painter, const HOCRItem* item, const PDF
                     continue;
                 }
                 QRect wordRect = wordItem->bbox();
-                painter.setFontFamily(pdfSettings.fontFamily.isEmpty() ? wordItem->fontFamily() : pdfSettings.fontFamily, false, false);
-                if(pdfSettings.fontSize == -1) {
-                    painter.setFontSize(wordItem->fontSize() * pdfSettings.detectedFontScaling);
-                }
+                GlyphRun run;
+                run.fontFamily = pdfSettings.fontFamily.isEmpty() ? wordItem->fontFamily() : pdfSettings.fontFamily;
+                run.fontSize = pdfSettings.fontSize == -1 ? wordItem->fontSize() * pdfSettings.detectedFontScaling : defaultFontSize;
+                measurer.setFont(run.fontFamily, run.fontSize);
 
                 prevWordRight = wordRect.right();
-                QString text = wordItem->text();
-                currentSpacedWord = spacedWord(text, false);
+                run.text = wordItem->text();
+                currentSpacedWord = spacedWord(run.text, false);
                 // If distance from previous word is large, keep the space
-                if(wordRect.x() - prevWordRight > pdfSettings.preserveSpaceWidth * painter.getAverageCharWidth() / px2pu) {
+                if(wordRect.x() - prevWordRight > pdfSettings.preserveSpaceWidth * measurer.averageCharWidth() / px2pu) {
                     x = wordRect.x();
                 } else {
                     //need space
                     if(currentSpacedWord && prevSpacedWord ) {
-                        x += painter.getTextWidth(" ") / px2pu;
+                        x += measurer.textWidth(" ") / px2pu;
                     }
                 }
 
                 double wordBaseline = (x - itemRect.x()) * baseline.first + baseline.second;
-                painter.drawText(x * px2pu, (y + wordBaseline) * px2pu, text);
-                x += painter.getTextWidth(text) / px2pu;
-                prevSpacedWord = spacedWord(text, true);
+                run.x = x * px2pu;
+                run.y = (y + wordBaseline) * px2pu;
+                x += measurer.textWidth(run.text) / px2pu;
+                prevSpacedWord = spacedWord(run.text, true);
+                runs.append(run);
             }
         }
     } else if(itemClass == "ocr_line" && !pdfSettings.uniformizeLineSpacing) {
@@ -190,84 +218,232 @@ void TessOcr::printChildren(PDFPainter& painter, const HOCRItem* item, const PDF
                 continue;
             }
             QRect wordRect = wordItem->bbox();
-            //painter.setFontFamily(pdfSettings.fontFamily.isEmpty() ? wordItem->fontFamily() : pdfSettings.fontFamily, wordItem->fontBold(), wordItem->fontItalic());
-            painter.setFontFamily(pdfSettings.fontFamily.isEmpty() ? wordItem->fontFamily() : pdfSettings.fontFamily, false, false);
-            if(pdfSettings.fontSize == -1) {
-                painter.setFontSize(wordItem->fontSize() * pdfSettings.detectedFontScaling);
-            }
+            GlyphRun run;
+            run.fontFamily = pdfSettings.fontFamily.isEmpty() ? wordItem->fontFamily() : pdfSettings.fontFamily;
+            run.fontSize = pdfSettings.fontSize == -1 ? wordItem->fontSize() * pdfSettings.detectedFontScaling : defaultFontSize;
             double y = itemRect.bottom() + (wordRect.center().x() - itemRect.x()) * baseline.first + baseline.second;
-            painter.drawText(wordRect.x() * px2pu, y * px2pu, wordItem->text());
+            run.x = wordRect.x() * px2pu;
+            run.y = y * px2pu;
+            run.text = wordItem->text();
+            runs.append(run);
         }
     } else if(itemClass == "ocr_graphic" && !pdfSettings.overlay) {
-        /*QRect scaledItemRect(itemRect.left() * imgScale, itemRect.top() * imgScale, itemRect.width() * imgScale, itemRect.height() * imgScale);
-        QRect printRect(itemRect.left() * px2pu, itemRect.top() * px2pu, itemRect.width() * px2pu, itemRect.height() * px2pu);
-        QImage selection;
-        QMetaObject::invokeMethod(this, "getSelection", QThread::currentThread() == qApp->thread() ? Qt::DirectConnection : Qt::BlockingQueuedConnection, Q_RETURN_ARG(QImage, selection), Q_ARG(QRect, scaledItemRect));
-        painter.drawImage(printRect, selection, pdfSettings);*/
+        // Graphics are only reproduced by the page image layer
     } else {
         for(int i = 0, n = item->children().size(); i < n; ++i) {
-            printChildren(painter, item->children()[i], pdfSettings, px2pu, imgScale);
+            layoutChildren(measurer, item->children()[i], pdfSettings, px2pu, defaultFontSize, runs);
         }
     }
 }
 
+static void paintRuns(PDFPainter& painter, const QVector<GlyphRun>& runs) {
+    for(const GlyphRun& run : runs) {
+        painter.setFontFamily(run.fontFamily, false, false);
+        painter.setFontSize(run.fontSize);
+        painter.drawText(run.x, run.y, run.text);
+    }
+}
+
+// Picks the encoding of a rendered page from a sample of its pixels: CCITT G4 for black and
+// white pages (anti-aliased edges included), JPEG in gray or color otherwise
+static PDFSettings pageImageSettings(const QImage& image, PDFSettings settings) {
+    const int step = 3;
+    qint64 samples = 0, midTones = 0, colored = 0;
+    for(int y = 0; y < image.height(); y += step) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for(int x = 0; x < image.width(); x += step) {
+            int red = qRed(line[x]), green = qGreen(line[x]), blue = qBlue(line[x]);
+            int gray = qGray(line[x]);
+            if(std::max(red, std::max(green, blue)) - std::min(red, std::min(green, blue)) > 32) {
+                ++colored;
+            } else if(gray > 64 && gray < 192) {
+                ++midTones;
+            }
+            ++samples;
+        }
+    }
+    if(colored * 100 > samples) {
+        settings.colorFormat = QImage::Format_RGB888;
+        settings.conversionFlags = Qt::AutoColor;
+        settings.compression = PDFSettings::CompressJpeg;
+    } else if(midTones * 20 > samples) {
+        settings.colorFormat = QImage::Format_Grayscale8;
+        settings.conversionFlags = Qt::AutoColor;
+        settings.compression = PDFSettings::CompressJpeg;
+    } else {
+        settings.colorFormat = QImage::Format_Mono;
+        settings.conversionFlags = Qt::ThresholdDither;
+        settings.compression = PDFSettings::CompressFax4;
+    }
+    settings.compressionQuality = 75;
+    return settings;
+}
 
+// Bytes of a page image as rendered, in RGB32
+static qint64 pageImageBytes(const DisplayRenderer& renderer, int page, int resolution) {
+    QSize size = renderer.renderSize(page, resolution);
+    return qint64(size.width()) * size.height() * 4;
+}
 
+static EncodedImage encodePageImage(const PDFPainter& painter, const HOCRPage* page, const DisplayRenderer* renderer,
+                                    const PDFSettings& pdfSettings, int outputDpi, PageBufferBudget& budget, PipelineStats* stats) {
+    TraceSpan span("encodePageImage");
+    // The renderer's output, its RGB32 conversion and the scaled or converted copy
+    PageBufferBudget::Reservation reservation(budget, 3 * pageImageBytes(*renderer, page->pageNr(), page->resolution()));
+    StageTimer renderTimer(stats, STAGE_RENDER);
+    QImage image = renderer->render(page->pageNr(), page->resolution());
+    renderTimer.stop();
+    if(image.isNull()) {
+        return EncodedImage();
+    }
+    PDFSettings imageSettings = pageImageSettings(image, pdfSettings);
+    // Bitonal pages keep the OCR resolution, G4 stays small there and the text stays sharp
+    if(imageSettings.compression != PDFSettings::CompressFax4 && outputDpi < page->resolution()) {
+        image = image.scaled(image.size() * (double(outputDpi) / page->resolution()), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return painter.encodeImage(image, imageSettings);
+}
 
+// Everything the writer needs to emit a page, prepared ahead of it
+struct PageLayout {
+    double width = 0.0;
+    double height = 0.0;
+    double offsetX = 0.0;
+    double offsetY = 0.0;
+    QRect imageRect;
+    EncodedImage image;
+    QVector<GlyphRun> runs;
+};
 
 ERROR_CODE TessOcr::ExportPdf(const QString& outPath, ProgressInfo* interProcessInfo) {
+    TraceSpan span("ExportPdf");
     PDFPainter* painter = nullptr;
-    int pageCount = m_hocrDocument.pageCount();
+    // Read only, so that lazily built pages may be dropped again
+    const HOCRDocument& document = m_hocrDocument;
+    int pageCount = document.pageCount();
     QFont defaultFont = QFont("Source Han Sans TW");
 
     defaultFont.setPointSize(0);
-    painter = new QPrinterPDFPainter(outPath, "转转OCR", defaultFont);
+    // QPrinter writes the part file itself, PoDoFo goes through the writer thread
+    OutputFile* output = nullptr;
+    if(m_exportOptions.m_pdfBackend == PDF_BACKEND::PDF_BACKEND_QPRINTER) {
+        painter = new QPrinterPDFPainter(OutputFile::partPath(outPath), "转转OCR", defaultFont);
+    } else {
+        output = new OutputFile(outPath);
+        if(!output->open(QIODevice::WriteOnly)) {
+            delete output;
+            interProcessInfo->m_errCode = ERROR_CODE::FAIL_OPEN_FILE;
+            return ERROR_CODE::FAIL_OPEN_FILE;
+        }
+        painter = new PoDoFoPDFPainter(output, "转转OCR", defaultFont);
+    }
 
     PDFSettings pdfSettings = getPdfSettings();
-    int outputDpi = 100;
+    int outputDpi = 150;
+    const double defaultFontSize = 30;
+    painter->setFontSize(defaultFontSize, true);
+    // Sandwich mode: the source page image with the recognized text invisible on top of it
+    bool imageLayer = m_exportOptions.m_pdfImageLayer;
+    pdfSettings.overlay = imageLayer;
+    painter->setTextInvisible(imageLayer);
+    QMap<QString, DisplayRenderer*> renderers;
 
     QString paperSize = m_infileType == FILE_TYPE::PDF ? "source" : "A4";
-    double pageWidth, pageHeight;
+    double paperWidth = 0.0, paperHeight = 0.0;
 
     if(paperSize != "source") {
         auto inchSize = PaperSize::getSize(PaperSize::inch, paperSize.toStdString(), false);
-        pageWidth = inchSize.width * 72.0;
-        pageHeight = inchSize.height * 72.0;
+        paperWidth = inchSize.width * 72.0;
+        paperHeight = inchSize.height * 72.0;
     }
 
+    // Pages are laid out, and their images encoded, a window ahead of the writer, two pages per thread.
+    // The writer then only replays the glyph runs.
+    const int window = 2 * omp_get_max_threads();
     QString errMsg;
-    for(int i = 0; i < pageCount; ++i) {
-        const HOCRPage* page = m_hocrDocument.page(i);
-        if(page->isEnabled()) {
-
-            QRect bbox = page->bbox();
-            int sourceDpi = page->resolution();
-
-            double sourceSizeToOutSize;
-
-            if( paperSize != "source") {
-                sourceSizeToOutSize = pageWidth / (72.0 / sourceDpi * bbox.width());
-            } else {
-                sourceSizeToOutSize = 1;
+    for(int first = 0; first < pageCount; first += window) {
+        int last = std::min(first + window, pageCount);
+        // The trees of the window are built here, serially, and kept while the threads work on them
+        HOCRDocument::PagePins pins(document, first, last);
+        QVector<const DisplayRenderer*> pageRenderers(last - first, nullptr);
+        for(int i = first; i < last; ++i) {
+            const HOCRPage* page = document.page(i);
+            if(!imageLayer || !page->isEnabled()) {
+                continue;
+            }
+            DisplayRenderer*& renderer = renderers[page->sourceFile()];
+            if(!renderer) {
+                if(QFileInfo(page->sourceFile()).suffix().toLower() == "pdf") {
+                    StageTimer timer(m_stats, STAGE_POPPLER_LOAD);
+                    renderer = new PDFRenderer(page->sourceFile(), "");
+                } else {
+                    renderer = new ImageRenderer(page->sourceFile());
+                }
             }
-            painter->setFontSize(30, true);
-            double px2pt = (72.0 / sourceDpi) * sourceSizeToOutSize;;
-            double imgScale = double(outputDpi) / sourceDpi;
-            pdfSettings.detectedFontScaling *= sourceSizeToOutSize;
-            if(paperSize == "source") {
-                pageWidth = bbox.width() * px2pt;
-                pageHeight = bbox.height() * px2pt;
+            pageRenderers[i - first] = renderer;
+        }
+        QVector<PageLayout> layouts(last - first);
+        PageLayout* out = layouts.data();
+        #pragma omp parallel
+        {
+            TextMeasurer* measurer = painter->createMeasurer();
+            #pragma omp for schedule(dynamic)
+            for(int i = first; i < last; ++i) {
+                const HOCRPage* page = document.page(i);
+                if(!page->isEnabled()) {
+                    continue;
+                }
+                PageLayout& layout = out[i - first];
+                QRect bbox = page->bbox();
+                int sourceDpi = page->resolution();
+                double sourceSizeToOutSize = paperSize != "source" ? paperWidth / (72.0 / sourceDpi * bbox.width()) : 1;
+                double px2pt = (72.0 / sourceDpi) * sourceSizeToOutSize;
+                PDFSettings pageSettings = pdfSettings;
+                pageSettings.detectedFontScaling *= sourceSizeToOutSize;
+                layout.width = paperSize != "source" ? paperWidth : bbox.width() * px2pt;
+                layout.height = paperSize != "source" ? paperHeight : bbox.height() * px2pt;
+                layout.offsetX = 0.5 * (layout.width - bbox.width() * px2pt);
+                layout.offsetY = 0.5 * (layout.height - bbox.height() * px2pt);
+                if(pageRenderers[i - first]) {
+                    layout.imageRect = QRect(qRound(bbox.x() * px2pt), qRound(bbox.y() * px2pt), qRound(bbox.width() * px2pt), qRound(bbox.height() * px2pt));
+                    layout.image = encodePageImage(*painter, page, pageRenderers[i - first], pdfSettings, outputDpi, m_pageBudget, m_stats);
+                }
+                TraceSpan layoutSpan("layoutChildren");
+                layoutChildren(*measurer, page, pageSettings, px2pt, defaultFontSize, layout.runs);
+            }
+            delete measurer;
+        }
+        for(int i = first; i < last; ++i) {
+            if(!document.page(i)->isEnabled()) {
+                continue;
             }
-            double offsetX = 0.5 * (pageWidth - bbox.width() * px2pt);
-            double offsetY = 0.5 * (pageHeight - bbox.height() * px2pt);
-            if(!painter->createPage(pageWidth, pageHeight, offsetX, offsetY, errMsg)) {
+            const PageLayout& layout = layouts[i - first];
+            TraceSpan writeSpan("writePage");
+            if(!painter->createPage(layout.width, layout.height, layout.offsetX, layout.offsetY, errMsg)) {
+                qDeleteAll(renderers);
+                delete painter;
+                delete output;
+                QFile::remove(OutputFile::partPath(outPath));
+                interProcessInfo->m_errCode = ERROR_CODE::FAIL_CREATE_PAGE;
                 return ERROR_CODE::FAIL_CREATE_PAGE;
             }
-            printChildren(*painter, page, pdfSettings, px2pt, imgScale);
+            if(!layout.image.isNull()) {
+                painter->drawEncodedImage(layout.imageRect, layout.image);
+            }
+            paintRuns(*painter, layout.runs);
             painter->finishPage();
         }
     }
-    painter->finishDocument(errMsg);
+    qDeleteAll(renderers);
+    bool finished = painter->finishDocument(errMsg);
+    delete painter;
+    finished = finished && (output ? output->commit() : OutputFile::publish(outPath));
+    delete output;
+    if(!finished) {
+        QFile::remove(OutputFile::partPath(outPath));
+        interProcessInfo->m_errCode = ERROR_CODE::FAIL_OPEN_FILE;
+        return ERROR_CODE::FAIL_OPEN_FILE;
+    }
     return ExportResult(outPath, interProcessInfo);
 }
 
@@ -281,52 +457,306 @@ ERROR_CODE TessOcr::ParseXML(const QString& inPath, ProgressInfo* interProcessIn
         interProcessInfo->m_errCode = ERROR_CODE::NOT_EXIST_FILE;
         return ERROR_CODE::NOT_EXIST_FILE;
     }
-    QTextStream ts(&file);
-    QString xmlString = ts.readAll();
     file.close();
 
-    QDomDocument doc;
-    if(!doc.setContent(xmlString)) {
+    // Page trees are only built when an export needs them
+    StageTimer timer(m_stats, STAGE_HOCR_PARSE);
+    int firstPage = m_hocrDocument.pageCount();
+    if(!m_hocrDocument.addPages(inPath, true)) {
         interProcessInfo->m_errCode = ERROR_CODE::FAIL_PARSE_XML;
         return ERROR_CODE::FAIL_PARSE_XML;
     }
-    QDomElement pageDiv = doc.documentElement().firstChildElement("div");
-    if(pageDiv.isNull()) {
+    if(m_hocrDocument.pageCount() == firstPage) {
         interProcessInfo->m_errCode = ERROR_CODE::NO_PAGE;
         return ERROR_CODE::NO_PAGE;
     }
+    for(int i = firstPage, n = m_hocrDocument.pageCount(); i < n; ++i) {
+        indexPage(i);
+    }
+    if(m_stats) {
+        m_stats->m_pagesRead += m_hocrDocument.pageCount() - firstPage;
+    }
+    return ERROR_CODE::SUCCESS;
+}
 
-    while (!pageDiv.isNull()) {
-        //save first object
-        QString str;
-        QTextStream stream(&str);
-        QDomNode node = pageDiv;
-        node.save(stream, QDomNode::CDATASectionNode /* = 4 */);
-        //store document
-        QDomDocument temp;
-        temp.setContent(str);
-        m_hocrDocument.addPage(temp.documentElement(), true);
-        pageDiv = pageDiv.nextSiblingElement("div");
+ERROR_CODE TessOcr::ParseSnapshot(const QString& inPath, ProgressInfo* interProcessInfo) {
+    ERROR_CODE fileStatus = CheckFileStatus(QFileInfo(inPath), interProcessInfo);
+    if(fileStatus != ERROR_CODE::SUCCESS) {
+        return fileStatus;
+    }
+    StageTimer timer(m_stats, STAGE_HOCR_PARSE);
+    HOCRSnapshot snapshot;
+    if(!snapshot.open(inPath)) {
+        interProcessInfo->m_errCode = ERROR_CODE::FAIL_PARSE_XML;
+        return ERROR_CODE::FAIL_PARSE_XML;
+    }
+    if(snapshot.pageCount() == 0) {
+        interProcessInfo->m_errCode = ERROR_CODE::NO_PAGE;
+        return ERROR_CODE::NO_PAGE;
+    }
+    for(int i = 0, n = snapshot.pageCount(); i < n; ++i) {
+        HOCRPage* page = snapshot.readPage(i);
+        if(!page) {
+            interProcessInfo->m_errCode = ERROR_CODE::FAIL_PARSE_XML;
+            return ERROR_CODE::FAIL_PARSE_XML;
+        }
+        m_hocrDocument.addPage(page);
+        indexPage(m_hocrDocument.pageCount() - 1);
+    }
+    if(m_stats) {
+        m_stats->m_pagesRead += snapshot.pageCount();
+    }
+    return ERROR_CODE::SUCCESS;
+}
+
+bool TessOcr::LoadDictionary(const QString& path) {
+    QString compiledPath = path;
+    if(QFileInfo(path).suffix().toLower() != "dawg") {
+        compiledPath = path + ".dawg";
+        QFileInfo compiled(compiledPath);
+        if((!compiled.exists() || compiled.lastModified() < QFileInfo(path).lastModified()) && !WordDictionary::build(path, compiledPath)) {
+            return false;
+        }
+    }
+    return m_dictionary.open(compiledPath);
+}
+
+// The corrected word, or an empty string if the word is kept. Only the letters between leading and
+// trailing punctuation are looked up, and at most a third of them may change.
+static QString correctedWord(const WordDictionary& dictionary, const QString& text, int maxDistance) {
+    QString prefix, suffix;
+    QString word = HOCRItem::trimmedWord(text, &prefix, &suffix);
+    maxDistance = std::min(maxDistance, word.size() / 3);
+    if(maxDistance <= 0 || std::any_of(word.begin(), word.end(), [](const QChar& c) { return c.isDigit(); }) || dictionary.contains(word)) {
+        return QString();
+    }
+    QString corrected = dictionary.nearest(word, maxDistance);
+    if(corrected.isEmpty()) {
+        return QString();
+    }
+    // The dictionary is case folded, the capitalization of the recognized word is kept
+    if(word.size() > 1 && word == word.toUpper() && word != word.toLower()) {
+        corrected = corrected.toUpper();
+    } else if(word[0].isUpper()) {
+        corrected[0] = corrected[0].toUpper();
+    }
+    return prefix + corrected + suffix;
+}
+
+// Words are numbered in document order, applyCorrections walks the page the same way
+void TessOcr::collectCorrections(const HOCRItem* item, int& word, QVector<QPair<int, QString>>& corrections) const {
+    if(item->itemClass() == "ocrx_word") {
+        QMap<QString, QString> titleAttrs = item->getTitleAttributes();
+        if(item->isEnabled() && titleAttrs.contains("x_wconf") && titleAttrs["x_wconf"].toInt() < m_exportOptions.m_correctionConfidence) {
+            QString corrected = correctedWord(m_dictionary, item->text(), m_exportOptions.m_correctionDistance);
+            if(!corrected.isEmpty()) {
+                corrections.append(qMakePair(word, corrected));
+            }
+        }
+        ++word;
+        return;
+    }
+    for(const HOCRItem* child : item->children()) {
+        collectCorrections(child, word, corrections);
+    }
+}
+
+void TessOcr::applyCorrections(HOCRItem* item, int& word, const QVector<QPair<int, QString>>& corrections, int& next) const {
+    if(item->itemClass() == "ocrx_word") {
+        if(next < corrections.size() && corrections[next].first == word) {
+            item->setText(corrections[next++].second);
+        }
+        ++word;
+        return;
+    }
+    for(HOCRItem* child : item->children()) {
+        applyCorrections(child, word, corrections, next);
+    }
+}
+
+ERROR_CODE TessOcr::CorrectWords(ProgressInfo* interProcessInfo) {
+    if(!m_dictionary.isOpen()) {
+        return ERROR_CODE::SUCCESS;
+    }
+    const HOCRDocument& document = m_hocrDocument;
+    // Pages are looked up in parallel through the read only view, which leaves lazily read pages
+    // evictable; only pages with corrections are fetched for writing
+    const int window = 2 * omp_get_max_threads();
+    for(int start = 0, pageCount = document.pageCount(); start < pageCount; start += window) {
+        int end = std::min(start + window, pageCount);
+        HOCRDocument::PagePins pins(document, start, end);
+        QVector<QVector<QPair<int, QString>>> corrections(end - start);
+        #pragma omp parallel for schedule(dynamic)
+        for(int i = start; i < end; ++i) {
+            int word = 0;
+            collectCorrections(document.page(i), word, corrections[i - start]);
+        }
+        for(int i = start; i < end; ++i) {
+            if(!corrections[i - start].isEmpty()) {
+                int word = 0, next = 0;
+                applyCorrections(m_hocrDocument.page(i), word, corrections[i - start], next);
+            }
+            if(m_exportOptions.m_buildTextIndex) {
+                m_textIndex.addPage(document.page(i));
+            }
+        }
+        if(interProcessInfo->m_errCode == ERROR_CODE::CANCLED_BY_USER) {
+            return ERROR_CODE::CANCLED_BY_USER;
+        }
     }
     return ERROR_CODE::SUCCESS;
 }
 
 ERROR_CODE TessOcr::ExporteXML(const QString& outPath, ProgressInfo* interProcessInfo) {
-    std::ofstream ofs(outPath.toStdString());
-    ofs << m_hocrDocument.toHTML().toStdString();
+    TraceSpan span("ExporteXML");
+    // Unmodified pages are copied from the file they were read from. It may be outPath itself,
+    // which is only replaced once the part file is complete.
+    OutputFile file(outPath);
+    // Compressed on the fly if the path ends in .gz or .zst
+    CompressingDevice device(&file, CompressedStream::formatForPath(outPath));
+    bool ok = file.open(QIODevice::WriteOnly) && device.open(QIODevice::WriteOnly) && m_hocrDocument.writeHTML(&device);
+    ok = device.finish() && ok;
+    ok = ok && file.commit();
+    if(!ok) {
+        interProcessInfo->m_errCode = ERROR_CODE::FAIL_OPEN_FILE;
+        return ERROR_CODE::FAIL_OPEN_FILE;
+    }
     return ExportResult(outPath, interProcessInfo);
 }
 
 ERROR_CODE TessOcr::ExportTxt(const QString& outPath, ProgressInfo* interProcessInfo) {
-    std::ofstream ofs(outPath.toStdString());
-    ofs << m_utf8Text.toStdString();
+    TraceSpan span("ExportTxt");
+    // The pages were already streamed out by recognize, other inputs derive the text from the HOCR tree
+    if(!m_txtFile) {
+        m_txtOutPath = outPath;
+        if(openTxtStream()) {
+            const HOCRDocument& document = m_hocrDocument;
+            for(int i = 0, n = document.pageCount(); i < n; ++i) {
+                const HOCRPage* page = document.page(i);
+                if(page->isEnabled()) {
+                    std::string text;
+                    collectText(page, text);
+                    writeTxtPage(text.c_str());
+                }
+            }
+        }
+    }
+    bool ok = m_txtFile && m_txtFile->commit();
+    m_txtFile.reset();
+    if(!ok) {
+        interProcessInfo->m_errCode = ERROR_CODE::FAIL_OPEN_FILE;
+        return ERROR_CODE::FAIL_OPEN_FILE;
+    }
+    return ExportResult(outPath, interProcessInfo);
+}
+
+// Same layout as Tesseract's GetUTF8Text: one line per text line, an empty line after each paragraph
+void TessOcr::collectText(const HOCRItem* item, std::string& text) {
+    if(!item->isEnabled()) {
+        return;
+    }
+    QString itemClass = item->itemClass();
+    if(HOCRItem::isLineClass(itemClass)) {
+        QString line;
+        bool prevSpacedWord = false;
+        for(const HOCRItem* wordItem : item->children()) {
+            if(!wordItem->isEnabled() || wordItem->text().isEmpty()) {
+                continue;
+            }
+            QString word = wordItem->text();
+            if(!line.isEmpty() && prevSpacedWord && spacedWord(word, false)) {
+                line.append(' ');
+            }
+            line.append(word);
+            prevSpacedWord = spacedWord(word, true);
+        }
+        text.append(line.toStdString());
+        text.append("\n");
+        return;
+    }
+    for(const HOCRItem* child : item->children()) {
+        collectText(child, text);
+    }
+    if(itemClass == "ocr_par") {
+        text.append("\n");
+    }
+}
+
+bool TessOcr::openTxtStream() {
+    m_txtFile.reset(new OutputFile(m_txtOutPath));
+    m_txtPages = 0;
+    if(!m_txtFile->open(QIODevice::WriteOnly)) {
+        m_txtFile.reset();
+        return false;
+    }
+    return true;
+}
+
+void TessOcr::writeTxtPage(const char* text) {
+    if(m_exportOptions.m_txtPageSeparator && m_txtPages > 0) {
+        m_txtFile->putChar('\f');
+    }
+    // Tesseract already returns UTF-8, it is written as is
+    m_txtFile->write(text, std::strlen(text));
+    // Whole pages become visible to readers tailing the part file
+    m_txtFile->flush();
+    ++m_txtPages;
+}
+
+ERROR_CODE TessOcr::ExportSnapshot(const QString& outPath, ProgressInfo* interProcessInfo) {
+    TraceSpan span("ExportSnapshot");
+    OutputFile file(outPath);
+    if(!file.open(QIODevice::WriteOnly) || !HOCRSnapshot::write(m_hocrDocument, &file) || !file.commit()) {
+        interProcessInfo->m_errCode = ERROR_CODE::FAIL_OPEN_FILE;
+        return ERROR_CODE::FAIL_OPEN_FILE;
+    }
+    return ExportResult(outPath, interProcessInfo);
+}
+
+ERROR_CODE TessOcr::ExportArrow(const QString& outPath, ProgressInfo* interProcessInfo) {
+    TraceSpan span("ExportArrow");
+    OutputFile file(outPath);
+    HOCRWordTable table;
+    const HOCRDocument& document = m_hocrDocument;
+    bool ok = file.open(QIODevice::WriteOnly) && table.open(&file);
+    for(int i = 0, n = document.pageCount(); ok && i < n; ++i) {
+        ok = table.addPage(document.page(i));
+    }
+    ok = table.close() && ok;
+    ok = ok && file.commit();
+    if(!ok) {
+        interProcessInfo->m_errCode = ERROR_CODE::FAIL_OPEN_FILE;
+        return ERROR_CODE::FAIL_OPEN_FILE;
+    }
     return ExportResult(outPath, interProcessInfo);
 }
 
 ERROR_CODE TessOcr::ExportResult(const QString& outPath, ProgressInfo* interProgressInfo) {
+    if(m_exportOptions.m_buildTextIndex && QFileInfo(outPath).exists()) {
+        OutputFile indexFile(outPath + ".idx");
+        if(!indexFile.open(QIODevice::WriteOnly) || !m_textIndex.write(&indexFile) || !indexFile.commit()) {
+            interProgressInfo->m_errCode = ERROR_CODE::FAIL_OPEN_FILE;
+            return ERROR_CODE::FAIL_OPEN_FILE;
+        }
+    }
+    if(!QFileInfo(outPath).exists()) {
+        interProgressInfo->m_errCode = ERROR_CODE::NOT_EXIST_FILE;
+        return ERROR_CODE::NOT_EXIST_FILE;
+    }
+    if(m_stats) {
+        m_stats->m_bytesWritten += QFileInfo(outPath).size();
+        if(m_exportOptions.m_buildTextIndex) {
+            m_stats->m_bytesWritten += QFileInfo(outPath + ".idx").size();
+        }
+    }
+    // The job is only reported finished once the last target has been written
+    if(--m_pendingExports > 0) {
+        interProgressInfo->m_progress = 90 + 10 * (m_outfileTypes.size() - m_pendingExports) / m_outfileTypes.size();
+        return ERROR_CODE::SUCCESS;
+    }
     interProgressInfo->m_progress = 100;
-    interProgressInfo->m_errCode = QFileInfo(outPath).exists() ? ERROR_CODE::SUCCESS : ERROR_CODE::NOT_EXIST_FILE;
-    return interProgressInfo->m_errCode;
+    interProgressInfo->m_errCode = ERROR_CODE::SUCCESS;
+    return ERROR_CODE::SUCCESS;
 }
 
 ERROR_CODE TessOcr::CheckFileStatus(const QFileInfo& fileInfo, ProgressInfo* interProcessInfo, const OcrParam& pdfOcrParam) {
@@ -343,7 +773,9 @@ ERROR_CODE TessOcr::CheckFileStatus(const QFileInfo& fileInfo, ProgressInfo* int
         return ERROR_CODE::SUCCESS;
     }
 
-    Poppler::Document* document = Poppler::Document::load(fileInfo.absoluteFilePath());;
+    StageTimer timer(m_stats, STAGE_POPPLER_LOAD);
+    Poppler::Document* document = Poppler::Document::load(fileInfo.absoluteFilePath());
+    timer.stop();
     if(!document) {
         interProcessInfo->m_errCode = ERROR_CODE::NOT_LOAD_FILE; //cant not load file
         return ERROR_CODE::NOT_LOAD_FILE;
@@ -356,7 +788,139 @@ ERROR_CODE TessOcr::CheckFileStatus(const QFileInfo& fileInfo, ProgressInfo* int
     return ERROR_CODE::SUCCESS;
 }
 
+/*
+ * Renders pages on a thread of its own, at most ahead pages ahead of the engine and only as far as
+ * the page buffer budget allows, or each page when next() asks for it if ahead is 0. A page holds its
+ * share of the budget from before it is rendered until the consumer releases it, which has to happen
+ * before the next call to next().
+ */
+class PageRenderQueue {
+public:
+    // The renderer's output, its RGB32 conversion and the preprocessed copy are alive while rendering,
+    // the preprocessed copy and Tesseract's own copy of it until the page is done with
+    static const int RenderCopies = 3;
+    static const int HeldCopies = 2;
+
+    PageRenderQueue(const QList<int>& pages, int ahead, PageBufferBudget& budget, std::function<qint64(int)> pageBytes,
+                    std::function<PageData(int)> renderPage)
+        : m_pages(pages), m_ahead(ahead), m_budget(budget), m_pageBytes(pageBytes), m_renderPage(renderPage) {
+        if(m_ahead > 0) {
+            m_thread = std::thread(&PageRenderQueue::run, this);
+        }
+    }
+    ~PageRenderQueue() {
+        if(!m_thread.joinable()) {
+            return;
+        }
+        std::deque<std::pair<PageData, qint64>> pending;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+            pending.swap(m_ready);
+        }
+        m_condition.notify_all();
+        // Lets a render waiting for the budget through, it sees m_stop afterwards
+        for(const auto& page : pending) {
+            m_budget.release(page.second);
+        }
+        m_thread.join();
+    }
+    // The next page in order and the bytes to release once it is done with; false after the last one
+    // or once a page could not be allocated
+    bool next(PageData& page, qint64& bytes) {
+        if(m_ahead == 0) {
+            if(m_failed || m_next >= m_pages.size()) {
+                return false;
+            }
+            int pageNr = m_pages[m_next++];
+            qint64 imageBytes = m_pageBytes(pageNr);
+            m_budget.acquire(RenderCopies * imageBytes);
+            bytes = HeldCopies * imageBytes;
+            return render(pageNr, imageBytes, page);
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return !m_ready.empty() || m_done; });
+        if(m_ready.empty()) {
+            return false;
+        }
+        page = m_ready.front().first;
+        bytes = m_ready.front().second;
+        m_ready.pop_front();
+        m_condition.notify_all();
+        return true;
+    }
+    // Whether a page ran out of memory, the pages after it are not rendered
+    bool failed() const {
+        return m_failed;
+    }
+
+private:
+    QList<int> m_pages;
+    int m_ahead;
+    int m_next = 0;
+    PageBufferBudget& m_budget;
+    std::function<qint64(int)> m_pageBytes;
+    std::function<PageData(int)> m_renderPage;
+    std::atomic<bool> m_failed{false};
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::pair<PageData, qint64>> m_ready;
+    bool m_stop = false;
+    bool m_done = false;
+
+    // Renders a page whose RenderCopies share is acquired, and keeps only the HeldCopies share of it
+    bool render(int page, qint64 imageBytes, PageData& pageData) {
+        try {
+            pageData = m_renderPage(page);
+        } catch(const std::bad_alloc&) {
+            // Escaping the render thread would terminate the process
+            m_budget.release(RenderCopies * imageBytes);
+            m_failed = true;
+            return false;
+        }
+        m_budget.release((RenderCopies - HeldCopies) * imageBytes);
+        return true;
+    }
+
+    void run() {
+        for(int page : m_pages) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this] { return m_stop || int(m_ready.size()) < m_ahead; });
+                if(m_stop) {
+                    break;
+                }
+            }
+            qint64 imageBytes = m_pageBytes(page);
+            m_budget.acquire(RenderCopies * imageBytes);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(m_stop) {
+                    m_budget.release(RenderCopies * imageBytes);
+                    break;
+                }
+            }
+            PageData pageData;
+            if(!render(page, imageBytes, pageData)) {
+                break;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_stop) {
+                m_budget.release(HeldCopies * imageBytes);
+                break;
+            }
+            m_ready.push_back(std::make_pair(pageData, HeldCopies * imageBytes));
+            m_condition.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done = true;
+        m_condition.notify_all();
+    }
+};
+
 ERROR_CODE TessOcr::recognize(const QString& inPath, const OcrParam& pdfOcrParam, bool autodetectLayout,  ProgressInfo* interProcessInfo) {
+    TraceSpan span("recognize");
     tesseract::TessBaseAPI tess;
     std::string tessdataDir = m_parentOfTessdataDir.toStdString();
     std::string lang = "chi_sim";
@@ -367,38 +931,75 @@ ERROR_CODE TessOcr::recognize(const QString& inPath, const OcrParam& pdfOcrParam
         return ERROR_CODE::FAIL_INIT_TESS;
     }
     tess.SetPageSegMode(tesseract::PageSegMode::PSM_SINGLE_BLOCK);
+    // Text comes straight from the engine, the HOCR tree is only built if another target or the word
+    // index needs it. Words may still be corrected with a dictionary, then the text is derived from the tree instead.
+    bool txtOutput = HasOutfileType(FILE_TYPE::TXT) && !m_dictionary.isOpen();
+    bool hocrOutput = m_exportOptions.m_buildTextIndex || m_outfileTypes.size() > (txtOutput ? 1 : 0);
+    if(txtOutput && !openTxtStream()) {
+        interProcessInfo->m_errCode = ERROR_CODE::FAIL_OPEN_FILE;
+        return ERROR_CODE::FAIL_OPEN_FILE;
+    }
+    QScopedPointer<DisplayRenderer> renderer;
+    if(m_infileType == FILE_TYPE::PDF) {
+        StageTimer timer(m_stats, STAGE_POPPLER_LOAD);
+        renderer.reset(new PDFRenderer(inPath, pdfOcrParam.m_password.toLocal8Bit()));
+    } else {
+        renderer.reset(new ImageRenderer(inPath));
+    }
     ProgressMonitor monitor(pdfOcrParam.m_pages.size(), interProcessInfo);
     monitor.desc.ocr_alive = 1;
-    for(int page : pdfOcrParam.m_pages) {
+    // With render-ahead, the next pages are rendered while the engine works on the current one
+    int resolution = renderResolution(inPath);
+    PageRenderQueue queue(pdfOcrParam.m_pages, std::max(m_exportOptions.m_renderAheadPages, 0), m_pageBudget, [&](int page) {
+        return pageImageBytes(*renderer, page, resolution);
+    }, [&](int page) {
+        return setPage(*renderer, page, true, inPath);
+    });
+    PageData pageData;
+    qint64 pageBytes;
+    while(queue.next(pageData, pageBytes)) {
         monitor.desc.progress = 0;
-        PageData pageData = setPage(page, true, inPath);
         for(const QImage& image : pageData.ocrAreas) {
             tess.SetImage(image.bits(), image.width(), image.height(), 4, image.bytesPerLine());
             tess.SetSourceResolution(pageData.resolution);
-            tess.Recognize(&monitor.desc);
+            {
+                TraceSpan recognizeSpan("Recognize");
+                StageTimer timer(m_stats, STAGE_RECOGNIZE);
+                tess.Recognize(&monitor.desc);
+            }
             if(!monitor.Cancelled()) {
-                char* text = nullptr;
-                if(m_outfileType == FILE_TYPE::TXT) {
-                    text = tess.GetUTF8Text();
-                    m_utf8Text.append(text);
-                } else {
-                    tess.SetVariable("hocr_font_info", "true");
-                    text = tess.GetHOCRText(page);
-                    read(text, pageData);
+                if(txtOutput) {
+                    char* text = tess.GetUTF8Text();
+                    writeTxtPage(text);
+                    delete[] text;
+                }
+                if(hocrOutput) {
+                    read(tess, QRect(QPoint(0, 0), QPoint(image.width(), image.height())), pageData);
                 }
-                delete text;
             }
 
         }
+        pageData = PageData();
+        m_pageBudget.release(pageBytes);
         monitor.increaseProgress();
+        if(m_stats && !monitor.Cancelled()) {
+            ++m_stats->m_pagesRecognized;
+        }
         if(monitor.Cancelled()) {
             break;
         }
     }
     if(monitor.Cancelled() == true) {
+        // Discards the part file, an earlier export of the target stays as it was
+        m_txtFile.reset();
         interProcessInfo->m_errCode = ERROR_CODE::CANCLED_BY_USER;
         return ERROR_CODE::CANCLED_BY_USER;
     }
+    if(queue.failed()) {
+        m_txtFile.reset();
+        interProcessInfo->m_errCode = ERROR_CODE::CANT_NOT_GENERATE_IMAGE;
+        return ERROR_CODE::CANT_NOT_GENERATE_IMAGE;
+    }
     interProcessInfo->m_progress = 90;
     return ERROR_CODE::SUCCESS;
 }
@@ -419,13 +1020,18 @@ PDFSettings TessOcr::getPdfSettings() const {
     return pdfSettings;
 }
 
-PageData TessOcr::setPage(int page, bool autodetectLayout, QString filename) {
+int TessOcr::renderResolution(const QString& filename) {
+    return filename.endsWith(".pdf", Qt::CaseInsensitive) ? 300 : 100;
+}
+
+PageData TessOcr::setPage(const DisplayRenderer& renderer, int page, bool autodetectLayout, QString filename) {
+    TraceSpan span("setPage");
     PageData pageData;
     pageData.success = true;
     pageData.filename = filename;
     pageData.angle = 0;
-    pageData.resolution = filename.endsWith(".pdf", Qt::CaseInsensitive) ? 300 : 100;
-    pageData.ocrAreas = GetOCRAreas(filename, pageData.resolution, page);
+    pageData.resolution = renderResolution(filename);
+    pageData.ocrAreas = GetOCRAreas(renderer, pageData.resolution, page);
     pageData.page = page;
     return pageData;
 }
@@ -5,9 +5,18 @@
 #include <tesseract/ocrclass.h>
 #include <tesseract/strngs.h>
 #include <tesseract/genericvector.h>
+#include <vector>
+#include <QScopedPointer>
 #include "Painter.hh"
 #include "HOCRDocument.hh"
+#include "HOCRTextIndex.hh"
 #include "Interprocess.hh"
+#include "OutputFile.hh"
+#include "PageBufferBudget.hh"
+#include "StageTimer.hh"
+#include "WordDictionary.hh"
+
+class DisplayRenderer;
 
 struct PageData {
     bool success;
@@ -80,39 +89,82 @@ public:
         PDF,
         XML,
         TXT,
-        IMG
+        IMG,
+        SNAPSHOT,
+        ARROW
     };
 public:
     TessOcr(const QString& parentOfTessdataDir);
     ERROR_CODE recognize(const QString& inPath, const OcrParam& pdfOcrParam, bool autodetectLayout, ProgressInfo* interProcessInfo);
     ERROR_CODE ParseXML(const QString& inPath, ProgressInfo* interProcessInfo);
+    ERROR_CODE ParseSnapshot(const QString& inPath, ProgressInfo* interProcessInfo);
+    // Replaces low confidence words by their nearest dictionary word, if a dictionary is loaded
+    ERROR_CODE CorrectWords(ProgressInfo* interProcessInfo);
 
     ERROR_CODE ExportPdf(const QString& outPath, ProgressInfo* interProcessInfo);
     ERROR_CODE ExporteXML(const QString& outPath, ProgressInfo* interProcessInfo);
     ERROR_CODE ExportTxt(const QString& outPath, ProgressInfo* interProcessInfo);
+    ERROR_CODE ExportSnapshot(const QString& outPath, ProgressInfo* interProcessInfo);
+    ERROR_CODE ExportArrow(const QString& outPath, ProgressInfo* interProcessInfo);
 
-    void SetOutfileType(FILE_TYPE outfileType) { m_outfileType = outfileType;}
-    FILE_TYPE GetOutfileType() { return m_outfileType;}
+    // All targets are produced from a single recognition
+    void SetOutfileTypes(const QList<FILE_TYPE>& outfileTypes) {
+        m_outfileTypes = outfileTypes;
+        m_pendingExports = outfileTypes.size();
+    }
+    const QList<FILE_TYPE>& GetOutfileTypes() { return m_outfileTypes;}
+    bool HasOutfileType(FILE_TYPE outfileType) const { return m_outfileTypes.contains(outfileType);}
     void SetInfileType(FILE_TYPE infileType) {m_infileType = infileType;}
     FILE_TYPE GetInfileType() { return m_infileType;}
+    void SetExportOptions(const ExportOptions& exportOptions) {
+        m_exportOptions = exportOptions;
+        m_pageBudget.setLimit(qint64(exportOptions.m_pageBufferBudgetMB) << 20);
+    }
+    // Text output is written while recognizing, so the path has to be known beforehand
+    void SetTxtOutPath(const QString& outPath) { m_txtOutPath = outPath;}
+    // Accepts a compiled dictionary (.dawg) or a word list, which is compiled next to it on first use
+    bool LoadDictionary(const QString& path);
+    // Stage timings and counters are added to stats, which may be null
+    void SetStats(PipelineStats* stats) {
+        m_stats = stats;
+        m_pageBudget.setStats(stats);
+    }
+    // Appends the words of item as glyph runs in PDF units, measured by measurer
+    static void layoutChildren(TextMeasurer& measurer, const HOCRItem* item, const PDFSettings& pdfSettings, double px2pu,
+                               double defaultFontSize, QVector<GlyphRun>& runs);
+    // Appends the text of item as plain text, laid out like Tesseract's GetUTF8Text
+    static void collectText(const HOCRItem* item, std::string& text);
 private:
-    QList<QImage> GetOCRAreas(const QFileInfo& fileinfo, int resolution, int page);
-    void read(const char* hocrtext, PageData pageData);
+    QList<QImage> GetOCRAreas(const DisplayRenderer& renderer, int resolution, int page);
+    void read(tesseract::TessBaseAPI& tess, const QRect& pageRect, const PageData& pageData);
     QPageSize GetPdfPageSize(const HOCRDocument* hocrdocument);
     ERROR_CODE ExportResult(const QString& outPath, ProgressInfo* interProgressInfo);
     PDFSettings& GetPdfSettings();
     ERROR_CODE CheckFileStatus(const QFileInfo& fileInfo, ProgressInfo* interProcessInfo, const OcrParam& pdfOcrParam = OcrParam());
 private:
-    void printChildren(PDFPainter& painter, const HOCRItem* item, const PDFSettings& pdfSettings, double px2pu, double imgScale = 1.);
     PDFSettings getPdfSettings() const;
-    PageData setPage(int page, bool autodetectLayout, QString filename);
+    static int renderResolution(const QString& filename);
+    PageData setPage(const DisplayRenderer& renderer, int page, bool autodetectLayout, QString filename);
+    void indexPage(int page);
+    bool openTxtStream();
+    void writeTxtPage(const char* text);
+    void collectCorrections(const HOCRItem* item, int& word, QVector<QPair<int, QString>>& corrections) const;
+    void applyCorrections(HOCRItem* item, int& word, const QVector<QPair<int, QString>>& corrections, int& next) const;
 
     HOCRDocument m_hocrDocument;
     QString m_parentOfTessdataDir;
-    QString m_utf8Text;
-    FILE_TYPE m_outfileType;
+    QString m_txtOutPath;
+    QScopedPointer<OutputFile> m_txtFile;
+    int m_txtPages = 0;
+    QList<FILE_TYPE> m_outfileTypes;
+    int m_pendingExports = 1;
     FILE_TYPE m_infileType;
     PDFSettings m_pdfSettings;
+    ExportOptions m_exportOptions;
+    HOCRTextIndex m_textIndex;
+    WordDictionary m_dictionary;
+    PipelineStats* m_stats = nullptr;
+    PageBufferBudget m_pageBudget;
 
     PageData m_pageData;
 };
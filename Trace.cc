@@ -0,0 +1,84 @@
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "OutputFile.hh"
+#include "Trace.hh"
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    std::uint64_t begin;
+    std::uint64_t end;
+};
+
+struct ThreadBuffer {
+    int tid;
+    std::vector<TraceEvent> events;
+};
+
+std::uint64_t s_origin = 0;
+std::mutex s_buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+thread_local ThreadBuffer* t_buffer = nullptr;
+
+// Registered on the first span of a thread and kept past its end, so the lock is only taken once per thread
+ThreadBuffer* threadBuffer() {
+    if(!t_buffer) {
+        std::lock_guard<std::mutex> lock(s_buffersMutex);
+        s_buffers.emplace_back(new ThreadBuffer());
+        t_buffer = s_buffers.back().get();
+        t_buffer->tid = int(s_buffers.size());
+        t_buffer->events.reserve(4096);
+    }
+    return t_buffer;
+}
+
+} // namespace
+
+bool Trace::s_enabled = false;
+
+void Trace::start() {
+    // The calling thread is the main one, tid 1
+    threadBuffer();
+    s_origin = now();
+    s_enabled = true;
+}
+
+void Trace::addEvent(const char* name, std::uint64_t begin, std::uint64_t end) {
+    threadBuffer()->events.push_back(TraceEvent{name, begin, end});
+}
+
+bool Trace::write(const QString& path) {
+    OutputFile file(path);
+    if(!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(s_buffersMutex);
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for(const std::unique_ptr<ThreadBuffer>& buffer : s_buffers) {
+        json += QString("%1{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%2,\"args\":{\"name\":\"%3\"}}")
+                .arg(first ? "" : ",\n").arg(buffer->tid).arg(buffer->tid == 1 ? "main" : QString("worker %1").arg(buffer->tid - 1)).toUtf8();
+        first = false;
+        for(const TraceEvent& event : buffer->events) {
+            json += ",\n{\"name\":\"";
+            json += event.name;
+            json += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+            json += QByteArray::number(buffer->tid);
+            json += ",\"ts\":";
+            json += QByteArray::number(qulonglong(event.begin - s_origin));
+            json += ",\"dur\":";
+            json += QByteArray::number(qulonglong(event.end - event.begin));
+            json += "}";
+        }
+        if(json.size() >= OutputFile::BufferSize) {
+            if(file.write(json) != json.size()) {
+                return false;
+            }
+            json.clear();
+        }
+    }
+    json += "\n]}\n";
+    return file.write(json) == json.size() && file.commit();
+}
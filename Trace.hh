@@ -0,0 +1,47 @@
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include <chrono>
+#include <cstdint>
+#include <QString>
+
+/*
+ * Opt-in timeline of hot spans, written as Chrome trace events (chrome://tracing, Perfetto).
+ * Each thread appends complete events to a buffer of its own, which is only read by write() once
+ * the work is done. Span names must be string literals. While tracing is off a span costs a
+ * single branch.
+ */
+class Trace {
+public:
+    // From the main thread, before any span that should be recorded and while no other thread is running
+    static void start();
+    static bool enabled() {
+        return s_enabled;
+    }
+    // After all traced threads are done
+    static bool write(const QString& path);
+
+    static std::uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static void addEvent(const char* name, std::uint64_t begin, std::uint64_t end);
+
+private:
+    static bool s_enabled;
+};
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : m_name(name), m_begin(Trace::enabled() ? Trace::now() : 0) {}
+    ~TraceSpan() {
+        if(Trace::enabled()) {
+            Trace::addEvent(m_name, m_begin, Trace::now());
+        }
+    }
+
+private:
+    const char* m_name;
+    std::uint64_t m_begin;
+};
+
+#endif // TRACE_HH
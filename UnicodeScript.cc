@@ -0,0 +1,3 @@
+#include "UnicodeScript.hh"
+
+constexpr UnicodeScript::Range UnicodeScript::s_ranges[];
@@ -0,0 +1,80 @@
+#ifndef UNICODESCRIPT_HH
+#define UNICODESCRIPT_HH
+
+/*
+ * Script classification of Unicode code points, used to decide whether words are separated by spaces.
+ * The table is a sorted list of disjoint code point ranges; lookups are a binary search
+ * and can be evaluated at compile time.
+ */
+class UnicodeScript {
+public:
+    enum Script { Other, Han, Kana, Bopomofo, Hangul, Symbols, Fullwidth };
+
+    struct Range {
+        char32_t first;
+        char32_t last;
+        Script script;
+    };
+
+    static constexpr Range s_ranges[] = {
+        {0x1100, 0x11ff, Hangul},     // Hangul Jamo
+        {0x2480, 0x2e7f, Symbols},    // Enclosed alphanumerics .. Supplemental punctuation
+        {0x2e80, 0x2fff, Han},        // CJK and Kangxi radicals, ideographic description
+        {0x3000, 0x303f, Symbols},    // CJK symbols and punctuation
+        {0x3040, 0x30ff, Kana},       // Hiragana, Katakana
+        {0x3100, 0x312f, Bopomofo},
+        {0x3130, 0x318f, Hangul},     // Hangul compatibility Jamo
+        {0x3190, 0x319f, Han},        // Kanbun
+        {0x31a0, 0x31bf, Bopomofo},   // Bopomofo extended
+        {0x31c0, 0x31ef, Han},        // CJK strokes
+        {0x31f0, 0x31ff, Kana},       // Katakana phonetic extensions
+        {0x3200, 0x33ff, Symbols},    // Enclosed CJK letters, CJK compatibility
+        {0x3400, 0x4dbf, Han},        // CJK extension A
+        {0x4dc0, 0x4dff, Symbols},    // Yijing hexagrams
+        {0x4e00, 0x9fff, Han},        // CJK unified ideographs
+        {0xa960, 0xa97f, Hangul},     // Hangul Jamo extended A
+        {0xac00, 0xd7ff, Hangul},     // Hangul syllables, Jamo extended B
+        {0xf900, 0xfaff, Han},        // CJK compatibility ideographs
+        {0xfe30, 0xfe4f, Symbols},    // CJK compatibility forms
+        {0xff00, 0xff60, Fullwidth},  // Fullwidth ASCII and punctuation
+        {0xff61, 0xff9f, Kana},       // Halfwidth Katakana
+        {0xffa0, 0xffdc, Hangul},     // Halfwidth Hangul
+        {0xffe0, 0xffef, Fullwidth},  // Fullwidth symbols
+        {0x1b000, 0x1b16f, Kana},     // Kana supplement, extended A, small Kana extension
+        {0x20000, 0x2fa1f, Han},      // CJK extensions B-F, compatibility supplement
+        {0x30000, 0x323af, Han}       // CJK extensions G, H
+    };
+    static constexpr int s_rangeCount = sizeof(s_ranges) / sizeof(s_ranges[0]);
+
+    static constexpr Script script(char32_t codepoint) {
+        return codepoint < s_ranges[0].first ? Other : find(codepoint, 0, s_rangeCount - 1);
+    }
+    // Scripts that do not put spaces between words
+    static constexpr bool isUnspaced(Script script) {
+        return script != Other && script != Hangul;
+    }
+    static constexpr bool isUnspaced(char32_t codepoint) {
+        return isUnspaced(script(codepoint));
+    }
+
+    static constexpr bool isSorted(int i = 0) {
+        return i + 1 >= s_rangeCount ||
+               (s_ranges[i].first <= s_ranges[i].last && s_ranges[i].last < s_ranges[i + 1].first && isSorted(i + 1));
+    }
+
+private:
+    static constexpr Script find(char32_t codepoint, int lo, int hi) {
+        return lo > hi ? Other :
+               codepoint < s_ranges[(lo + hi) / 2].first ? find(codepoint, lo, (lo + hi) / 2 - 1) :
+               codepoint > s_ranges[(lo + hi) / 2].last ? find(codepoint, (lo + hi) / 2 + 1, hi) :
+               s_ranges[(lo + hi) / 2].script;
+    }
+};
+
+static_assert(UnicodeScript::isSorted(), "UnicodeScript ranges must be sorted and disjoint");
+static_assert(UnicodeScript::script(0x4e00) == UnicodeScript::Han && UnicodeScript::script(0x3042) == UnicodeScript::Kana &&
+              UnicodeScript::script(0x2a6d6) == UnicodeScript::Han && UnicodeScript::script('a') == UnicodeScript::Other &&
+              UnicodeScript::script(0xac00) == UnicodeScript::Hangul && UnicodeScript::script(0xe000) == UnicodeScript::Other,
+              "UnicodeScript lookup");
+
+#endif // UNICODESCRIPT_HH
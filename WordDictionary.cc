@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <QHash>
+#include <QtEndian>
+#include "WordDictionary.hh"
+
+static const char s_magic[8] = {'W', 'O', 'R', 'D', 'D', 'A', 'W', 'G'};
+
+struct WordDictionary::Search {
+    QVector<uint> word;
+    std::vector<int> rows;  // Levenshtein rows, word.size() + 1 columns per depth
+    QVector<uint> prefix;
+    QVector<uint> best;
+    int bestDistance;
+    int bestCount;
+};
+
+namespace {
+
+struct BuildNode {
+    bool final = false;
+    QVector<QPair<uint, quint32>> edges;
+};
+
+QByteArray signature(const BuildNode& node) {
+    QByteArray sig;
+    sig.reserve(1 + node.edges.size() * 8);
+    sig.append(node.final ? '1' : '0');
+    for(const QPair<uint, quint32>& edge : node.edges) {
+        sig.append(reinterpret_cast<const char*>(&edge.first), sizeof(uint));
+        sig.append(reinterpret_cast<const char*>(&edge.second), sizeof(quint32));
+    }
+    return sig;
+}
+
+} // namespace
+
+WordDictionary::~WordDictionary() {
+    close();
+}
+
+QVector<uint> WordDictionary::normalize(const QString& word) {
+    return word.toCaseFolded().toUcs4();
+}
+
+// Incremental construction of a minimal DAWG from sorted input (Daciuk et al.): once the next word
+// diverges from the previous one, the nodes below the divergence are final and get merged with an
+// equivalent registered node, if there is one.
+bool WordDictionary::build(const QString& wordListPath, const QString& filename) {
+    QFile input(wordListPath);
+    if(!input.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    QVector<QVector<uint>> words;
+    while(!input.atEnd()) {
+        QString line = QString::fromUtf8(input.readLine()).section('/', 0, 0).trimmed();
+        if(!line.isEmpty()) {
+            words.append(normalize(line));
+        }
+    }
+    input.close();
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    QVector<BuildNode> nodes(1);
+    QHash<QByteArray, quint32> registry;
+    QVector<quint32> path = {0};  // path[i] is the node after the first i labels of the previous word
+    auto minimize = [&](int depth) {
+        for(int i = path.size() - 1; i > depth; --i) {
+            quint32 child = path[i];
+            QByteArray sig = signature(nodes[child]);
+            auto it = registry.find(sig);
+            if(it != registry.end()) {
+                nodes[path[i - 1]].edges.last().second = it.value();
+                nodes[child].edges.clear();
+            } else {
+                registry.insert(sig, child);
+            }
+            path.removeLast();
+        }
+    };
+    const QVector<uint>* previous = nullptr;
+    for(const QVector<uint>& word : words) {
+        int common = 0;
+        while(previous && common < word.size() && common < previous->size() && word[common] == (*previous)[common]) {
+            ++common;
+        }
+        minimize(common);
+        for(int i = common; i < word.size(); ++i) {
+            nodes.append(BuildNode());
+            quint32 child = nodes.size() - 1;
+            nodes[path.last()].edges.append(qMakePair(word[i], child));
+            path.append(child);
+        }
+        nodes[path.last()].final = true;
+        previous = &word;
+    }
+    minimize(0);
+
+    // Number the reachable nodes breadth first, merged nodes are dropped
+    QVector<qint64> ids(nodes.size(), -1);
+    QVector<quint32> order = {0};
+    ids[0] = 0;
+    QVector<Node> nodeTable;
+    QVector<Edge> edgeTable;
+    for(int i = 0; i < order.size(); ++i) {
+        const BuildNode& node = nodes[order[i]];
+        Node entry;
+        entry.firstEdge = qToLittleEndian<quint32>(edgeTable.size());
+        entry.edgeCount = qToLittleEndian<quint32>(node.edges.size() | (node.final ? FinalBit : 0));
+        nodeTable.append(entry);
+        for(const QPair<uint, quint32>& edge : node.edges) {
+            if(ids[edge.second] < 0) {
+                ids[edge.second] = order.size();
+                order.append(edge.second);
+            }
+            Edge edgeEntry;
+            edgeEntry.label = qToLittleEndian<quint32>(edge.first);
+            edgeEntry.target = qToLittleEndian<quint32>(ids[edge.second]);
+            edgeTable.append(edgeEntry);
+        }
+    }
+
+    Header header;
+    std::memcpy(header.magic, s_magic, sizeof(header.magic));
+    header.version = qToLittleEndian<quint32>(Version);
+    header.nodeCount = qToLittleEndian<quint32>(nodeTable.size());
+    header.edgeCount = qToLittleEndian<quint32>(edgeTable.size());
+    header.wordCount = qToLittleEndian<quint32>(words.size());
+
+    QFile file(filename);
+    if(!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(Header)) == sizeof(Header);
+    ok = ok && file.write(reinterpret_cast<const char*>(nodeTable.constData()), nodeTable.size() * sizeof(Node)) >= 0;
+    ok = ok && file.write(reinterpret_cast<const char*>(edgeTable.constData()), edgeTable.size() * sizeof(Edge)) >= 0;
+    file.close();
+    return ok && file.error() == QFile::NoError;
+}
+
+bool WordDictionary::open(const QString& filename) {
+    close();
+    m_file.setFileName(filename);
+    if(!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    quint64 size = m_file.size();
+    if(size < sizeof(Header) || !(m_data = m_file.map(0, size))) {
+        close();
+        return false;
+    }
+    const Header* header = reinterpret_cast<const Header*>(m_data);
+    quint64 nodeCount = qFromLittleEndian(header->nodeCount);
+    quint64 edgeCount = qFromLittleEndian(header->edgeCount);
+    if(std::memcmp(header->magic, s_magic, sizeof(s_magic)) != 0 || qFromLittleEndian(header->version) != Version ||
+            nodeCount == 0 || sizeof(Header) + nodeCount * sizeof(Node) + edgeCount * sizeof(Edge) > size) {
+        close();
+        return false;
+    }
+    m_nodes = reinterpret_cast<const Node*>(m_data + sizeof(Header));
+    m_edges = reinterpret_cast<const Edge*>(m_nodes + nodeCount);
+    for(quint64 i = 0; i < nodeCount; ++i) {
+        if(quint64(qFromLittleEndian(m_nodes[i].firstEdge)) + (qFromLittleEndian(m_nodes[i].edgeCount) & ~FinalBit) > edgeCount) {
+            close();
+            return false;
+        }
+    }
+    for(quint64 i = 0; i < edgeCount; ++i) {
+        if(qFromLittleEndian(m_edges[i].target) >= nodeCount) {
+            close();
+            return false;
+        }
+    }
+    m_header = header;
+    return true;
+}
+
+void WordDictionary::close() {
+    if(m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+    m_file.close();
+    m_data = nullptr;
+    m_header = nullptr;
+    m_nodes = nullptr;
+    m_edges = nullptr;
+}
+
+int WordDictionary::wordCount() const {
+    return m_header ? int(qFromLittleEndian(m_header->wordCount)) : 0;
+}
+
+const WordDictionary::Edge* WordDictionary::findEdge(quint32 node, uint label) const {
+    const Edge* begin = m_edges + qFromLittleEndian(m_nodes[node].firstEdge);
+    const Edge* end = begin + (qFromLittleEndian(m_nodes[node].edgeCount) & ~FinalBit);
+    const Edge* edge = std::lower_bound(begin, end, label, [](const Edge& edge, uint label) {
+        return qFromLittleEndian(edge.label) < label;
+    });
+    return edge != end && qFromLittleEndian(edge->label) == label ? edge : nullptr;
+}
+
+bool WordDictionary::contains(const QString& word) const {
+    if(!m_header) {
+        return false;
+    }
+    quint32 node = 0;
+    for(uint label : normalize(word)) {
+        const Edge* edge = findEdge(node, label);
+        if(!edge) {
+            return false;
+        }
+        node = qFromLittleEndian(edge->target);
+    }
+    return qFromLittleEndian(m_nodes[node].edgeCount) & FinalBit;
+}
+
+QString WordDictionary::nearest(const QString& word, int maxDistance) const {
+    if(!m_header || word.isEmpty()) {
+        return QString();
+    }
+    if(contains(word)) {
+        return word;
+    }
+    Search state;
+    state.word = normalize(word);
+    int columns = state.word.size() + 1;
+    // Below depth word.size() + maxDistance every row exceeds maxDistance
+    state.rows.resize((state.word.size() + maxDistance + 2) * columns);
+    for(int j = 0; j < columns; ++j) {
+        state.rows[j] = j;
+    }
+    state.bestDistance = maxDistance;
+    state.bestCount = 0;
+    search(state, 0, 0);
+    return state.bestCount == 1 ? QString::fromUcs4(state.best.constData(), state.best.size()) : QString();
+}
+
+// Depth first walk computing one Levenshtein row per edge. A subtree is skipped as soon as its row
+// minimum exceeds the best distance found so far, since it is a lower bound for all its words.
+void WordDictionary::search(Search& state, quint32 node, int depth) const {
+    const int n = state.word.size();
+    const int* row = &state.rows[depth * (n + 1)];
+    int* next = &state.rows[(depth + 1) * (n + 1)];
+    const Edge* edge = m_edges + qFromLittleEndian(m_nodes[node].firstEdge);
+    for(quint32 i = 0, count = qFromLittleEndian(m_nodes[node].edgeCount) & ~FinalBit; i < count; ++i, ++edge) {
+        uint label = qFromLittleEndian(edge->label);
+        quint32 target = qFromLittleEndian(edge->target);
+        next[0] = row[0] + 1;
+        int rowMin = next[0];
+        for(int j = 1; j <= n; ++j) {
+            next[j] = std::min(std::min(row[j], next[j - 1]) + 1, row[j - 1] + (state.word[j - 1] == label ? 0 : 1));
+            rowMin = std::min(rowMin, next[j]);
+        }
+        if(rowMin > state.bestDistance) {
+            continue;
+        }
+        state.prefix.append(label);
+        if((qFromLittleEndian(m_nodes[target].edgeCount) & FinalBit) && next[n] <= state.bestDistance) {
+            if(state.bestCount == 0 || next[n] < state.bestDistance) {
+                state.bestDistance = next[n];
+                state.best = state.prefix;
+                state.bestCount = 1;
+            } else {
+                ++state.bestCount;
+            }
+        }
+        search(state, target, depth + 1);
+        state.prefix.removeLast();
+    }
+}
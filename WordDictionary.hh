@@ -0,0 +1,70 @@
+#ifndef WORDDICTIONARY_HH
+#define WORDDICTIONARY_HH
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+/*
+ * Word list compiled to a minimal DAWG (directed acyclic word graph) over Unicode code points.
+ * Words are stored case folded, lookups fold the query the same way.
+ *
+ * File layout (all integers little endian):
+ *   Header
+ *   Node[nodeCount]   node 0 is the root
+ *   Edge[edgeCount]   the edges of a node are contiguous and sorted by label
+ */
+class WordDictionary {
+public:
+    static const quint32 Version = 1;
+    static const quint32 FinalBit = 0x80000000u;
+
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 nodeCount;
+        quint32 edgeCount;
+        quint32 wordCount;
+    };
+    struct Node {
+        quint32 firstEdge;
+        quint32 edgeCount;  // FinalBit is set if a word ends here
+    };
+    struct Edge {
+        quint32 label;
+        quint32 target;
+    };
+
+    WordDictionary() {}
+    ~WordDictionary();
+
+    // Compiles a word list with one word per line; hunspell affix flags after a '/' are ignored
+    static bool build(const QString& wordListPath, const QString& filename);
+
+    bool open(const QString& filename);
+    void close();
+    bool isOpen() const {
+        return m_header != nullptr;
+    }
+    int wordCount() const;
+
+    bool contains(const QString& word) const;
+    // The dictionary word within maxDistance edits (Levenshtein) of word, or an empty
+    // string if there is none or several are equally close
+    QString nearest(const QString& word, int maxDistance) const;
+
+private:
+    QFile m_file;
+    const uchar* m_data = nullptr;
+    const Header* m_header = nullptr;
+    const Node* m_nodes = nullptr;
+    const Edge* m_edges = nullptr;
+
+    struct Search;
+
+    static QVector<uint> normalize(const QString& word);
+    const Edge* findEdge(quint32 node, uint label) const;
+    void search(Search& state, quint32 node, int depth) const;
+};
+
+#endif // WORDDICTIONARY_HH
@@ -0,0 +1,280 @@
+/*
+ * Microbenchmarks of the HOCRDocument model layer, the per-item work of every hOCR parse, edit and export.
+ *
+ * Usage: ModelBench [page.hocr] [iterations]
+ * The fixture are the ocr_page elements of an hOCR file written by Tesseract (e.g. an XML target of
+ * EndProcess or PipelineBench). Without one, pages shaped like Tesseract's hOCR output (careas of
+ * paragraphs of lines with baseline, x_size, x_font, x_fsize and x_wconf) are generated.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <QCoreApplication>
+#include <QDomDocument>
+#include <QFile>
+#include <QStringList>
+#include "HOCRDocument.hh"
+#include "Tessocr.hh"
+
+// Text is measured with fixed advances, the painter discards everything; only the layout is timed
+class NullMeasurer : public TextMeasurer {
+public:
+    void setFont(const QString& /*family*/, double pointSize) override {
+        m_size = pointSize;
+    }
+    double averageCharWidth() override {
+        return 0.5 * m_size;
+    }
+    double textWidth(const QString& text) override {
+        return 0.5 * m_size * text.size();
+    }
+private:
+    double m_size = 10;
+};
+
+class NullPainter : public PDFPainter {
+public:
+    void setFontFamily(const QString& /*family*/, bool /*bold*/, bool /*italic*/) override {}
+    void setFontSize(double /*pointSize*/, bool /*defaultFont*/) override {}
+    void drawText(double /*x*/, double /*y*/, const QString& text) override {
+        m_chars += text.size();
+    }
+    void setTextInvisible(bool /*invisible*/) override {}
+    EncodedImage encodeImage(const QImage& /*image*/, const PDFSettings& /*settings*/) const override {
+        return EncodedImage();
+    }
+    void drawEncodedImage(const QRect& /*bbox*/, const EncodedImage& /*image*/) override {}
+    double getAverageCharWidth() const override {
+        return 5;
+    }
+    double getTextWidth(const QString& text) const override {
+        return 5 * text.size();
+    }
+    TextMeasurer* createMeasurer() override {
+        return new NullMeasurer();
+    }
+    long chars() const {
+        return m_chars;
+    }
+private:
+    long m_chars = 0;
+};
+
+static QString syntheticHocr(int pages) {
+    std::mt19937 rng(42);
+    auto uniform = [&rng](int first, int last) {
+        return std::uniform_int_distribution<int>(first, last)(rng);
+    };
+    QString html = "<body>\n";
+    int block = 0, par = 0, line = 0, word = 0;
+    for(int page = 1; page <= pages; ++page) {
+        html += QString("<div class='ocr_page' id='page_%1' title='image \"page%1.png\"; bbox 0 0 2480 3508; ppageno %2'>\n").arg(page).arg(page - 1);
+        int y = 300;
+        for(int b = 0; b < 4; ++b) {
+            html += QString(" <div class='ocr_carea' id='block_%1_%2' title=\"bbox 300 %3 2180 %4\">\n").arg(page).arg(++block).arg(y).arg(y + 700);
+            for(int p = 0; p < 3; ++p) {
+                html += QString("  <p class='ocr_par' id='par_%1_%2' lang='eng' title=\"bbox 300 %3 2180 %4\">\n").arg(page).arg(++par).arg(y).arg(y + 220);
+                for(int l = 0; l < 5; ++l, y += 45) {
+                    html += QString("   <span class='ocr_line' id='line_%1_%2' title=\"bbox 300 %3 2180 %4; baseline %5 -%6; x_size 44; x_descenders 10; x_ascenders 11\">\n")
+                            .arg(page).arg(++line).arg(y).arg(y + 40).arg(uniform(-5, 5) / 1000.0).arg(uniform(8, 12));
+                    int x = 300;
+                    for(int w = 0; w < 11 && x < 2100; ++w) {
+                        QString text;
+                        for(int c = 0, n = uniform(2, 9); c < n; ++c) {
+                            text += QChar('a' + uniform(0, 25));
+                        }
+                        int width = 18 * text.size();
+                        html += QString("    <span class='ocrx_word' id='word_%1_%2' title='bbox %3 %4 %5 %6; x_wconf %7; x_font DejaVu_Serif; x_fsize 11'>%8</span>\n")
+                                .arg(page).arg(++word).arg(x).arg(y).arg(x + width).arg(y + 40).arg(uniform(40, 96)).arg(text);
+                        x += width + 20;
+                    }
+                    html += "   </span>\n";
+                }
+                html += "  </p>\n";
+                y += 20;
+            }
+            html += " </div>\n";
+        }
+        html += "</div>\n";
+    }
+    return html + "</body>\n";
+}
+
+static void collectElements(const QDomElement& element, const QString& itemClass, QList<QDomElement>& elements, QStringList& titles) {
+    if(element.hasAttribute("title")) {
+        titles.append(element.attribute("title"));
+    }
+    if(element.attribute("class") == itemClass) {
+        elements.append(element);
+    }
+    for(QDomElement child = element.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        collectElements(child, itemClass, elements, titles);
+    }
+}
+
+static void collectItems(HOCRItem* item, const QString& itemClass, QVector<HOCRItem*>& items) {
+    if(item->itemClass() == itemClass) {
+        items.append(item);
+    }
+    for(HOCRItem* child : item->children()) {
+        collectItems(child, itemClass, items);
+    }
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static void report(const char* name, Clock::duration elapsed, long ops) {
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    std::printf("%-26s %10ld ops %12.1f ns/op\n", name, ops, ops > 0 ? ns / ops : 0.0);
+}
+
+// Times body over all iterations, body returns the number of operations it did
+template<class F>
+static void run(const char* name, int iterations, F body) {
+    long ops = 0;
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        ops += body();
+    }
+    report(name, Clock::now() - start, ops);
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QString html;
+    if(argc > 1) {
+        QFile file(argv[1]);
+        if(!file.open(QIODevice::ReadOnly)) {
+            std::fprintf(stderr, "Unable to open %s\n", argv[1]);
+            return 1;
+        }
+        html = QString::fromUtf8(file.readAll());
+    } else {
+        html = syntheticHocr(20);
+    }
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+    QDomDocument dom;
+    if(iterations <= 0 || !dom.setContent(html)) {
+        std::fprintf(stderr, "Nothing to run\n");
+        return 1;
+    }
+    QList<QDomElement> pageElements, wordElements;
+    QStringList titles, unusedTitles;
+    collectElements(dom.documentElement(), "ocr_page", pageElements, titles);
+    collectElements(dom.documentElement(), "ocrx_word", wordElements, unusedTitles);
+    if(pageElements.isEmpty()) {
+        std::fprintf(stderr, "No ocr_page in the fixture\n");
+        return 1;
+    }
+    std::printf("pages: %d, words: %d, title attributes: %d, iterations: %d\n", pageElements.size(), wordElements.size(), titles.size(), iterations);
+
+    HOCRDocument document;
+    for(const QDomElement& element : pageElements) {
+        document.addPage(element, true);
+    }
+    QVector<HOCRItem*> lines, words;
+    for(int i = 0; i < document.pageCount(); ++i) {
+        collectItems(document.page(i), "ocr_line", lines);
+        collectItems(document.page(i), "ocrx_word", words);
+    }
+
+    long sink = 0;
+    run("deserializeAttrGroup", iterations, [&]() {
+        for(const QString& title : titles) {
+            sink += HOCRItem::deserializeAttrGroup(title).size();
+        }
+        return long(titles.size());
+    });
+    run("HOCRItem(QDomElement)", iterations, [&]() {
+        HOCRPage* page = document.page(0);
+        for(const QDomElement& element : wordElements) {
+            HOCRItem* item = new HOCRItem(element, page, page);
+            sink += item->bbox().width();
+            delete item;
+        }
+        return long(wordElements.size());
+    });
+    run("HOCRPage(QDomElement)", iterations, [&]() {
+        int pageId = 0;
+        for(const QDomElement& element : pageElements) {
+            HOCRPage* page = new HOCRPage(element, ++pageId, "en_US", true, 0);
+            sink += page->children().size();
+            delete page;
+        }
+        return long(pageElements.size());
+    });
+    run("HOCRItem::toHtml (page)", iterations, [&]() {
+        for(int i = 0; i < document.pageCount(); ++i) {
+            sink += document.page(i)->toHtml().size();
+        }
+        return long(document.pageCount());
+    });
+    run("HOCRItem::baseLine", iterations, [&]() {
+        for(const HOCRItem* line : lines) {
+            sink += line->baseLine().second;
+        }
+        return long(lines.size());
+    });
+    // recomputeBBoxes is private, setItemBBox runs it for the ancestors of the word
+    run("setItemBBox/recomputeBBoxes", iterations, [&]() {
+        for(HOCRItem* word : words) {
+            QRect bbox = word->bbox();
+            document.setItemBBox(word, bbox.adjusted(0, 0, 1, 0));
+            document.setItemBBox(word, bbox);
+        }
+        return long(words.size()) * 2;
+    });
+    {
+        // Merges all words of each line, on a fresh copy of the pages each time; the copy is not timed
+        Clock::duration elapsed = Clock::duration::zero();
+        long ops = 0;
+        for(int i = 0; i < iterations; ++i) {
+            HOCRDocument copy;
+            for(const QDomElement& element : pageElements) {
+                copy.addPage(element, true);
+            }
+            QVector<HOCRItem*> copyLines;
+            for(int page = 0; page < copy.pageCount(); ++page) {
+                collectItems(copy.page(page), "ocr_line", copyLines);
+            }
+            Clock::time_point start = Clock::now();
+            for(HOCRItem* line : copyLines) {
+                if(line->children().size() > 1) {
+                    sink += copy.mergeItems(line, 0, line->children().size() - 1) != nullptr;
+                    ++ops;
+                }
+            }
+            elapsed += Clock::now() - start;
+        }
+        report("mergeItems (line)", elapsed, ops);
+    }
+    {
+        // The PDF export's layout and replay of a page, against a painter that does nothing
+        NullPainter painter;
+        NullMeasurer measurer;
+        PDFSettings settings;
+        settings.fontSize = -1;
+        settings.uniformizeLineSpacing = true;
+        settings.preserveSpaceWidth = 1;
+        settings.overlay = false;
+        settings.detectedFontScaling = 1.0;
+        QVector<GlyphRun> runs;
+        run("layoutChildren+paint (page)", iterations, [&]() {
+            for(int i = 0; i < document.pageCount(); ++i) {
+                const HOCRPage* page = document.page(i);
+                runs.clear();
+                TessOcr::layoutChildren(measurer, page, settings, 72.0 / 300, 30, runs);
+                for(const GlyphRun& glyphRun : runs) {
+                    painter.setFontFamily(glyphRun.fontFamily, false, false);
+                    painter.setFontSize(glyphRun.fontSize);
+                    painter.drawText(glyphRun.x, glyphRun.y, glyphRun.text);
+                }
+            }
+            return long(document.pageCount());
+        });
+        sink += painter.chars();
+    }
+    // Keeps the results alive
+    return sink == -1;
+}
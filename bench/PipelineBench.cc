@@ -0,0 +1,344 @@
+/*
+ * End-to-end benchmark of the TessOcr pipeline over a generated corpus.
+ * Multi-page PDFs (vector text) and TIFFs (8 bit gray) are rendered with QPainter from seeded random
+ * Latin and CJK text at three densities. Each document then goes through the same steps as EndProcess
+ * for every input -> output combination: PDF and TIFF are recognized, their hOCR and snapshot outputs
+ * are the XML and HOCRBIN inputs. Each job runs in a process of its own, started with --job, so the
+ * reported peak RSS is that of the job alone. Reports pages/sec, the time per pipeline stage and the
+ * peak RSS.
+ *
+ * Usage: PipelineBench tessdataParentDir [pagesPerDocument] [workDir] [filter]
+ * The corpus is (re)generated in workDir, default "bench-corpus". Only combinations whose label,
+ * e.g. "cjk-dense pdf->txt", contains filter are run; XML and HOCRBIN inputs need the pdf->xml and
+ * pdf->hocrbin jobs of their document.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QProcess>
+#include <QtEndian>
+#include "Tessocr.hh"
+
+struct CorpusSpec {
+    const char* script;
+    const char* density;
+    bool cjk;
+    double fontPt;
+    double marginInch;
+    int linesPerParagraph;
+};
+
+static const CorpusSpec s_specs[] = {
+    {"latin", "sparse", false, 16, 1.5, 3},
+    {"latin", "normal", false, 11, 1.0, 6},
+    {"latin", "dense", false, 8, 0.5, 12},
+    {"cjk", "sparse", true, 16, 1.5, 3},
+    {"cjk", "normal", true, 11, 1.0, 6},
+    {"cjk", "dense", true, 8, 0.5, 12},
+};
+
+static QString randomWord(std::mt19937& rng, bool cjk) {
+    QString word;
+    if(cjk) {
+        // Mostly common Han characters, CJK text has no spaces but words keep the generator simple
+        for(int i = 0, n = std::uniform_int_distribution<int>(1, 4)(rng); i < n; ++i) {
+            word.append(QChar(std::uniform_int_distribution<int>(0x4e00, 0x6fff)(rng)));
+        }
+        if(std::uniform_int_distribution<int>(0, 9)(rng) == 0) {
+            word.append(QChar(0x3002));
+        }
+    } else {
+        for(int i = 0, n = std::uniform_int_distribution<int>(2, 10)(rng); i < n; ++i) {
+            word.append(QChar('a' + std::uniform_int_distribution<int>(0, 25)(rng)));
+        }
+        if(std::uniform_int_distribution<int>(0, 7)(rng) == 0) {
+            word.append(',');
+        }
+    }
+    return word;
+}
+
+// Fills a page of pageSize device pixels at dpi with paragraphs of random words
+static void paintPage(QPainter& painter, const QSize& pageSize, int dpi, const CorpusSpec& spec, std::mt19937& rng) {
+    QFont font(spec.cjk ? "Source Han Sans TW" : "DejaVu Serif");
+    font.setPixelSize(qRound(spec.fontPt * dpi / 72.0));
+    painter.setFont(font);
+    painter.setPen(Qt::black);
+    QFontMetrics metrics(font);
+    int margin = qRound(spec.marginInch * dpi);
+    int right = pageSize.width() - margin;
+    int lineHeight = metrics.lineSpacing();
+    int y = margin + metrics.ascent();
+    int line = 0;
+    while(y + metrics.descent() < pageSize.height() - margin) {
+        QString text;
+        for(QString word = randomWord(rng, spec.cjk); margin + metrics.width(text + word) < right; word = randomWord(rng, spec.cjk)) {
+            text += spec.cjk ? word : word + ' ';
+        }
+        painter.drawText(margin, y, text);
+        y += lineHeight;
+        if(++line % spec.linesPerParagraph == 0) {
+            y += lineHeight;
+        }
+    }
+}
+
+static bool writePdf(const QString& path, int pages, const CorpusSpec& spec, unsigned seed) {
+    const int dpi = 300;
+    QPdfWriter writer(path);
+    writer.setPageSize(QPageSize(QPageSize::A4));
+    writer.setPageMargins(QMarginsF(0, 0, 0, 0));
+    writer.setResolution(dpi);
+    QPainter painter(&writer);
+    std::mt19937 rng(seed);
+    for(int page = 0; page < pages; ++page) {
+        if(page > 0 && !writer.newPage()) {
+            return false;
+        }
+        paintPage(painter, QSize(writer.width(), writer.height()), dpi, spec, rng);
+    }
+    return painter.end();
+}
+
+static void appendLE16(QByteArray& data, quint16 value) {
+    value = qToLittleEndian(value);
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void appendLE32(QByteArray& data, quint32 value) {
+    value = qToLittleEndian(value);
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Baseline TIFF, one uncompressed 8 bit gray strip per page, the pages chained by their IFDs
+static bool writeTiff(const QString& path, int pages, const CorpusSpec& spec, unsigned seed) {
+    const int dpi = 200;
+    QSize pageSize(qRound(8.27 * dpi), qRound(11.69 * dpi));
+    QByteArray data("II*\0", 4);
+    appendLE32(data, 0);
+    int nextIfdField = 4;
+    std::mt19937 rng(seed);
+    for(int page = 0; page < pages; ++page) {
+        QImage image(pageSize, QImage::Format_Grayscale8);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::TextAntialiasing);
+        paintPage(painter, pageSize, dpi, spec, rng);
+        painter.end();
+
+        quint32 stripOffset = data.size();
+        for(int y = 0; y < image.height(); ++y) {
+            data.append(reinterpret_cast<const char*>(image.constScanLine(y)), image.width());
+        }
+        // Offsets have to be even
+        if(data.size() % 2) {
+            data.append('\0');
+        }
+        quint32 resolutionOffset = data.size();
+        appendLE32(data, dpi);
+        appendLE32(data, 1);
+        quint32 ifdOffset = data.size();
+        qToLittleEndian<quint32>(ifdOffset, reinterpret_cast<uchar*>(data.data() + nextIfdField));
+        struct Entry {
+            quint16 tag, type;
+            quint32 count, value;
+        };
+        // Types: 3 SHORT, 4 LONG, 5 RATIONAL; tags ascending
+        const Entry entries[] = {
+            {256, 4, 1, quint32(image.width())},
+            {257, 4, 1, quint32(image.height())},
+            {258, 3, 1, 8},
+            {259, 3, 1, 1},
+            {262, 3, 1, 1},
+            {273, 4, 1, stripOffset},
+            {277, 3, 1, 1},
+            {278, 4, 1, quint32(image.height())},
+            {279, 4, 1, quint32(image.width() * image.height())},
+            {282, 5, 1, resolutionOffset},
+            {283, 5, 1, resolutionOffset},
+            {296, 3, 1, 2},
+        };
+        appendLE16(data, sizeof(entries) / sizeof(entries[0]));
+        for(const Entry& entry : entries) {
+            appendLE16(data, entry.tag);
+            appendLE16(data, entry.type);
+            appendLE32(data, entry.count);
+            if(entry.type == 3) {
+                // A single SHORT sits left justified in the value field
+                appendLE16(data, entry.value);
+                appendLE16(data, 0);
+            } else {
+                appendLE32(data, entry.value);
+            }
+        }
+        nextIfdField = data.size();
+        appendLE32(data, 0);
+    }
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+static TessOcr::FILE_TYPE fileType(const QString& extension) {
+    if(extension == "pdf") {
+        return TessOcr::PDF;
+    } else if(extension == "txt") {
+        return TessOcr::TXT;
+    } else if(extension == "hocrbin") {
+        return TessOcr::SNAPSHOT;
+    } else if(extension == "arrow") {
+        return TessOcr::ARROW;
+    } else if(extension == "xml") {
+        return TessOcr::XML;
+    }
+    return TessOcr::IMG;
+}
+
+// The steps of EndProcess' main for a single target
+static ERROR_CODE runJob(const QString& tessdataParentDir, const QString& inPath, const QString& outPath, int pages,
+                         PipelineStats* stats) {
+    QList<int> pageList;
+    for(int page = 1; page <= pages; ++page) {
+        pageList.append(page);
+    }
+    ProgressInfo progress(0);
+    OcrParam ocrParam("", "eng", pageList, PdfPostProcess(100, -1, true, 1));
+    TessOcr tessOcr(tessdataParentDir);
+    tessOcr.SetStats(stats);
+    TessOcr::FILE_TYPE inType = fileType(QFileInfo(inPath).suffix());
+    TessOcr::FILE_TYPE outType = fileType(QFileInfo(outPath).suffix());
+    tessOcr.SetInfileType(inType);
+    tessOcr.SetOutfileTypes(QList<TessOcr::FILE_TYPE>() << outType);
+    if(outType == TessOcr::TXT) {
+        tessOcr.SetTxtOutPath(outPath);
+    }
+    ERROR_CODE result;
+    if(inType == TessOcr::XML) {
+        result = tessOcr.ParseXML(inPath, &progress);
+    } else if(inType == TessOcr::SNAPSHOT) {
+        result = tessOcr.ParseSnapshot(inPath, &progress);
+    } else {
+        result = tessOcr.recognize(inPath, ocrParam, true, &progress);
+    }
+    if(result != ERROR_CODE::SUCCESS) {
+        return result;
+    }
+    StageTimer timer(stats, STAGE_EXPORT);
+    switch(outType) {
+    case TessOcr::PDF:
+        return tessOcr.ExportPdf(outPath, &progress);
+    case TessOcr::XML:
+        return tessOcr.ExporteXML(outPath, &progress);
+    case TessOcr::SNAPSHOT:
+        return tessOcr.ExportSnapshot(outPath, &progress);
+    case TessOcr::ARROW:
+        return tessOcr.ExportArrow(outPath, &progress);
+    default:
+        return tessOcr.ExportTxt(outPath, &progress);
+    }
+}
+
+// Runs a single job and prints its result, wall time, stage totals and peak RSS on one line
+static int runChildJob(char* argv[]) {
+    QString tessdataParentDir = QString::fromLocal8Bit(argv[2]);
+    QString inPath = QString::fromLocal8Bit(argv[3]);
+    QString outPath = QString::fromLocal8Bit(argv[4]);
+    int pages = std::atoi(argv[5]);
+    std::unique_ptr<PipelineStats> stats(new PipelineStats());
+    auto start = std::chrono::steady_clock::now();
+    ERROR_CODE result = runJob(tessdataParentDir, inPath, outPath, pages, stats.get());
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+    StageTimer::finish(stats.get());
+    std::printf("%d %.6f", int(result), wall.count());
+    for(int stage = 0; stage < STAGE_COUNT; ++stage) {
+        std::printf(" %llu", static_cast<unsigned long long>(stats->m_stages[stage].m_totalUs.load()));
+    }
+    std::printf(" %llu\n", static_cast<unsigned long long>(stats->m_peakRssBytes.load()));
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    QApplication app(argc, argv);
+    if(argc == 6 && std::strcmp(argv[1], "--job") == 0) {
+        return runChildJob(argv);
+    }
+    if(argc < 2) {
+        std::fprintf(stderr, "Usage: PipelineBench tessdataParentDir [pagesPerDocument] [workDir] [filter]\n");
+        return 1;
+    }
+    QString tessdataParentDir = QString::fromLocal8Bit(argv[1]);
+    int pages = argc > 2 ? std::atoi(argv[2]) : 3;
+    QDir workDir(argc > 3 ? QString::fromLocal8Bit(argv[3]) : QString("bench-corpus"));
+    QString filter = argc > 4 ? QString::fromLocal8Bit(argv[4]) : QString();
+    if(pages <= 0 || !workDir.mkpath(".")) {
+        std::fprintf(stderr, "Nothing to run\n");
+        return 1;
+    }
+
+    // hOCR and snapshot outputs first, they are the inputs of the later jobs
+    const QStringList inputs = QStringList() << "pdf" << "tif" << "xml" << "hocrbin";
+    const QStringList outputs = QStringList() << "xml" << "hocrbin" << "pdf" << "txt" << "arrow";
+    std::printf("%-14s %-14s %5s %8s %8s", "document", "job", "pages", "wall s", "pages/s");
+    for(int stage = 0; stage < STAGE_COUNT; ++stage) {
+        std::printf(" %12s", stageName(PIPELINE_STAGE(stage)));
+    }
+    std::printf(" %9s\n", "peak MB");
+
+    int failed = 0;
+    unsigned seed = 42;
+    for(const CorpusSpec& spec : s_specs) {
+        QString document = QString("%1-%2").arg(spec.script).arg(spec.density);
+        QString base = workDir.filePath(document);
+        if(!writePdf(base + ".pdf", pages, spec, seed) || !writeTiff(base + ".tif", pages, spec, seed)) {
+            std::fprintf(stderr, "Unable to write the corpus to %s\n", qPrintable(workDir.path()));
+            return 1;
+        }
+        ++seed;
+        for(const QString& input : inputs) {
+            // Recognized inputs are the generated documents, parsed ones the outputs of the PDF jobs
+            QString inPath = input == "pdf" || input == "tif" ? base + "." + input : base + "-pdf." + input;
+            for(const QString& output : outputs) {
+                QString job = QString("%1->%2").arg(input).arg(output);
+                if(!filter.isEmpty() && !QString("%1 %2").arg(document).arg(job).contains(filter)) {
+                    continue;
+                }
+                QProcess process;
+                process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+                process.start(QCoreApplication::applicationFilePath(), QStringList() << "--job" << tessdataParentDir << inPath
+                              << base + "-" + input + "." + output << QString::number(pages));
+                process.waitForFinished(-1);
+                // The last line holds the result, wall time, stage totals and peak RSS
+                QStringList lines = QString::fromLocal8Bit(process.readAllStandardOutput()).split('\n', QString::SkipEmptyParts);
+                QStringList fields = lines.isEmpty() ? QStringList() : lines.last().split(' ', QString::SkipEmptyParts);
+                if(process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0 || fields.size() != 3 + STAGE_COUNT) {
+                    std::printf("%-14s %-14s %5d  crashed\n", qPrintable(document), qPrintable(job), pages);
+                    ++failed;
+                    continue;
+                }
+                int result = fields[0].toInt();
+                double wall = fields[1].toDouble();
+                std::printf("%-14s %-14s %5d %8.2f %8.2f", qPrintable(document), qPrintable(job), pages, wall, pages / wall);
+                for(int stage = 0; stage < STAGE_COUNT; ++stage) {
+                    std::printf(" %9.1f ms", fields[2 + stage].toULongLong() / 1000.0);
+                }
+                std::printf(" %9.1f", fields[2 + STAGE_COUNT].toULongLong() / 1048576.0);
+                if(result != ERROR_CODE::SUCCESS) {
+                    std::printf("  failed (%d)", result);
+                    ++failed;
+                }
+                std::printf("\n");
+                std::fflush(stdout);
+            }
+        }
+    }
+    return failed > 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Microbenchmark of the word spacing classification used by the PDF and text layout.
+ * Compares the former per-call range vector (which truncated to 16 bits) with the UnicodeScript table.
+ *
+ * Usage: UnicodeBench [corpus.txt] [iterations]
+ * Without a corpus a CJK-heavy synthetic one is generated. Words are whitespace separated UTF-8.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "UnicodeScript.hh"
+
+typedef std::u16string Word;
+
+static void appendUtf16(Word& word, char32_t codepoint) {
+    if(codepoint >= 0x10000) {
+        codepoint -= 0x10000;
+        word.push_back(char16_t(0xd800 + (codepoint >> 10)));
+        word.push_back(char16_t(0xdc00 + (codepoint & 0x3ff)));
+    } else {
+        word.push_back(char16_t(codepoint));
+    }
+}
+
+static std::vector<Word> splitUtf8(const std::string& text) {
+    std::vector<Word> words;
+    Word word;
+    for(size_t i = 0, n = text.size(); i < n;) {
+        unsigned char c = text[i];
+        int len = c < 0x80 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+        char32_t codepoint = len == 1 ? c : len == 2 ? c & 0x1f : len == 3 ? c & 0x0f : c & 0x07;
+        for(int k = 1; k < len && i + k < n; ++k) {
+            codepoint = (codepoint << 6) | (text[i + k] & 0x3f);
+        }
+        i += len;
+        if(codepoint == ' ' || codepoint == '\n' || codepoint == '\t' || codepoint == '\r' || codepoint == 0x3000) {
+            if(!word.empty()) {
+                words.push_back(word);
+                word.clear();
+            }
+        } else {
+            appendUtf16(word, codepoint);
+        }
+    }
+    if(!word.empty()) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+static std::vector<Word> syntheticCorpus(int wordCount) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> kind(0, 99);
+    std::uniform_int_distribution<int> length(1, 4);
+    // char32_t is not a valid IntType for uniform_int_distribution
+    auto pick = [&rng](char32_t first, char32_t last) {
+        return static_cast<char32_t>(std::uniform_int_distribution<unsigned>(first, last)(rng));
+    };
+    std::vector<Word> words;
+    words.reserve(wordCount);
+    for(int i = 0; i < wordCount; ++i) {
+        Word word;
+        int k = kind(rng);
+        for(int j = 0, n = length(rng); j < n; ++j) {
+            if(k < 65) {
+                appendUtf16(word, pick(0x4e00, 0x9fff));
+            } else if(k < 75) {
+                appendUtf16(word, pick(0x3041, 0x30fa));
+            } else if(k < 80) {
+                appendUtf16(word, pick(0x20000, 0x2a6df));
+            } else if(k < 85) {
+                appendUtf16(word, pick(0xff01, 0xff5e));
+            } else if(k < 90) {
+                appendUtf16(word, pick(0xac00, 0xd7a3));
+            } else {
+                appendUtf16(word, pick('a', 'z'));
+            }
+        }
+        words.push_back(word);
+    }
+    return words;
+}
+
+// The implementation UnicodeScript replaced, kept verbatim for comparison
+static bool legacySpacedWord(const Word& text, bool prevWord) {
+    short unicode = prevWord ? text[text.size() - 1] : text[0];
+    std::vector<std::pair<int, int>> cjkWordRange{{0x2480, 0x303f}, {0x31c0, 0x9fff}
+        , {0xf900, 0xfaff}, {0xfe30, 0xfe4f}, {0x20000, 0x2fa1f}};
+    for(size_t i = 0; i < cjkWordRange.size(); i++) {
+        if(unicode < cjkWordRange[i].first) {
+            return true;
+        } else if(unicode >= cjkWordRange[i].first && unicode <= cjkWordRange[i].second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool spacedWord(const Word& text, bool prevWord) {
+    if(text.empty()) {
+        return true;
+    }
+    char32_t codepoint;
+    if(prevWord) {
+        size_t i = text.size() - 1;
+        codepoint = text[i];
+        if(text[i] >= 0xdc00 && text[i] < 0xe000 && i > 0 && text[i - 1] >= 0xd800 && text[i - 1] < 0xdc00) {
+            codepoint = 0x10000 + ((char32_t(text[i - 1]) - 0xd800) << 10) + (text[i] - 0xdc00);
+        }
+    } else {
+        codepoint = text[0];
+        if(text[0] >= 0xd800 && text[0] < 0xdc00 && text.size() > 1 && text[1] >= 0xdc00 && text[1] < 0xe000) {
+            codepoint = 0x10000 + ((char32_t(text[0]) - 0xd800) << 10) + (text[1] - 0xdc00);
+        }
+    }
+    return !UnicodeScript::isUnspaced(codepoint);
+}
+
+template<class F>
+static double run(const std::vector<Word>& words, int iterations, F classify, long& spaced) {
+    spaced = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int it = 0; it < iterations; ++it) {
+        // Same access pattern as the layout: the current word's first and the previous word's last character
+        for(const Word& word : words) {
+            spaced += classify(word, false);
+            spaced += classify(word, true);
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (double(words.size()) * iterations * 2);
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<Word> words;
+    if(argc > 1) {
+        std::ifstream ifs(argv[1], std::ios::binary);
+        if(!ifs) {
+            std::fprintf(stderr, "Unable to open corpus %s\n", argv[1]);
+            return 1;
+        }
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        words = splitUtf8(ss.str());
+    } else {
+        words = syntheticCorpus(200000);
+    }
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 20;
+    if(words.empty() || iterations <= 0) {
+        std::fprintf(stderr, "Nothing to classify\n");
+        return 1;
+    }
+
+    long legacySpaced, tableSpaced;
+    double legacyNs = run(words, iterations, legacySpacedWord, legacySpaced);
+    double tableNs = run(words, iterations, spacedWord, tableSpaced);
+    long differing = 0;
+    for(const Word& word : words) {
+        differing += legacySpacedWord(word, false) != spacedWord(word, false);
+        differing += legacySpacedWord(word, true) != spacedWord(word, true);
+    }
+    std::printf("words: %zu, iterations: %d\n", words.size(), iterations);
+    std::printf("legacy range vector: %8.2f ns/lookup\n", legacyNs);
+    std::printf("UnicodeScript table: %8.2f ns/lookup (%.1fx)\n", tableNs, legacyNs / tableNs);
+    std::printf("lookups classified differently: %ld of %zu (code points above 0x7fff, surrogates, kana)\n", differing, words.size() * 2);
+    return legacySpaced + tableSpaced < 0;
+}
@@ -37,7 +37,7 @@ class TessWrapper{
 public:
     TessWrapper():m_inPath(nullptr), m_outPath(nullptr),
         m_pageRange(nullptr), m_tessDataParentDir(nullptr), m_progressInfo(nullptr),
-        m_tessLang(nullptr), m_pdfPostProcess(nullptr),m_sencods(1){}
+        m_tessLang(nullptr), m_pdfPostProcess(nullptr), m_exportOptions(nullptr), m_dictionary(nullptr), m_stats(nullptr), m_tracePath(nullptr), m_sencods(1){}
 
     void InitInterProcessSpace(){
         shared_memory_object::remove(MEMORY_NAME);
@@ -50,6 +50,10 @@ public:
         m_progressInfo = m_segment.construct<ProgressInfo>(PROGRESS_INFO_NAME)(0);
         m_tessLang = m_segment.construct<MyString>(TESS_LANG)(alloc_inst);
         m_pdfPostProcess = m_segment.construct<PdfPostProcess>(PDF_POST_PROCESS)(100, -1, true, 1);
+        m_exportOptions = m_segment.construct<ExportOptions>(EXPORT_OPTIONS_NAME)();
+        m_dictionary = m_segment.construct<MyString>(DICTIONARY_NAME)(alloc_inst);
+        m_stats = m_segment.construct<PipelineStats>(PIPELINE_STATS_NAME)();
+        m_tracePath = m_segment.construct<MyString>(TRACE_PATH_NAME)(alloc_inst);
     }
     void DestroyInterProcessSpace(){
         m_segment.destroy<MyString>(IN_PATH_NAME);
@@ -59,13 +63,21 @@ public:
         m_segment.destroy<ProgressInfo>(PROGRESS_INFO_NAME);
         m_segment.destroy<MyString>(TESS_LANG);
         m_segment.destroy<PdfPostProcess>(PDF_POST_PROCESS);
+        m_segment.destroy<ExportOptions>(EXPORT_OPTIONS_NAME);
+        m_segment.destroy<MyString>(DICTIONARY_NAME);
+        m_segment.destroy<PipelineStats>(PIPELINE_STATS_NAME);
+        m_segment.destroy<MyString>(TRACE_PATH_NAME);
         shared_memory_object::remove(MEMORY_NAME);
     }
-    void SetCommonData(string tessPath, string tessDataParentDir, string tessLang, const PdfPostProcess &pdfPostProcess){
+    void SetCommonData(string tessPath, string tessDataParentDir, string tessLang, const PdfPostProcess &pdfPostProcess,
+                       const ExportOptions &exportOptions, string dictionary, string tracePath){
         m_tessPath = tessPath;
         *m_tessDataParentDir = tessDataParentDir.c_str();
         *m_tessLang = tessLang.c_str();
         *m_pdfPostProcess=pdfPostProcess;
+        *m_exportOptions=exportOptions;
+        *m_dictionary = dictionary.c_str();
+        *m_tracePath = tracePath.c_str();
     }
     void SetTess(string inPath, string outPath, int start, int end){
         *m_inPath = inPath.c_str();
@@ -107,6 +119,40 @@ public:
 
         return m_progressInfo->m_errCode;
     }
+    //stage histograms, counters and peak RSS of EndProcess as JSON
+    void DumpStats(std::ostream &os){
+        //the last stage may still be recorded after the progress reached 100
+        for(int i = 0; i < 20 && !m_stats->m_finished; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        os << "{\n  \"stages\": {";
+        for(int stage = 0; stage < STAGE_COUNT; ++stage){
+            const StageHistogram &histogram = m_stats->m_stages[stage];
+            os << (stage ? "," : "") << "\n    \"" << stageName(PIPELINE_STAGE(stage)) << "\": {"
+               << "\"count\": " << histogram.m_count.load()
+               << ", \"total_us\": " << histogram.m_totalUs.load()
+               << ", \"max_us\": " << histogram.m_maxUs.load();
+            //bucket i counts durations below bucket_upper_us[i], the last one is unbounded
+            os << ", \"bucket_upper_us\": [";
+            for(int i = 0; i < StageHistogram::BucketCount; ++i){
+                os << (i ? ", " : "");
+                if(i < StageHistogram::BucketCount - 1)
+                    os << (std::uint64_t(1) << i);
+                else
+                    os << "null";
+            }
+            os << "], \"counts\": [";
+            for(int i = 0; i < StageHistogram::BucketCount; ++i)
+                os << (i ? ", " : "") << histogram.m_buckets[i].load();
+            os << "]}";
+        }
+        os << "\n  },\n"
+           << "  \"pages_recognized\": " << m_stats->m_pagesRecognized.load() << ",\n"
+           << "  \"pages_read\": " << m_stats->m_pagesRead.load() << ",\n"
+           << "  \"bytes_written\": " << m_stats->m_bytesWritten.load() << ",\n"
+           << "  \"peak_rss_bytes\": " << m_stats->m_peakRssBytes.load() << ",\n"
+           << "  \"page_buffer_peak_bytes\": " << m_stats->m_pageBufferPeakBytes.load() << ",\n"
+           << "  \"page_buffer_stall_us\": " << m_stats->m_pageBufferStallUs.load() << "\n}\n";
+    }
     void StopTess(){
             m_progressInfo->m_errCode = ERROR_CODE::CANCLED_BY_USER;
     }
@@ -122,17 +168,35 @@ private:
     ProgressInfo *m_progressInfo;
     MyString *m_tessLang;
     PdfPostProcess *m_pdfPostProcess;
+    ExportOptions *m_exportOptions;
+    MyString *m_dictionary;
+    PipelineStats *m_stats;
+    MyString *m_tracePath;
     string m_tessPath;
     int m_sencods;
 };
 
 int RunTess(string inPath, string outPath, int start, int end,
-            string tessPath, string tessDataDir, string tessLang, const PdfPostProcess &pdfPostProcess){
+            string tessPath, string tessDataDir, string tessLang, const PdfPostProcess &pdfPostProcess,
+            const ExportOptions &exportOptions, string dictionary, string statsPath, string tracePath){
     TessWrapper tessWrapper;
     tessWrapper.InitInterProcessSpace();
-    tessWrapper.SetCommonData(tessPath, tessDataDir, tessLang, pdfPostProcess);
+    tessWrapper.SetCommonData(tessPath, tessDataDir, tessLang, pdfPostProcess, exportOptions, dictionary, tracePath);
     tessWrapper.SetTess(inPath, outPath, start, end);
-    return tessWrapper.RunTess();
+    int result = tessWrapper.RunTess();
+    if(!statsPath.empty()){
+        std::ofstream ofs(statsPath.c_str());
+        if(ofs)
+            tessWrapper.DumpStats(ofs);
+        else
+            std::cerr<<"Unable to write stats file "<<statsPath<<std::endl;
+    }
+    return result;
+}
+
+//an optional config field is unset when empty or only the line break; stoi throws on a lone newline
+static bool HasValue(const std::string &field){
+    return field.find_first_not_of("\r\n") != std::string::npos;
 }
 
 int main(int argc, char *argv[])
@@ -141,7 +205,12 @@ int main(int argc, char *argv[])
 
     if(argc==1){
         std::cout<<"Usage: FrontUI inPath outPath start end config"<<std::endl;
-        std::cout<<"outPath ext:pdf,txt,xml"<<std::endl;
+        std::cout<<"outPath ext:pdf,txt,xml,xml.gz,xml.zst,hocrbin,arrow"<<std::endl;
+        std::cout<<"several outPaths separated by '|' are produced from a single recognition"<<std::endl;
+        std::cout<<"the optional 15th config field is a path the stage timings are written to as JSON"<<std::endl;
+        std::cout<<"the optional 16th config field is a path EndProcess writes a Chrome trace to"<<std::endl;
+        std::cout<<"the optional 17th config field is the page image budget in MB, 0 for no limit"<<std::endl;
+        std::cout<<"the optional 18th config field is the number of pages rendered ahead of recognition, 0 by default"<<std::endl;
         return ERROR_CODE::SUCCESS;
     }
 
@@ -162,9 +231,9 @@ int main(int argc, char *argv[])
     auto start = std::stoi(argv[3]);
     auto end = std::stoi(argv[4]);
     std::vector<std::string> config;
-    config.resize(7);
+    config.resize(18);
     int i=0;
-    while (i<7 && std::getline(ifs, config[i++], ' ')) {}
+    while (i<18 && std::getline(ifs, config[i++], ' ')) {}
     auto tessPath = config[0];
     auto tessDataDir = config[1];
     auto tessLang = config[2];
@@ -173,5 +242,30 @@ int main(int argc, char *argv[])
     auto uniformziLineSpacing =bool(std::stoi(config[5]));
     auto preserveSpaceWidth=std::stoi(config[6]);
     PdfPostProcess pdfPostProcess(fontScale, fontSize, uniformziLineSpacing, preserveSpaceWidth);
-    return RunTess(inPath, outPath, start, end, tessPath.c_str(), tessDataDir.c_str(), tessLang.c_str(), pdfPostProcess);
+    //optional export options
+    ExportOptions exportOptions;
+    if(HasValue(config[7]))
+        exportOptions.m_buildTextIndex = bool(std::stoi(config[7]));
+    if(HasValue(config[8]))
+        exportOptions.m_pdfBackend = PDF_BACKEND(std::stoi(config[8]));
+    if(HasValue(config[9]))
+        exportOptions.m_pdfImageLayer = bool(std::stoi(config[9]));
+    if(HasValue(config[10]))
+        exportOptions.m_txtPageSeparator = bool(std::stoi(config[10]));
+    if(HasValue(config[11]))
+        exportOptions.m_correctionConfidence = std::stoi(config[11]);
+    if(HasValue(config[12]))
+        exportOptions.m_correctionDistance = std::stoi(config[12]);
+    if(HasValue(config[16]))
+        exportOptions.m_pageBufferBudgetMB = std::stoi(config[16]);
+    if(HasValue(config[17]))
+        exportOptions.m_renderAheadPages = std::stoi(config[17]);
+    //word list or compiled .dawg for correcting low confidence words
+    auto dictionary = config[13].substr(0, config[13].find_last_not_of("\r\n") + 1);
+    //JSON file for the stage timings
+    auto statsPath = config[14].substr(0, config[14].find_last_not_of("\r\n") + 1);
+    //Chrome trace-event JSON of the hot spans, opened in Perfetto or chrome://tracing
+    auto tracePath = config[15].substr(0, config[15].find_last_not_of("\r\n") + 1);
+    return RunTess(inPath, outPath, start, end, tessPath.c_str(), tessDataDir.c_str(), tessLang.c_str(), pdfPostProcess,
+                   exportOptions, dictionary.c_str(), statsPath.c_str(), tracePath.c_str());
 }
@@ -1,7 +1,9 @@
 #include "Tessocr.hh"
 #include <QApplication>
 #include <iostream>
+#include "CompressedStream.hh"
 #include "Config.h"
+#include "Trace.hh"
 
 int main(int argc, char* argv[]) {
     QApplication   app(argc, argv);
@@ -14,48 +16,114 @@ int main(int argc, char* argv[]) {
     MyString* tessLang = segment.find<MyString>(TESS_LANG).first;
     ProgressInfo* interProgressInfo = segment.find<ProgressInfo>(PROGRESS_INFO_NAME).first;
     PdfPostProcess* pdfPostProcess = segment.find<PdfPostProcess>(PDF_POST_PROCESS).first;
+    ExportOptions* exportOptions = segment.find<ExportOptions>(EXPORT_OPTIONS_NAME).first;
+    MyString* dictionaryPath = segment.find<MyString>(DICTIONARY_NAME).first;
+    PipelineStats* stats = segment.find<PipelineStats>(PIPELINE_STATS_NAME).first;
+    MyString* tracePath = segment.find<MyString>(TRACE_PATH_NAME).first;
 
 
     if(inPath == nullptr || outPath == nullptr || pageRange == nullptr || tessDataParentDir == nullptr || interProgressInfo == nullptr) {
         std::cerr << "Fail to open share memory." << std::endl;
         return ERROR_CODE::FAIL_FIND_SHARE_MEMORY;
     }
+    // Declared before every stage timer, so it runs after the last one recorded its stage
+    StageTimer::Finisher finisher(stats);
 
+    // Spans are only recorded if a trace file is asked for
+    if(tracePath && !tracePath->empty()) {
+        Trace::start();
+    }
     QList<int> pageRangeLst;
     for(int index = pageRange->first; index <= pageRange->second; index++) {
         pageRangeLst.push_back(index);
     }
     OcrParam ocrParam("", tessLang->c_str(), pageRangeLst, *pdfPostProcess);
     TessOcr tessOcr(tessDataParentDir->data());
+    tessOcr.SetStats(stats);
+    if(exportOptions) {
+        tessOcr.SetExportOptions(*exportOptions);
+    }
+    if(dictionaryPath && !dictionaryPath->empty() && !tessOcr.LoadDictionary(dictionaryPath->c_str())) {
+        interProgressInfo->m_errCode = ERROR_CODE::NOT_LOAD_FILE;
+        return ERROR_CODE::NOT_LOAD_FILE;
+    }
 
-    QString outPathSuffix = QFileInfo(outPath->c_str()).suffix().toLower();
-    QString inPathSuffix = QFileInfo(inPath->c_str()).suffix().toLower();
+    QString inPathSuffix = CompressedStream::contentSuffix(inPath->c_str());
+    // Only hOCR is read compressed, e.g. "in.xml.gz" or "in.xml.zst"
+    if(CompressedStream::formatForPath(inPath->c_str()) != CompressedStream::None) {
+        if(!inPathSuffix.isEmpty() && inPathSuffix != "xml") {
+            interProgressInfo->m_errCode = ERROR_CODE::UNIMPLEMENTED;
+            return ERROR_CODE::UNIMPLEMENTED;
+        }
+        inPathSuffix = "xml";
+    }
+    // Several targets may be given separated by '|', e.g. "out.pdf|out.txt|out.xml"
+    QStringList outPaths = QString(outPath->c_str()).split('|', QString::SkipEmptyParts);
+    if(outPaths.isEmpty()) {
+        interProgressInfo->m_errCode = ERROR_CODE::NOT_EXIST_FILE;
+        return ERROR_CODE::NOT_EXIST_FILE;
+    }
+    QList<TessOcr::FILE_TYPE> outfileTypes;
+    for(const QString& path : outPaths) {
+        QString outPathSuffix = CompressedStream::contentSuffix(path);
+        TessOcr::FILE_TYPE outfileType;
+        if(outPathSuffix == "arrow" || outPathSuffix == "feather") {
+            outfileType = TessOcr::ARROW;
+        } else {
+            outfileType = outPathSuffix == "pdf" ? TessOcr::PDF : (outPathSuffix == "txt" ? TessOcr::TXT : (outPathSuffix == "hocrbin" ? TessOcr::SNAPSHOT : TessOcr::XML));
+        }
+        // Only hOCR is written compressed
+        if(outfileType != TessOcr::XML && CompressedStream::formatForPath(path) != CompressedStream::None) {
+            interProgressInfo->m_errCode = ERROR_CODE::UNIMPLEMENTED;
+            return ERROR_CODE::UNIMPLEMENTED;
+        }
+        outfileTypes.append(outfileType);
+    }
 
-    tessOcr.SetInfileType(inPathSuffix == "pdf" ? TessOcr::PDF : (inPathSuffix == "xml" ? TessOcr::XML : TessOcr::IMG));
-    tessOcr.SetOutfileType(outPathSuffix == "pdf" ? TessOcr::PDF : (outPathSuffix == "txt" ? TessOcr::TXT : TessOcr::XML));
+    tessOcr.SetInfileType(inPathSuffix == "pdf" ? TessOcr::PDF : (inPathSuffix == "xml" ? TessOcr::XML : (inPathSuffix == "hocrbin" ? TessOcr::SNAPSHOT : TessOcr::IMG)));
+    tessOcr.SetOutfileTypes(outfileTypes);
+    if(outfileTypes.contains(TessOcr::TXT)) {
+        tessOcr.SetTxtOutPath(outPaths[outfileTypes.indexOf(TessOcr::TXT)]);
+    }
     ERROR_CODE result;
     switch (tessOcr.GetInfileType()) {
     case TessOcr::PDF:
     case TessOcr::IMG:
         result = tessOcr.recognize(inPath->c_str(), ocrParam, true, interProgressInfo);
         break;
+    case TessOcr::SNAPSHOT:
+        result = tessOcr.ParseSnapshot(inPath->c_str(), interProgressInfo);
+        break;
     default:
         result = tessOcr.ParseXML(inPath->c_str(), interProgressInfo);
         break;
     }
-
     if(result == ERROR_CODE::SUCCESS) {
-        switch (tessOcr.GetOutfileType()) {
+        result = tessOcr.CorrectWords(interProgressInfo);
+    }
+
+    for(int i = 0; i < outPaths.size() && result == ERROR_CODE::SUCCESS; ++i) {
+        StageTimer timer(stats, STAGE_EXPORT);
+        switch (outfileTypes[i]) {
         case TessOcr::PDF:
-            return tessOcr.ExportPdf(outPath->c_str(), interProgressInfo);
+            result = tessOcr.ExportPdf(outPaths[i], interProgressInfo);
+            break;
         case TessOcr::XML:
-            return tessOcr.ExporteXML(outPath->c_str(), interProgressInfo);
+            result = tessOcr.ExporteXML(outPaths[i], interProgressInfo);
+            break;
+        case TessOcr::SNAPSHOT:
+            result = tessOcr.ExportSnapshot(outPaths[i], interProgressInfo);
+            break;
+        case TessOcr::ARROW:
+            result = tessOcr.ExportArrow(outPaths[i], interProgressInfo);
+            break;
         default:
-            return tessOcr.ExportTxt(outPath->c_str(), interProgressInfo);
+            result = tessOcr.ExportTxt(outPaths[i], interProgressInfo);
+            break;
         }
-
-    } else {
-        return result;
     }
-
+    if(Trace::enabled()) {
+        Trace::write(QString::fromUtf8(tracePath->c_str()));
+    }
+    return result;
 }
@@ -0,0 +1,141 @@
+#include <QBuffer>
+#include <QDomDocument>
+#include <QTemporaryFile>
+#include <QtTest>
+#include "HOCRDocument.hh"
+#include "HOCRPageScanner.hh"
+#include "Tessocr.hh"
+
+class HOCRDocumentTest : public QObject {
+    Q_OBJECT
+
+private:
+    // A paragraph of a header, a body line and a caption, and a graphic, as Tesseract writes them
+    static QByteArray tesseractHtml() {
+        return "<body>\n"
+               "<div class='ocr_page' id='page_1' title='image \"page.png\"; bbox 0 0 1000 1000; ppageno 1'>"
+               " <div class='ocr_carea' id='block_1_1' title='bbox 100 100 900 400'>"
+               "  <p class='ocr_par' id='par_1_1' lang='eng' title='bbox 100 100 900 400'>"
+               "   <span class='ocr_header' id='line_1_1' title='bbox 100 100 900 150; baseline 0 -5'>"
+               "    <span class='ocrx_word' id='word_1_1' title='bbox 100 100 300 150; x_wconf 95'>Title</span>"
+               "   </span>"
+               "   <span class='ocr_line' id='line_1_2' title='bbox 100 200 900 250; baseline 0,01 -5'>"
+               "    <span class='ocrx_word' id='word_1_2' title='bbox 100 200 300 250; x_wconf 95'>body</span>"
+               "    <span class='ocrx_word' id='word_1_3' title='bbox 350 200 500 250; x_wconf 95'>text—</span>"
+               "   </span>"
+               "   <span class='ocr_caption' id='line_1_3' title='bbox 100 300 900 350; baseline 0 -5'>"
+               "    <span class='ocrx_word' id='word_1_4' title='bbox 100 300 200 350; x_wconf 95'>Fig</span>"
+               "    <span class='ocrx_word' id='word_1_5' title='bbox 250 300 300 350; x_wconf 95'>1</span>"
+               "   </span>"
+               "  </p>"
+               " </div>"
+               " <div class='ocr_carea' id='block_1_2' title='bbox 100 500 900 900'></div>"
+               "</div>\n"
+               "</body>\n";
+    }
+
+    // A page as HOCRPageBuilder makes it: a line without baseline, a word without font name, bold text to escape
+    static HOCRPage* recognizedPage() {
+        QMap<QString, QString> titleAttrs;
+        titleAttrs["image"] = "'page.png'";
+        titleAttrs["ppageno"] = "1";
+        titleAttrs["rot"] = "0";
+        titleAttrs["res"] = "300";
+        HOCRPage* page = new HOCRPage({{"class", "ocr_page"}}, titleAttrs, QRect(0, 0, 1000, 1000));
+        HOCRItem* block = new HOCRItem({{"class", "ocr_carea"}}, {}, QRect(100, 100, 800, 100), page, page);
+        page->addChild(block);
+        HOCRItem* par = new HOCRItem({{"class", "ocr_par"}}, {}, QRect(100, 100, 800, 100), page, block);
+        block->addChild(par);
+        HOCRItem* line = new HOCRItem({{"class", "ocr_line"}}, {{"x_size", "40"}}, QRect(100, 100, 800, 50), page, par);
+        par->addChild(line);
+        HOCRItem* word = new HOCRItem({{"class", "ocrx_word"}, {"lang", "en_US"}}, {{"x_font", ""}, {"x_fsize", "10"}, {"x_wconf", "90"}},
+                                      QRect(100, 100, 300, 50), page, line);
+        word->setText("Caf\u00e9 & <co>");
+        word->setAttribute("bold", "1");
+        line->addChild(word);
+        page->addChild(new HOCRItem({{"class", "ocr_graphic"}}, {}, QRect(100, 500, 800, 400), page, page));
+        return page;
+    }
+
+    // Whether every page of html would be copied verbatim by writeHTML
+    static bool allPagesCanonical(const QByteArray& html) {
+        QVector<HOCRPageScanner::Page> pages;
+        if(!HOCRPageScanner::scan(html.constData(), html.size(), pages) || pages.isEmpty()) {
+            return false;
+        }
+        for(int i = 0; i < pages.size(); ++i) {
+            if(!HOCRPageScanner::isCanonical(html.constData() + pages[i].offset, pages[i].length, i + 1, true)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static QByteArray writeHTML(const HOCRDocument& document) {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        bool ok = document.writeHTML(&buffer);
+        return ok ? buffer.data() : QByteArray();
+    }
+
+    // Exports the lazily read html untouched, and with its page edited to what it was
+    static void exportUntouchedAndTouched(const QByteArray& html, QByteArray& untouched, QByteArray& touched) {
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        file.write(html);
+        file.close();
+
+        HOCRDocument untouchedDocument;
+        QVERIFY(untouchedDocument.addPages(file.fileName(), true));
+        untouched = writeHTML(untouchedDocument);
+
+        HOCRDocument touchedDocument;
+        QVERIFY(touchedDocument.addPages(file.fileName(), true));
+        HOCRItem* block = touchedDocument.page(0)->children().first();
+        QVERIFY(touchedDocument.setItemBBox(block, block->bbox()));
+        QVERIFY(touchedDocument.page(0)->isModified());
+        touched = writeHTML(touchedDocument);
+    }
+
+private slots:
+    void collectTextKeepsAllLineClasses() {
+        QDomDocument dom;
+        QVERIFY(dom.setContent(tesseractHtml()));
+        HOCRDocument document;
+        document.addPage(dom.documentElement().firstChildElement("div"), true);
+        std::string text;
+        TessOcr::collectText(document.page(0), text);
+        QCOMPARE(QString::fromStdString(text), QString("Title\nbody text-\nFig 1\n\n"));
+    }
+
+    void writeHTMLDoesNotDependOnPageAccess() {
+        // Tesseract's ids, languages, baselines, hyphens and graphics are all normalized when built
+        QByteArray untouched, touched;
+        exportUntouchedAndTouched(tesseractHtml(), untouched, touched);
+        QVERIFY(!untouched.isEmpty());
+        QCOMPARE(untouched, touched);
+        QVERIFY(!allPagesCanonical(tesseractHtml()));
+
+        // Exported pages are copied verbatim from then on
+        QVERIFY(allPagesCanonical(untouched));
+        QByteArray reexported, retouched;
+        exportUntouchedAndTouched(untouched, reexported, retouched);
+        QCOMPARE(reexported, untouched);
+        QCOMPARE(retouched, untouched);
+    }
+
+    void recognizedExportIsCopiedVerbatim() {
+        HOCRDocument recognized;
+        recognized.addPage(recognizedPage());
+        QByteArray exported = writeHTML(recognized);
+        QVERIFY(allPagesCanonical(exported));
+
+        QByteArray untouched, touched;
+        exportUntouchedAndTouched(exported, untouched, touched);
+        QCOMPARE(untouched, exported);
+        QCOMPARE(touched, exported);
+    }
+};
+
+QTEST_MAIN(HOCRDocumentTest)
+#include "HOCRDocumentTest.moc"
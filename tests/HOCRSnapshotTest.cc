@@ -0,0 +1,145 @@
+#include <cstring>
+#include <QBuffer>
+#include <QTemporaryFile>
+#include <QtTest>
+#include "HOCRDocument.hh"
+#include "HOCRSnapshot.hh"
+
+class HOCRSnapshotTest : public QObject {
+    Q_OBJECT
+
+private:
+    // Two lines of words sharing their language and font, one of the words disabled
+    static HOCRPage* page() {
+        QMap<QString, QString> titleAttrs;
+        titleAttrs["image"] = "scan.tif";
+        titleAttrs["ppageno"] = "7";
+        titleAttrs["rot"] = "0.5";
+        titleAttrs["res"] = "300";
+        HOCRPage* page = new HOCRPage({{"class", "ocr_page"}}, titleAttrs, QRect(0, 0, 2480, 3508));
+        HOCRItem* block = new HOCRItem({{"class", "ocr_carea"}}, {}, QRect(100, 100, 1000, 300), page, page);
+        page->addChild(block);
+        HOCRItem* par = new HOCRItem({{"class", "ocr_par"}, {"dir", "rtl"}}, {}, QRect(100, 100, 1000, 300), page, block);
+        block->addChild(par);
+        const char* texts[2][2] = {{"first", "line"}, {"zweite", "Zeile"}};
+        for(int iLine = 0; iLine < 2; ++iLine) {
+            QRect lineRect(100, 100 + 150 * iLine, 1000, 100);
+            HOCRItem* line = new HOCRItem({{"class", iLine == 0 ? "ocr_header" : "ocr_line"}}, {{"baseline", "0.01 -5"}, {"x_size", "40"}},
+                                          lineRect, page, par);
+            par->addChild(line);
+            for(int iWord = 0; iWord < 2; ++iWord) {
+                HOCRItem* word = new HOCRItem({{"class", "ocrx_word"}, {"lang", "en_US"}},
+                                              {{"x_font", "DejaVu Serif"}, {"x_fsize", "11"}, {"x_wconf", QString::number(90 - iWord)}},
+                                              QRect(lineRect.left() + 500 * iWord, lineRect.top(), 400, 100), page, line);
+                word->setText(texts[iLine][iWord]);
+                word->setAttribute("bold", iWord == 0 ? "1" : "0");
+                word->setAttribute("italic", iLine == 1 ? "1" : "0");
+                word->setEnabled(iLine == 0 || iWord == 0);
+                line->addChild(word);
+            }
+        }
+        page->addChild(new HOCRItem({{"class", "ocr_graphic"}}, {}, QRect(100, 1000, 800, 600), page, page));
+        return page;
+    }
+
+    static void compareItems(const HOCRItem* actual, const HOCRItem* expected) {
+        QCOMPARE(actual->getAttributes(), expected->getAttributes());
+        QCOMPARE(actual->getTitleAttributes(), expected->getTitleAttributes());
+        QCOMPARE(actual->bbox(), expected->bbox());
+        QCOMPARE(actual->text(), expected->text());
+        QCOMPARE(actual->isEnabled(), expected->isEnabled());
+        QCOMPARE(actual->fontBold(), expected->fontBold());
+        QCOMPARE(actual->fontItalic(), expected->fontItalic());
+        QCOMPARE(actual->children().size(), expected->children().size());
+        for(int i = 0; i < expected->children().size(); ++i) {
+            QVERIFY(actual->children()[i]->parent() == actual);
+            compareItems(actual->children()[i], expected->children()[i]);
+        }
+    }
+
+    static QByteArray snapshot(const HOCRDocument& document) {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        return HOCRSnapshot::write(document, &buffer) ? buffer.data() : QByteArray();
+    }
+
+    static bool opens(const QByteArray& data) {
+        QTemporaryFile file;
+        if(!file.open() || file.write(data) != data.size()) {
+            return false;
+        }
+        file.close();
+        HOCRSnapshot snapshot;
+        return snapshot.open(file.fileName());
+    }
+
+private slots:
+    void roundTrip() {
+        HOCRDocument document;
+        document.addPage(page());
+        document.addPage(page());
+        QByteArray data = snapshot(document);
+        QVERIFY(!data.isEmpty());
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        QCOMPARE(file.write(data), qint64(data.size()));
+        file.close();
+
+        HOCRSnapshot snapshot;
+        QVERIFY(snapshot.open(file.fileName()));
+        QCOMPARE(snapshot.pageCount(), 2);
+        for(int i = 0; i < 2; ++i) {
+            const HOCRPage* expected = static_cast<const HOCRDocument&>(document).page(i);
+            QScopedPointer<HOCRPage> actual(snapshot.readPage(i));
+            QVERIFY(actual);
+            // Ids were numbered per page by the document
+            QCOMPARE(actual->getAttributes().value("id"), QString("page_%1").arg(i + 1));
+            QCOMPARE(actual->pageNr(), 7);
+            QCOMPARE(actual->resolution(), 300);
+            QCOMPARE(actual->sourceFile(), QString("scan.tif"));
+            compareItems(actual.data(), expected);
+            QCOMPARE(actual->toHtml(), expected->toHtml());
+        }
+        QVERIFY(!snapshot.readPage(2));
+
+        // Every attribute name, value and text is stored once
+        HOCRSnapshot::Header header;
+        std::memcpy(&header, data.constData(), sizeof(header));
+        quint32 stringCount = qFromLittleEndian(header.stringCount);
+        QSet<QString> strings;
+        for(quint32 id = 0; id < stringCount; ++id) {
+            strings.insert(snapshot.string(id));
+        }
+        QCOMPARE(quint32(strings.size()), stringCount);
+        QVERIFY(strings.contains("en_US"));
+        QVERIFY(strings.contains("DejaVu Serif"));
+        QVERIFY(strings.contains("zweite"));
+        QCOMPARE(snapshot.string(0), QString());
+        QCOMPARE(snapshot.string(stringCount), QString());
+    }
+
+    void rejectsCorruptStringTable() {
+        HOCRDocument document;
+        document.addPage(page());
+        QByteArray data = snapshot(document);
+        QVERIFY(opens(data));
+
+        HOCRSnapshot::Header header;
+        std::memcpy(&header, data.constData(), sizeof(header));
+        quint64 offsets = qFromLittleEndian(header.stringTableOffset);
+        quint32 stringCount = qFromLittleEndian(header.stringCount);
+        QVERIFY(stringCount > 8);
+        auto withOffset = [&](quint32 id, quint32 value) {
+            QByteArray corrupt = data;
+            qToLittleEndian<quint32>(value, reinterpret_cast<uchar*>(corrupt.data() + offsets + 4 * id));
+            return corrupt;
+        };
+        // Past the end of the file, and before the previous string
+        QVERIFY(!opens(withOffset(stringCount / 2, 0x7fffffff)));
+        QVERIFY(!opens(withOffset(stringCount / 2, 0)));
+        QVERIFY(!opens(withOffset(stringCount, 0x7fffffff)));
+    }
+};
+
+QTEST_MAIN(HOCRSnapshotTest)
+#include "HOCRSnapshotTest.moc"
@@ -0,0 +1,225 @@
+#include <cstring>
+#include <QBuffer>
+#include <QtTest>
+#include "HOCRDocument.hh"
+#include "HOCRWordTable.hh"
+
+// Reads the little endian FlatBuffers tables of the Arrow metadata, root offset at begin
+class FlatReader {
+public:
+    FlatReader(const QByteArray& data, qint64 begin) : m_data(data), m_begin(begin) {}
+    template<typename T>
+    T scalar(qint64 pos) const {
+        quint64 value = 0;
+        for(size_t i = 0; i < sizeof(T); ++i) {
+            value |= quint64(quint8(m_data[int(pos + i)])) << (8 * i);
+        }
+        return T(value);
+    }
+    qint64 root() const {
+        return deref(m_begin);
+    }
+    // Position of a field of the table at table through its vtable, 0 if the field is absent
+    qint64 field(qint64 table, int field) const {
+        qint64 vtable = table - scalar<qint32>(table);
+        quint16 vtableSize = scalar<quint16>(vtable);
+        quint16 offset = 4 + 2 * field < vtableSize ? scalar<quint16>(vtable + 4 + 2 * field) : 0;
+        return offset ? table + offset : 0;
+    }
+    qint64 deref(qint64 pos) const {
+        return pos + scalar<quint32>(pos);
+    }
+    // Table, vector or string a field refers to
+    qint64 object(qint64 table, int field) const {
+        return deref(this->field(table, field));
+    }
+    QByteArray string(qint64 pos) const {
+        return m_data.mid(pos + 4, scalar<quint32>(pos));
+    }
+
+private:
+    const QByteArray& m_data;
+    qint64 m_begin;
+};
+
+class HOCRWordTableTest : public QObject {
+    Q_OBJECT
+
+private:
+    struct Word {
+        QString text;
+        QString lineClass;
+        QRect bbox;
+        int confidence;
+        float fontSize;
+    };
+
+    // A page numbered pageNr with a line of its own per word
+    static HOCRPage* page(int pageNr, const QVector<Word>& words) {
+        QMap<QString, QString> titleAttrs;
+        titleAttrs["image"] = "page.png";
+        titleAttrs["ppageno"] = QString::number(pageNr);
+        titleAttrs["rot"] = "0";
+        titleAttrs["res"] = "300";
+        HOCRPage* page = new HOCRPage({{"class", "ocr_page"}}, titleAttrs, QRect(0, 0, 1000, 1000));
+        HOCRItem* block = new HOCRItem({{"class", "ocr_carea"}}, {}, QRect(0, 0, 1000, 1000), page, page);
+        page->addChild(block);
+        HOCRItem* par = new HOCRItem({{"class", "ocr_par"}}, {}, QRect(0, 0, 1000, 1000), page, block);
+        block->addChild(par);
+        for(const Word& word : words) {
+            HOCRItem* line = new HOCRItem({{"class", word.lineClass}}, {}, word.bbox, page, par);
+            par->addChild(line);
+            QMap<QString, QString> wordTitleAttrs;
+            wordTitleAttrs["x_wconf"] = QString::number(word.confidence);
+            wordTitleAttrs["x_fsize"] = QString::number(word.fontSize);
+            HOCRItem* item = new HOCRItem({{"class", "ocrx_word"}}, wordTitleAttrs, word.bbox, page, line);
+            item->setText(word.text);
+            line->addChild(item);
+        }
+        return page;
+    }
+
+    template<typename T>
+    static QVector<T> column(const QByteArray& data, qint64 pos, qint64 length) {
+        QVector<T> values(length / sizeof(T));
+        std::memcpy(values.data(), data.constData() + pos, values.size() * sizeof(T));
+        return values;
+    }
+
+    static void checkSchema(const FlatReader& reader, qint64 schema) {
+        static const char* names[] = {"page", "line", "word", "left", "top", "right", "bottom", "confidence", "font_size"};
+        // Int, Utf8 and FloatingPoint of Schema.fbs' Type union
+        static const quint8 types[] = {2, 2, 5, 2, 2, 2, 2, 2, 3};
+        QCOMPARE(reader.scalar<qint16>(reader.field(schema, 0)), qint16(Q_BYTE_ORDER == Q_BIG_ENDIAN ? 1 : 0));
+        qint64 fields = reader.object(schema, 1);
+        QCOMPARE(reader.scalar<quint32>(fields), 9u);
+        for(int i = 0; i < 9; ++i) {
+            qint64 field = reader.deref(fields + 4 + 4 * i);
+            QCOMPARE(reader.string(reader.object(field, 0)), QByteArray(names[i]));
+            QCOMPARE(reader.scalar<quint8>(reader.field(field, 1)), quint8(0));
+            QCOMPARE(reader.scalar<quint8>(reader.field(field, 2)), types[i]);
+            qint64 type = reader.object(field, 3);
+            if(types[i] == 2) {
+                QCOMPARE(reader.scalar<qint32>(reader.field(type, 0)), 32);
+                QCOMPARE(reader.scalar<quint8>(reader.field(type, 1)), quint8(1));
+            } else if(types[i] == 3) {
+                QCOMPARE(reader.scalar<qint16>(reader.field(type, 0)), qint16(1));
+            }
+            QCOMPARE(reader.scalar<quint32>(reader.object(field, 5)), 0u);
+        }
+    }
+
+    // The encapsulated message at offset: continuation marker, metadata length, Message table
+    static void checkMessage(const QByteArray& data, qint64 offset, quint8 headerType, qint64 bodyLength, qint64& metadataLength,
+                             qint64& header) {
+        FlatReader reader(data, offset + 8);
+        QCOMPARE(offset % 8, qint64(0));
+        QCOMPARE(reader.scalar<quint32>(offset), 0xFFFFFFFFu);
+        metadataLength = 8 + reader.scalar<qint32>(offset + 4);
+        QCOMPARE(metadataLength % 8, qint64(0));
+        qint64 message = reader.root();
+        QCOMPARE(reader.scalar<qint16>(reader.field(message, 0)), qint16(4));
+        QCOMPARE(reader.scalar<quint8>(reader.field(message, 1)), headerType);
+        QCOMPARE(reader.scalar<qint64>(reader.field(message, 3)), bodyLength);
+        header = reader.object(message, 2);
+    }
+
+private slots:
+    void writesTwoRecordBatches() {
+        QScopedPointer<HOCRPage> first(page(3, {
+            {"a", "ocr_line", QRect(QPoint(10, 20), QPoint(30, 40)), 90, 10},
+            {"bc", "ocr_header", QRect(QPoint(50, 60), QPoint(70, 80)), 80, 12.5}
+        }));
+        QScopedPointer<HOCRPage> second(page(4, {
+            {"déf", "ocr_caption", QRect(QPoint(110, 120), QPoint(130, 140)), 70, 8}
+        }));
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        HOCRWordTable table(2);
+        QVERIFY(table.open(&buffer));
+        QVERIFY(table.addPage(first.data()));
+        QVERIFY(table.addPage(second.data()));
+        QVERIFY(table.close());
+        const QByteArray data = buffer.data();
+        FlatReader file(data, 0);
+
+        // Magic padded to 8 bytes, schema message, ..., end of stream marker, footer, its length, magic
+        QVERIFY(data.startsWith(QByteArray("ARROW1\0\0", 8)));
+        QVERIFY(data.endsWith("ARROW1"));
+        qint64 footerBegin = data.size() - 10 - file.scalar<qint32>(data.size() - 10);
+        QCOMPARE(file.scalar<quint32>(footerBegin - 8), 0xFFFFFFFFu);
+        QCOMPARE(file.scalar<quint32>(footerBegin - 4), 0u);
+
+        qint64 metadataLength, header;
+        checkMessage(data, 8, 1, 0, metadataLength, header);
+        checkSchema(FlatReader(data, 16), header);
+
+        FlatReader footer(data, footerBegin);
+        qint64 root = footer.root();
+        QCOMPARE(footer.scalar<qint16>(footer.field(root, 0)), qint16(4));
+        checkSchema(footer, footer.object(root, 1));
+        QCOMPARE(footer.scalar<quint32>(footer.object(root, 2)), 0u);
+        qint64 blocks = footer.object(root, 3);
+        QCOMPARE(footer.scalar<quint32>(blocks), 2u);
+
+        const qint64 rows[] = {2, 1};
+        const QVector<qint32> pages[] = {{3, 3}, {4}};
+        const QVector<qint32> lines[] = {{0, 1}, {0}};
+        const QVector<qint32> wordOffsets[] = {{0, 1, 3}, {0, 4}};
+        const QByteArray words[] = {"abc", "d\xc3\xa9" "f"};
+        const QVector<qint32> lefts[] = {{10, 50}, {110}};
+        const QVector<qint32> bottoms[] = {{40, 80}, {140}};
+        const QVector<qint32> confidences[] = {{90, 80}, {70}};
+        const QVector<float> fontSizes[] = {{10, 12.5}, {8}};
+        for(int i = 0; i < 2; ++i) {
+            // Block structs after the vector length: offset, metaDataLength padded to 8 bytes, bodyLength
+            qint64 block = blocks + 4 + 24 * i;
+            qint64 offset = footer.scalar<qint64>(block);
+            qint64 bodyLength = footer.scalar<qint64>(block + 16);
+            qint64 recordBatch;
+            checkMessage(data, offset, 3, bodyLength, metadataLength, recordBatch);
+            QCOMPARE(qint64(footer.scalar<qint32>(block + 8)), metadataLength);
+            FlatReader message(data, offset + 8);
+            QCOMPARE(message.scalar<qint64>(message.field(recordBatch, 0)), rows[i]);
+            qint64 nodes = message.object(recordBatch, 1);
+            QCOMPARE(message.scalar<quint32>(nodes), 9u);
+            for(int column = 0; column < 9; ++column) {
+                QCOMPARE(message.scalar<qint64>(nodes + 4 + 16 * column), rows[i]);
+                QCOMPARE(message.scalar<qint64>(nodes + 12 + 16 * column), qint64(0));
+            }
+            // Validity and values of each column, and the offsets of the words before their data
+            qint64 buffers = message.object(recordBatch, 2);
+            QCOMPARE(message.scalar<quint32>(buffers), 19u);
+            qint64 body = offset + metadataLength;
+            auto bufferAt = [&](int index, qint64& pos, qint64& length) {
+                pos = message.scalar<qint64>(buffers + 4 + 16 * index);
+                length = message.scalar<qint64>(buffers + 12 + 16 * index);
+                QCOMPARE(pos % 8, qint64(0));
+                QVERIFY(pos + length <= bodyLength);
+                pos += body;
+            };
+            qint64 pos, length;
+            bufferAt(0, pos, length);
+            QCOMPARE(length, qint64(0));
+            bufferAt(1, pos, length);
+            QCOMPARE(column<qint32>(data, pos, length), pages[i]);
+            bufferAt(3, pos, length);
+            QCOMPARE(column<qint32>(data, pos, length), lines[i]);
+            bufferAt(5, pos, length);
+            QCOMPARE(column<qint32>(data, pos, length), wordOffsets[i]);
+            bufferAt(6, pos, length);
+            QCOMPARE(data.mid(pos, length), words[i]);
+            bufferAt(8, pos, length);
+            QCOMPARE(column<qint32>(data, pos, length), lefts[i]);
+            bufferAt(14, pos, length);
+            QCOMPARE(column<qint32>(data, pos, length), bottoms[i]);
+            bufferAt(16, pos, length);
+            QCOMPARE(column<qint32>(data, pos, length), confidences[i]);
+            bufferAt(18, pos, length);
+            QCOMPARE(column<float>(data, pos, length), fontSizes[i]);
+        }
+    }
+};
+
+QTEST_MAIN(HOCRWordTableTest)
+#include "HOCRWordTableTest.moc"
@@ -0,0 +1,57 @@
+#include <QImage>
+#include <QPainter>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "HOCRTextIndex.hh"
+#include "Tessocr.hh"
+
+// Runs whole jobs, so it needs the directory containing tessdata in TESSDATA_PARENT
+class TessOcrTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void txtOnlyJobWritesWordIndex() {
+        QString tessdataParentDir = QString::fromLocal8Bit(qgetenv("TESSDATA_PARENT"));
+        if(tessdataParentDir.isEmpty()) {
+            QSKIP("TESSDATA_PARENT is not set");
+        }
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString inPath = dir.filePath("page.png");
+        QString outPath = dir.filePath("page.txt");
+        QImage image(1600, 400, QImage::Format_RGB32);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        QFont font("DejaVu Sans");
+        font.setPixelSize(64);
+        painter.setFont(font);
+        painter.setPen(Qt::black);
+        painter.drawText(100, 220, "Index every word");
+        painter.end();
+        QVERIFY(image.save(inPath));
+
+        TessOcr tessOcr(tessdataParentDir);
+        ExportOptions options;
+        options.m_buildTextIndex = true;
+        tessOcr.SetExportOptions(options);
+        tessOcr.SetInfileType(TessOcr::IMG);
+        tessOcr.SetOutfileTypes(QList<TessOcr::FILE_TYPE>() << TessOcr::TXT);
+        tessOcr.SetTxtOutPath(outPath);
+        ProgressInfo progress(0);
+        OcrParam ocrParam("", "chi_sim", QList<int>() << 1, PdfPostProcess(100, -1, true, 1));
+        ERROR_CODE result = tessOcr.recognize(inPath, ocrParam, true, &progress);
+        if(result == ERROR_CODE::FAIL_INIT_TESS) {
+            QSKIP("No chi_sim traineddata in TESSDATA_PARENT");
+        }
+        QCOMPARE(result, ERROR_CODE::SUCCESS);
+        QCOMPARE(tessOcr.CorrectWords(&progress), ERROR_CODE::SUCCESS);
+        QCOMPARE(tessOcr.ExportTxt(outPath, &progress), ERROR_CODE::SUCCESS);
+
+        HOCRTextIndex index;
+        QVERIFY(index.open(outPath + ".idx"));
+        QVERIFY(index.termCount() > 0);
+    }
+};
+
+QTEST_MAIN(TessOcrTest)
+#include "TessOcrTest.moc"